@@ -4,19 +4,362 @@
 #define BUS_H
 
 #include <cstdint>
+#include <memory>
+#include <type_traits>
 
+#include "Cartridge.h"
+#include "Mapper.h"
+#include "NES2C02.h"
 #include "NES6502.h"
+#include "Scheduler.h"
 
-class Bus {
-    NES6502 cpu;
-    uint8_t *ram;
+// Tracking of the pages written, for incremental snapshots (see BasicBus::SnapshotIncremental).
+// It costs a store per write, compiled out with -DBUS_DIRTY_TRACKING=0.
+#ifndef BUS_DIRTY_TRACKING
+#define BUS_DIRTY_TRACKING 1
+#endif
+
+// Whole machine state, plain data so that saving or restoring it is a handful of copies (see
+// BasicBus::Snapshot). Versioned: a state of another layout is refused rather than misread.
+struct MachineState {
+    static constexpr uint32_t VERSION = 2;
+
+    static constexpr unsigned int RAM_SIZE = 2 * 1024;
+    static constexpr unsigned int MAX_PRG_RAM_SIZE = 32 * 1024;
+    static constexpr unsigned int MAX_CHR_RAM_SIZE = 32 * 1024;
+
+    uint32_t version;
+    uint32_t size;          // sizeof(MachineState)
+    uint64_t cartridgeHash; // Of the cartridge inserted (see Cartridge::GetHash), 0 if none
+    uint64_t epoch;         // Dirty page epoch it started (see BasicBus::SnapshotIncremental)
+
+    NES6502Base::State cpu;
+    NES2C02::State ppu;
+    MapperState mapper;
+    Scheduler scheduler;
+    uint8_t oamDmaPage;
+
+    uint8_t ram[RAM_SIZE];
+    uint8_t prgRam[MAX_PRG_RAM_SIZE]; // Up to the cartridge's size, the rest left as is
+    uint8_t chrRam[MAX_CHR_RAM_SIZE];
+};
+
+static_assert(std::is_trivially_copyable_v<MachineState>);
+
+// Cartridges whose games misbehave when their idle loops are skipped, by hash (see
+// Cartridge::GetHash): skipping is turned off when one of them is inserted (see
+// NES6502::SetIdleLoopSkipping). Games found later are added at start-up.
+void AddIdleLoopSkippingException(uint64_t cartridgeHash);
+bool IsIdleLoopSkippingException(uint64_t cartridgeHash);
+
+// NES bus, its CPU running with the given execution policy (see NES6502)
+template <typename Policy> class BasicBus {
+    NES6502<BasicBus, Policy> cpu;
+    NES2C02 ppu;
+    Cartridge *cartridge; // Cartridge inserted, nullptr if none
+    std::unique_ptr<Mapper<BasicBus>> mapper; // Its board's bank switching hardware
 
 public:
-    Bus();
-    ~Bus() { delete[] ram; }
+    BasicBus();
+
+    // Defined below, so that the CPU core inlines them
+    uint8_t ReadRam(uint16_t addr, bool bReadOnly = false);
+    void WriteRam(uint16_t addr, uint8_t data);
+
+public: /* Memory map */
+    // The address space is split into 256 pages of 256 bytes, each of them either backed by
+    // host memory (RAM, ROM) or by an I/O handler. Mirroring and bank switching only repoint
+    // the pages below, instead of adding arithmetic to every access.
+    static constexpr unsigned int PAGE_COUNT = 256;
+    static constexpr unsigned int PAGE_SIZE = 256;
+
+    using ReadHandler = uint8_t (BasicBus::*)(uint16_t addr);
+    using WriteHandler = void (BasicBus::*)(uint16_t addr, uint8_t data);
+
+    // Maps host memory to the given pages for reading, mirrored every size bytes
+    void MapReadMemory(uint8_t firstPage, uint8_t lastPage, const uint8_t *memory,
+                       uint32_t size);
+
+    // Maps host memory to the given pages for writing, mirrored every size bytes
+    void MapWriteMemory(uint8_t firstPage, uint8_t lastPage, uint8_t *memory, uint32_t size);
+
+    // Maps an I/O handler to the given pages for reading
+    void MapReadHandler(uint8_t firstPage, uint8_t lastPage, ReadHandler handler);
+
+    // Maps an I/O handler to the given pages for writing
+    void MapWriteHandler(uint8_t firstPage, uint8_t lastPage, WriteHandler handler);
+
+public: /* Cartridge */
+    // Maps the memory of the given cartridge in place: PRG-RAM at $6000, then PRG-ROM at $8000
+    // and CHR to the pattern tables as selected by its mapper, idle loop skipping being set for
+    // its game (see IsIdleLoopSkippingException). Returns false if its mapper isn't supported
+    // (see CreateMapper).
+    bool InsertCartridge(Cartridge *_cartridge);
+
+    // Mapper of the inserted cartridge, nullptr if none
+    Mapper<BasicBus> *GetMapper() const { return mapper.get(); }
+
+    // CHR-RAM of the inserted cartridge, as held by this machine (see Clone), nullptr if none
+    uint8_t *GetChrRam() { return chrRam.get(); }
+
+    // Pattern tables ($0000 - $1FFF of the PPU address space), split into 1 KiB pages so that
+    // CHR banks are switched the same way as PRG ones
+    static constexpr unsigned int CHR_PAGE_COUNT = 8;
+    static constexpr unsigned int CHR_PAGE_SIZE = 1024;
+
+    // Maps CHR-ROM (read-only) or CHR-RAM to the given pattern table pages, mirrored every size
+    // bytes
+    void MapChrRom(uint8_t firstPage, uint8_t lastPage, const uint8_t *memory, uint32_t size);
+    void MapChrRam(uint8_t firstPage, uint8_t lastPage, uint8_t *memory, uint32_t size);
+
+    // Pattern table pages, for the PPU (nullptr if unmapped, write pages nullptr for CHR-ROM)
+    const uint8_t *const *GetChrReadPages() const { return chrReadPages; }
+    uint8_t *const *GetChrWritePages() const { return chrWritePages; }
+
+public: /* Code caching (see NES6502's decoded block cache) */
+    static constexpr bool CACHES_CODE = true;
+
+    // Host memory holding the code of the given page, nullptr for I/O pages
+    const uint8_t *GetCodePage(uint8_t page) const { return readPages[page]; }
+
+    // Tracking of the writes to the memory of the given page, so that the CPU drops the code
+    // it decoded from it once modified
+    void WatchCodePage(uint8_t page);
+
+    // Clock cycle until which reading the given I/O address again leaves the machine as the
+    // read just made there did, and returns the same bit 7 (N flag), 0 if none: idle loops
+    // polling it for that bit are skipped up to it (see NES6502::SkipIdleLoop)
+    uint64_t GetRepeatableReadEnd(uint16_t addr) const;
+
+    // Page tables, read directly by the JIT's native code (see NES6502Jit)
+    const uint8_t *const *GetReadPages() const { return readPages; }
+    uint8_t *const *GetWritePages() const { return writePages; }
+
+    NES6502<BasicBus, Policy> &GetCpu() { return cpu; }
+    NES2C02 &GetPpu() { return ppu; }
+
+public: /* Snapshots */
+    // Copies the state of the whole machine between two runs, false if the cartridge has more
+    // RAM than a state holds. The stand-in cartridge space of a bus without cartridge isn't part
+    // of it.
+    bool Snapshot(MachineState &state);
+
+    // Same as Snapshot, only copying the RAM and PRG-RAM pages written since the given state
+    // was last saved or restored by this machine (everything otherwise, or without tracking)
+    bool SnapshotIncremental(MachineState &state);
+
+    // Brings the machine back to the given state, false (the machine being left as is) if it
+    // was saved with another layout or cartridge
+    bool Restore(const MachineState &state);
+
+public: /* Cloning */
+    // Copy of the whole machine, e.g. to explore several futures of the same state. The
+    // cartridge (ROM) is shared, and so is the memory, page by page, until either machine
+    // writes to it: cloning costs the registers and page tables plus a reference per page, and
+    // each page written afterwards a 256-byte copy (CHR-RAM being copied whole on the first
+    // pattern table write). Machines and their clones can be destroyed in any order. Settings
+    // (idle loop skipping, render skip) are the clone's own, at the cartridge's defaults.
+    std::unique_ptr<BasicBus> Clone();
+
+public: /* Dirty page tracking (see BUS_DIRTY_TRACKING) */
+    static constexpr bool TRACKS_DIRTY_PAGES = BUS_DIRTY_TRACKING;
+
+    // Pages written since the start of the epoch (non-zero), by CPU address, also marked by the
+    // JIT's native code. An epoch starts with each snapshot and restore.
+    uint8_t *GetDirtyPages() { return dirtyPages; }
+
+public: /* Event scheduling (see Scheduler) */
+    // Runs the CPU up to the given timestamp, stopping at each pending event to dispatch it,
+    // returns the overshoot in clock cycles (see NES6502::RunUntil)
+    uint64_t RunUntil(uint64_t targetCycle) { return RunUntil(cpu, targetCycle); }
+    uint64_t RunCycles(uint64_t budget) { return RunUntil(cpu.GetCycleCount() + budget); }
+
+    // Same through the given execution engine (the CPU itself, NES6502Jit, NES6502Aot), whose
+    // runs end where the CPU's own would (see NES6502::BeginRun)
+    template <typename Engine> uint64_t RunUntil(Engine &engine, uint64_t targetCycle);
+    template <typename Engine> uint64_t RunCycles(Engine &engine, uint64_t budget) {
+        return RunUntil(engine, cpu.GetCycleCount() + budget);
+    }
+
+    // Schedules the given event at the given CPU clock cycle, replacing its pending occurrence
+    // if any. Also valid from I/O handlers, the run in progress ending at the event.
+    void ScheduleEvent(EventType type, uint64_t timestamp) {
+        scheduler.Schedule(type, timestamp);
+        cpu.StopRunAt(timestamp);
+    }
+
+    void CancelEvent(EventType type) { scheduler.Cancel(type); }
+
+    // Interrupt request line, asserted by IRQ events or devices until serviced
+    void AssertIrq() { cpu.SetIrqLine(true); }
+    void AcknowledgeIrq() { cpu.SetIrqLine(false); }
 
-    uint8_t ReadRam(uint16_t addr, bool bReadOnly = false) const;
-    void WriteRam(uint16_t addr, uint8_t data) const;
+private:
+    // Hot data: host memory of each page, nullptr for pages handled by I/O handlers
+    const uint8_t *readPages[PAGE_COUNT];
+    uint8_t *writePages[PAGE_COUNT];
+
+    // Cold data: I/O handlers, only looked up for pages without host memory
+    ReadHandler readHandlers[PAGE_COUNT];
+    WriteHandler writeHandlers[PAGE_COUNT];
+
+    // Pattern table pages (see MapChrRom)
+    const uint8_t *chrReadPages[CHR_PAGE_COUNT];
+    uint8_t *chrWritePages[CHR_PAGE_COUNT];
+
+    // Host memory of the watched pages, whose writes go through WriteCodePage instead
+    uint8_t *watchedPages[PAGE_COUNT];
+
+    // Write handler of the watched pages
+    void WriteCodePage(uint16_t addr, uint8_t data);
+
+    // Stops watching the given memory and invalidates the code decoded from it
+    void ReleaseCodeMemory(const uint8_t *memory);
+
+private: /* Copy-on-write memory (see Clone) */
+    struct MemoryPage {
+        uint8_t data[PAGE_SIZE];
+    };
+
+    // Writable memory mapped to the given CPU pages, mirrored every pageCount pages. Its pages
+    // may be shared with other machines, or be zeros without memory of their own yet (nullptr):
+    // the CPU pages of those are mapped to WriteSharedPage for writing, which first makes them
+    // the machine's own.
+    struct MemoryRegion {
+        std::unique_ptr<std::shared_ptr<MemoryPage>[]> pages;
+        unsigned int pageCount;
+        uint8_t firstPage, lastPage;
+    };
+
+    MemoryRegion ram;            // 2 KiB internal RAM
+    MemoryRegion prgRam;         // PRG-RAM of the cartridge inserted, if any
+    MemoryRegion cartridgeSpace; // Stand-in for the cartridge space ($4100 - $FFFF) until inserted
+
+    // CHR-RAM of the cartridge inserted, nullptr if none, copied before the PPU writes to it if
+    // shared (see WritePpuRegisters)
+    std::shared_ptr<uint8_t[]> chrRam;
+    size_t chrRamSize;
+
+    // Memory of the given page, for reading
+    static const uint8_t *GetPageMemory(const std::shared_ptr<MemoryPage> &page);
+
+    // Whether the given page isn't the machine's own yet
+    static bool IsShared(const std::shared_ptr<MemoryPage> &page) {
+        return !page || page.use_count() > 1;
+    }
+
+    // Creates the given region, of the given size (rounded up to whole pages) and initial
+    // contents (zeros if nullptr), and maps it
+    void CreateRegion(MemoryRegion &region, uint8_t firstPage, uint8_t lastPage,
+                      const uint8_t *contents, size_t size);
+
+    // Region holding the same pages as the given one (of another machine), left unmapped
+    void ShareRegion(MemoryRegion &region, const MemoryRegion &source);
+
+    // Maps the given page of the region to every CPU page mirroring it, shared ones for
+    // reading only
+    void MapRegion(MemoryRegion &region);
+    void MapRegionPage(MemoryRegion &region, unsigned int index);
+
+    // Makes the given page of the region the machine's own, copying it if shared (unless about
+    // to be overwritten whole), and maps it for plain writes
+    uint8_t *UnsharePage(MemoryRegion &region, unsigned int index, bool copy);
+
+    // Write handler of the shared pages
+    void WriteSharedPage(uint16_t addr, uint8_t data);
+
+    // Same as UnsharePage, for CHR-RAM
+    void UnshareChrRam(bool copy);
+
+    // Overwrites the given region up to the given size, invalidating the code decoded from it
+    void RestoreMemory(MemoryRegion &region, const uint8_t *data, size_t size);
+
+private: /* Snapshots */
+    uint8_t dirtyPages[PAGE_COUNT];
+    uint64_t epoch; // Unique across machines, so that states saved by others are told apart
+
+    // Starts a new epoch, no page having been written yet
+    void StartEpoch();
+
+    bool SaveState(MachineState &state, bool incremental);
+
+    // Copy of the given region up to the given size into the state, only of the pages written
+    // to through any of their mirrors if incremental
+    void SaveMemory(uint8_t *data, const MemoryRegion &region, size_t size, bool incremental);
+
+private: /* Cartridge */
+    // Maps the cartridge space to the inserted cartridge and its memory, and its mapper's
+    // power-up banks
+    void MapCartridge();
+
+private: /* Timed events */
+    Scheduler scheduler;
+
+    // Action of the given event, at its timestamp
+    void DispatchEvent(EventType type);
+
+    uint8_t oamDmaPage; // Page copied by the pending OAM DMA (see WriteApuIoRegisters)
+
+    // Copy of a page to the PPU's sprite attribute memory, during which the CPU is halted
+    void RunOamDma();
+
+private: /* I/O handlers */
+    // PPU registers ($2000 - $2007, mirrored up to $3FFF), the PPU being caught up first
+    uint8_t ReadPpuRegisters(uint16_t addr);
+    void WritePpuRegisters(uint16_t addr, uint8_t data);
+
+    // APU and I/O registers ($4000 - $401F) and unused expansion space up to $40FF
+    uint8_t ReadApuIoRegisters(uint16_t addr);
+    void WriteApuIoRegisters(uint16_t addr, uint8_t data);
+
+    // Cartridge space without memory (expansion area, PRG-RAM of boards without any), and
+    // writes to PRG-ROM reaching the mapper's registers (the PPU being caught up first, since
+    // they may switch its banks or mirroring)
+    uint8_t ReadCartridgeSpace(uint16_t addr);
+    void WriteCartridgeSpace(uint16_t addr, uint8_t data);
 };
 
+template <typename Policy>
+inline uint8_t BasicBus<Policy>::ReadRam(uint16_t addr, bool bReadOnly) {
+    // One table lookup, then either one load or an I/O handler call
+    const uint8_t *page = readPages[addr >> 8];
+    if (page)
+        return page[addr & 0x00FF];
+
+    return (this->*readHandlers[addr >> 8])(addr);
+}
+
+template <typename Policy> inline void BasicBus<Policy>::WriteRam(uint16_t addr, uint8_t data) {
+    if constexpr (TRACKS_DIRTY_PAGES)
+        dirtyPages[addr >> 8] = 1;
+
+    uint8_t *page = writePages[addr >> 8];
+    if (page)
+        page[addr & 0x00FF] = data;
+    else
+        (this->*writeHandlers[addr >> 8])(addr, data);
+}
+
+template <typename Policy>
+template <typename Engine>
+uint64_t BasicBus<Policy>::RunUntil(Engine &engine, uint64_t targetCycle) {
+    while (cpu.GetCycleCount() < targetCycle) {
+        // Events due, in timestamp order (dispatching one may schedule others)
+        while (scheduler.GetNextTimestamp() <= cpu.GetCycleCount())
+            DispatchEvent(scheduler.PopNext());
+
+        // Interrupt request asserted by an event, or unmasked during the last run
+        if (cpu.IsIrqPending())
+            cpu.IRQ();
+
+        uint64_t nextTimestamp = scheduler.GetNextTimestamp();
+        engine.RunUntil(nextTimestamp < targetCycle ? nextTimestamp : targetCycle);
+    }
+
+    return cpu.GetCycleCount() - targetCycle;
+}
+
+using Bus = BasicBus<InstructionLevel>;
+using CycleAccurateBus = BasicBus<CycleAccurate>;
+
 #endif // !BUS_H
@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// ROM images are mapped read-only into memory on POSIX systems, the banks being used in place
+// (pages are only read from the file once accessed), and read into memory elsewhere
+#if defined(__unix__) || defined(__APPLE__)
+#define CARTRIDGE_MMAP 1
+#else
+#define CARTRIDGE_MMAP 0
+#endif
+
+// Cartridge loaded from an iNES or NES 2.0 image. The PRG-ROM and CHR-ROM are never copied: the
+// bus and the mappers map them straight into their page tables (see Bus::InsertCartridge).
+class Cartridge {
+public:
+    // Nametable arrangement, as wired on the board (unless controlled by the mapper, the single
+    // screen ones being mapper-controlled only)
+    enum class Mirroring : uint8_t {
+        HORIZONTAL,
+        VERTICAL,
+        FOUR_SCREEN,
+        SINGLE_SCREEN_LOW,
+        SINGLE_SCREEN_HIGH
+    };
+
+    Cartridge();
+    ~Cartridge();
+
+    Cartridge(const Cartridge &) = delete;
+    Cartridge &operator=(const Cartridge &) = delete;
+
+    // Loads the given image, replacing the cartridge loaded beforehand if any. Returns false if
+    // it cannot be read or isn't a valid iNES / NES 2.0 image (see GetError).
+    bool Load(const char *path);
+
+    // Reason the last Load failed
+    const char *GetError() const { return error; }
+
+public: /* Header */
+    bool IsNes20() const { return nes20; }
+    uint16_t GetMapperNumber() const { return mapperNumber; }
+    uint8_t GetSubmapperNumber() const { return submapperNumber; } // NES 2.0 only, 0 otherwise
+    Mirroring GetMirroring() const { return mirroring; }
+    bool HasBattery() const { return battery; }
+
+public: /* Memory */
+    // PRG-ROM and CHR-ROM, in the image itself
+    const uint8_t *GetPrgRom() const { return prgRom; }
+    size_t GetPrgRomSize() const { return prgRomSize; }
+    const uint8_t *GetChrRom() const { return chrRom; }
+    size_t GetChrRomSize() const { return chrRomSize; }
+
+    // PRG-RAM ($6000 - $7FFF, battery-backed or not) and CHR-RAM (boards without CHR-ROM),
+    // 0 if the board has none. Each machine the cartridge is inserted into has its own (see
+    // Bus::InsertCartridge), starting out with the power-up contents of PRG-RAM: cleared but
+    // for the trainer if any, nullptr without PRG-RAM.
+    const uint8_t *GetPrgRam() const { return prgRam.get(); }
+    size_t GetPrgRamSize() const { return prgRamSize; }
+    size_t GetChrRamSize() const { return chrRamSize; }
+
+    // FNV-1a hash of the PRG-ROM then the CHR-ROM, header excluded, e.g. to key caches of data
+    // derived from the ROM. Computed on first use, since it reads the whole image.
+    uint64_t GetHash();
+
+private:
+    // Whole image, mapped or read
+    const uint8_t *image;
+    size_t imageSize;
+#if !CARTRIDGE_MMAP
+    std::unique_ptr<uint8_t[]> imageBuffer;
+#endif
+
+    const char *error;
+
+    bool nes20;
+    uint16_t mapperNumber;
+    uint8_t submapperNumber;
+    Mirroring mirroring;
+    bool battery;
+
+    const uint8_t *prgRom;
+    size_t prgRomSize;
+    const uint8_t *chrRom;
+    size_t chrRomSize;
+
+    std::unique_ptr<uint8_t[]> prgRam; // Power-up contents
+    size_t prgRamSize;
+    size_t chrRamSize;
+
+    uint64_t hash;
+    bool hashed; // Whether hash holds the hash of the current image
+
+    // Maps or reads the image, false if it cannot be read
+    bool OpenImage(const char *path);
+    void CloseImage();
+
+    // Parsing of the header, false if the image isn't valid
+    bool ParseHeader();
+
+    bool Fail(const char *reason) {
+        error = reason;
+        CloseImage();
+        return false;
+    }
+};
+
+#endif // !CARTRIDGE_H
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef FLATBUS_H
+#define FLATBUS_H
+
+#include <cstdint>
+#include <memory>
+
+#include "NES6502.h"
+
+// Flat 64 KiB RAM bus without the NES memory map, e.g. to run 6502 conformance programs, its CPU
+// running with the given execution policy (see NES6502)
+template <typename Policy> class BasicFlatBus {
+    NES6502<BasicFlatBus, Policy> cpu;
+    std::unique_ptr<uint8_t[]> ram; // 64 KiB RAM
+    bool watchedPages[256]; // Pages the CPU decoded code from
+
+public:
+    BasicFlatBus();
+
+    uint8_t ReadRam(uint16_t addr, bool bReadOnly = false) const { return ram[addr]; }
+    void WriteRam(uint16_t addr, uint8_t data) {
+        ram[addr] = data;
+
+        if (watchedPages[addr >> 8]) { // Self-modifying code
+            watchedPages[addr >> 8] = false;
+            cpu.InvalidateCodePage(addr >> 8);
+        }
+    }
+
+    // Code caching (see NES6502's decoded block cache)
+    static constexpr bool CACHES_CODE = true;
+    const uint8_t *GetCodePage(uint8_t page) const { return ram.get() + page * 256; }
+    void WatchCodePage(uint8_t page) { watchedPages[page] = true; }
+
+    // Idle loops (see NES6502::SkipIdleLoop), only reading memory
+    uint64_t GetRepeatableReadEnd(uint16_t addr) const { return 0; }
+
+    NES6502<BasicFlatBus, Policy> &GetCpu() { return cpu; }
+};
+
+using FlatBus = BasicFlatBus<InstructionLevel>;
+using CycleAccurateFlatBus = BasicFlatBus<CycleAccurate>;
+
+#endif // !FLATBUS_H
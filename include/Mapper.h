@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "Cartridge.h"
+
+// Registers of any supported board, plain data for machine snapshots (see Bus::Snapshot)
+struct MapperState {
+    static constexpr unsigned int REGISTERS_SIZE = 32;
+
+    Cartridge::Mirroring mirroring;
+    alignas(8) uint8_t registers[REGISTERS_SIZE]; // Laid out by each board (see SaveRegisters)
+};
+
+// Bank switching hardware of a cartridge board. Banks are selected by repointing the pages of
+// the bus (PRG) and of the pattern tables (CHR), so that accesses cost the same whatever the
+// board, only the register writes ($8000 - $FFFF) reaching the mapper.
+template <typename BusType> class Mapper {
+public:
+    Mapper(BusType &_bus, Cartridge &_cartridge);
+    virtual ~Mapper() = default;
+
+    // Power-up state: registers and banks
+    virtual void Reset() = 0;
+
+    // Write to the cartridge space above $8000
+    virtual void WriteRegister(uint16_t addr, uint8_t data) {}
+
+    // Mapper's scheduled event (EventType::MAPPER), e.g. a counter reaching its IRQ
+    virtual void HandleEvent() {}
+
+    // PPUCTRL or PPUMASK written with the given values (the PPU setup), for the boards watching
+    // the PPU's pattern fetches, e.g. to clock a scanline counter
+    virtual void UpdatePpuSetup(uint8_t ctrl, uint8_t mask) {}
+
+    // Nametable arrangement, either wired on the board or selected by the mapper
+    Cartridge::Mirroring GetMirroring() const { return mirroring; }
+
+    // Register copies, the banks being mapped again from the loaded ones. Pending events are
+    // the scheduler's, restored along with it.
+    virtual void SaveState(MapperState &state) const { state.mirroring = mirroring; }
+    virtual void LoadState(const MapperState &state) { mirroring = state.mirroring; }
+
+protected:
+    BusType &bus;
+    Cartridge &cartridge;
+    Cartridge::Mirroring mirroring;
+
+    // Maps the given PRG-ROM bank (of the given size, negative banks counting from the last
+    // one) to the CPU address space from the given address
+    void MapPrg(uint16_t addr, uint32_t size, int bank);
+
+    // Maps the given CHR-ROM (or CHR-RAM) bank to the pattern tables from the given address
+    void MapChr(uint16_t addr, uint32_t size, int bank);
+
+    // Copies of the board's registers, gathered in a plain struct, to and from the state
+    template <typename Registers>
+    static void SaveRegisters(MapperState &state, const Registers &registers) {
+        static_assert(std::is_trivially_copyable_v<Registers> &&
+                      sizeof(Registers) <= MapperState::REGISTERS_SIZE);
+        std::memcpy(state.registers, &registers, sizeof(Registers));
+    }
+
+    template <typename Registers> static Registers LoadRegisters(const MapperState &state) {
+        static_assert(std::is_trivially_copyable_v<Registers> &&
+                      sizeof(Registers) <= MapperState::REGISTERS_SIZE);
+        Registers registers;
+        std::memcpy(&registers, state.registers, sizeof(Registers));
+        return registers;
+    }
+};
+
+// Mapper of the given cartridge, nullptr if not supported: NROM (0), MMC1 (1), UxROM (2),
+// CNROM (3) or MMC3 (4)
+template <typename BusType>
+std::unique_ptr<Mapper<BusType>> CreateMapper(BusType &bus, Cartridge &cartridge);
+
+#endif // !MAPPER_H
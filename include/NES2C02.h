@@ -0,0 +1,227 @@
+#pragma once
+
+#ifndef NES2C02_H
+#define NES2C02_H
+
+#include <cstdint>
+#include <memory>
+
+#include "Cartridge.h"
+#include "PpuPipeline.h"
+
+// NES picture processing unit (NTSC 2C02). Instead of being clocked three times per CPU cycle,
+// it is caught up to the CPU's timestamp whenever its state is observed or about to change:
+// register accesses, mapper writes (bank switches, mirroring), sprite DMA and its own vertical
+// blank event (see Bus). Catching up renders whole scanlines, or the span of a scanline elapsed
+// since the last catch-up when the state changes mid-scanline (e.g. scroll splits), so that the
+// PPU is entered a few times per frame rather than once per dot.
+// Timing follows PpuTiming (the dot skipped on odd frames is not modeled).
+class NES2C02 {
+public:
+    static constexpr unsigned int SCREEN_WIDTH = 256;
+    static constexpr unsigned int SCREEN_HEIGHT = 240;
+
+    // Pattern tables are accessed through the CHR pages of the bus (see Bus::GetChrReadPages)
+    NES2C02(const uint8_t *const *_chrReadPages, uint8_t *const *_chrWritePages);
+
+    // Registers back to their power-up state, the PPU keeping its timing
+    void Reset();
+
+public: /* CPU interface */
+    // Register access ($2000 - $2007, mirrored up to $3FFF) by the CPU at the given clock cycle
+    uint8_t ReadRegister(uint16_t addr, uint64_t cycle);
+    void WriteRegister(uint16_t addr, uint8_t data, uint64_t cycle);
+
+    // Sprite DMA: fills the sprite attribute memory with the given 256 bytes, from OAMADDR on
+    void WriteOam(const uint8_t *data);
+
+    // NMI output: vertical blank flag, if enabled by PPUCTRL
+    bool IsNmiAsserted() const { return (status & 0x80) && (ctrl & 0x80); }
+
+    // Address PPUDATA accesses next ($0000 - $3FFF), as of the last catch-up
+    uint16_t GetVramAddress() const { return v & 0x3FFF; }
+
+    // PPUCTRL and PPUMASK, as last written
+    uint8_t GetControl() const { return ctrl; }
+    uint8_t GetMask() const { return mask; }
+
+    // Nametable arrangement, wired on the board or selected by the mapper
+    void SetMirroring(Cartridge::Mirroring mirroring);
+
+    // CHR memory of the cartridge (ROM or RAM), the pattern table pages pointing into it, so
+    // that its tiles are decoded once rather than on every fetch (see GetTileRow)
+    void SetChrMemory(const uint8_t *memory, size_t size);
+
+    // Drops the decoded tiles, after CHR memory was modified other than through PPUDATA
+    void InvalidateTileCache();
+
+public: /* Synchronization */
+    // Runs the PPU through the given CPU clock cycle (see PpuTiming)
+    void CatchUp(uint64_t cycle);
+
+    // Calls to CatchUp that had dots to run, and spans of scanlines rendered by them
+    uint64_t GetCatchUpCount() const { return catchUpCount; }
+    uint64_t GetSpanCount() const { return spanCount; }
+
+public: /* Output */
+    // Frame being rendered, complete at vertical blank: NES palette indices (6 bits, color
+    // emphasis left out), SCREEN_WIDTH per row
+    const uint8_t *GetFrameBuffer() const { return frameBuffer[0]; }
+
+    // Frames completed since power-up
+    uint64_t GetFrameCount() const { return frameCount; }
+
+    // Render skip: frames are run without producing pixels, the frame buffer being left as is.
+    // Everything the CPU can observe is still computed (sprite 0 hits, sprite overflow, vertical
+    // blank), only the pixels of sprite 0 being rendered, until it hits. Best switched during
+    // vertical blank, so that every frame is either rendered or skipped whole.
+    void SetRenderSkip(bool skip) { renderSkip = skip; }
+
+public: /* Snapshots */
+    // Whole PPU state, plain data for machine snapshots (see Bus::Snapshot). The frame buffer is
+    // output rather than state and is left out, as are the nametable arrangement (the mapper's)
+    // and the caches derived from CHR memory and OAM.
+    struct State {
+        uint64_t dot;
+        uint64_t catchUpCount, spanCount, frameCount;
+        uint8_t ctrl, mask, status, oamAddr, ioLatch, readBuffer;
+        uint16_t v, t;
+        uint8_t fineX;
+        bool w;
+        uint16_t spanV;
+        uint16_t spanX, spriteZeroX;
+        uint8_t vram[4 * 1024];
+        uint8_t palette[32];
+        uint8_t oam[256];
+        uint8_t spriteLine[SCREEN_WIDTH + 8];
+    };
+
+    void SaveState(State &state) const;
+    void LoadState(const State &state);
+
+private:
+    // Pattern table pages of the bus (1 KiB each, nullptr if unmapped, write pages nullptr for
+    // CHR-ROM)
+    const uint8_t *const *chrReadPages;
+    uint8_t *const *chrWritePages;
+
+    uint64_t dot; // PPU dots run since power-up
+
+    uint64_t catchUpCount;
+    uint64_t spanCount;
+    uint64_t frameCount;
+
+private: /* Registers */
+    uint8_t ctrl;   // PPUCTRL ($2000)
+    uint8_t mask;   // PPUMASK ($2001)
+    uint8_t status; // PPUSTATUS ($2002): vertical blank, sprite 0 hit, sprite overflow
+    uint8_t oamAddr;
+    uint8_t ioLatch;    // Last value written to any register, read back from write-only ones
+    uint8_t readBuffer; // PPUDATA ($2007) reads are delayed by one, but for the palette
+
+    // Loopy's internal registers: current and temporary VRAM addresses (scroll position while
+    // rendering), fine X scroll, and the write toggle shared by $2005 and $2006
+    uint16_t v, t;
+    uint8_t fineX;
+    bool w;
+
+    bool IsRenderingEnabled() const { return mask & 0x18; }
+
+    // Scroll position updates made by the rendering hardware
+    void IncrementY();
+    void CopyX() { v = (v & ~0x041F) | (t & 0x041F); }
+    void CopyY() { v = (v & ~0x7BE0) | (t & 0x7BE0); }
+
+private: /* Memory */
+    uint8_t vram[4 * 1024]; // Nametables: 2 KiB in the console, 2 more on four-screen boards
+    uint8_t palette[32];
+    uint8_t oam[256];
+
+    uint16_t nametableOffsets[4]; // Offset of each nametable in vram, as mirrored
+
+    uint8_t ReadChr(uint16_t addr) const {
+        const uint8_t *page = chrReadPages[addr >> 10];
+        return page ? page[addr & 0x03FF] : 0;
+    }
+
+    // Decoded tiles of the CHR memory, indexed by their offset in it (bank and tile number),
+    // so that bank switches merely repoint the pattern table pages. Tiles are decoded on their
+    // first fetch, and again after a CHR-RAM write to them.
+    const uint8_t *chrMemory;
+    size_t chrTileCount;
+    std::unique_ptr<uint8_t[]> tileCache; // 8 rows of 8 pixels (colors 0 - 3) per tile
+    std::unique_ptr<bool[]> tilesDecoded;
+    uint8_t uncachedTile[8 * 8]; // Tiles of pages outside CHR memory (if any)
+
+    // Decoded row of the pattern at the given address (row in bits 0 - 2)
+    const uint8_t *GetTileRow(uint16_t addr) {
+        static const uint8_t UNMAPPED_ROW[8] = {};
+        const uint8_t *page = chrReadPages[addr >> 10];
+        if (!page)
+            return UNMAPPED_ROW;
+
+        const uint8_t *pattern = page + (addr & 0x03F0);
+        size_t tile = ((uintptr_t)pattern - (uintptr_t)chrMemory) >> 4;
+        if (tile >= chrTileCount || !tilesDecoded[tile])
+            return DecodeTile(pattern, tile) + (addr & 0x07) * 8;
+
+        return &tileCache[tile * 64 + (addr & 0x07) * 8];
+    }
+
+    // Decodes the given pattern into the cache (or uncachedTile), returns its first row
+    const uint8_t *DecodeTile(const uint8_t *pattern, size_t tile);
+
+    uint8_t &Nametable(uint16_t addr) {
+        return vram[nametableOffsets[(addr >> 10) & 0x03] + (addr & 0x03FF)];
+    }
+
+    // $3F10, $3F14, $3F18 and $3F1C mirror the backdrop entries of the background palettes
+    static uint8_t PaletteIndex(uint16_t addr) {
+        return addr & 0x03 ? addr & 0x1F : addr & 0x0F;
+    }
+
+    // PPU address space ($0000 - $3FFF), as accessed through PPUDATA
+    uint8_t ReadVram(uint16_t addr);
+    void WriteVram(uint16_t addr, uint8_t data);
+
+private: /* Rendering */
+    uint8_t frameBuffer[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+    // Scroll position the span being rendered starts from: VRAM address (as loaded at the start
+    // of the scanline or by a PPUADDR write mid-scanline) and pixel it applies from
+    uint16_t spanV;
+    unsigned int spanX;
+
+    // Sprite pixels of the scanline, evaluated on the previous one (see PpuPipeline), and room
+    // for the last sprite to overflow into
+    uint8_t spriteLine[SCREEN_WIDTH + 8];
+
+    // Sprites on each scanline (found one scanline ahead, Y being the scanline above the first
+    // row), found for the whole frame at once and again only once OAM or the sprite height
+    // changed
+    uint64_t spriteMasks[SCREEN_HEIGHT];
+    bool spriteMasksValid;
+
+    bool renderSkip;
+    unsigned int spriteZeroX; // Of sprite 0 on the scanline, SCREEN_WIDTH if not on it
+
+    void InvalidateSprites() { spriteMasksValid = false; }
+
+    // Tiles a span covers at most (33, partial ones at both ends)
+    static constexpr unsigned int SPAN_TILES = SCREEN_WIDTH / 8 + 1;
+
+    // Runs the given dots of a scanline, from fromDot up to toDot excluded
+    void RunScanline(unsigned int scanline, unsigned int fromDot, unsigned int toDot);
+
+    // Renders the given pixels of a visible scanline, from fromX up to toX excluded
+    void RenderSpan(unsigned int scanline, unsigned int fromX, unsigned int toX);
+
+    // Decodes the tiles behind the given pixels into pixels (SPAN_TILES rows), returns the
+    // first pixel
+    const uint8_t *RenderBackground(unsigned int fromX, unsigned int toX, uint8_t *pixels);
+
+    // Sprites of the given scanline, into spriteLine
+    void EvaluateSprites(unsigned int scanline);
+};
+
+#endif // !NES2C02_H
@@ -4,19 +4,536 @@
 #define NES6502_H
 
 #include <cstdint>
-#include <string>
-#include <vector>
+#include <memory>
+
+// Threaded dispatch of decoded blocks through computed gotos (labels as values, a GNU extension
+// of g++ and clang++), a switch elsewhere
+#if defined(__GNUC__)
+#define NES6502_THREADED 1
+#else
+#define NES6502_THREADED 0
+#endif
+
+// Bus-independent part of the CPU, shared by every NES6502 instantiation
+class NES6502Base {
+public: /* Opcode decoding */
+    // Address modes, as compact indices into the address mode handlers
+    enum class AddrMode : uint8_t { IMP, IMM, ZP0, ZPX, ZPY, REL, ABS, ABX, ABY, IND, IZX, IZY };
+
+    // Instructions, as compact indices into the instruction handlers
+    enum class Operation : uint8_t {
+        ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC,
+        CLD, CLI, CLV, CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, JMP,
+        JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, ROL, ROR, RTI,
+        RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA, XXX
+    };
+
+    // Hot decoding data, 4 bytes per opcode so the whole table stays cache resident
+    struct Instruction {
+        // Instruction
+        Operation operation;
+
+        // Address mode
+        AddrMode addrMode;
+
+        // Base clock cycles required for the instruction
+        uint8_t cycles;
+
+        // Whether the instruction takes an additional clock cycle when the address mode
+        // crosses a page boundary (see R650X datasheet, "Instruction set summary" table)
+        uint8_t pageCross;
+    };
+
+    using is = Operation;
+    using am = AddrMode;
+    // Lookup table in which the index is the instruction's opcode (1 byte)
+    // Shared by every CPU instance and built at compile time
+    static constexpr Instruction instructionSetLookup[256] = {
+        // 0x00 - 0x0F
+        {is::BRK, am::IMM, 7, 0},
+        {is::ORA, am::IZX, 6, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 3, 1},
+        {is::ORA, am::ZP0, 3, 1},
+        {is::ASL, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::PHP, am::IMP, 3, 0},
+        {is::ORA, am::IMM, 2, 1},
+        {is::ASL, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::ORA, am::ABS, 4, 1},
+        {is::ASL, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0x10 - 0x1F
+        {is::BPL, am::REL, 2, 0},
+        {is::ORA, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::ORA, am::ZPX, 4, 1},
+        {is::ASL, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::CLC, am::IMP, 2, 0},
+        {is::ORA, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::ORA, am::ABX, 4, 1},
+        {is::ASL, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0},
+
+        // 0x20 - 0x2F
+        {is::JSR, am::ABS, 6, 0},
+        {is::AND, am::IZX, 6, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::BIT, am::ZP0, 3, 0},
+        {is::AND, am::ZP0, 3, 1},
+        {is::ROL, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::PLP, am::IMP, 4, 0},
+        {is::AND, am::IMM, 2, 1},
+        {is::ROL, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::BIT, am::ABS, 4, 0},
+        {is::AND, am::ABS, 4, 1},
+        {is::ROL, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0x30 - 0x3F
+        {is::BMI, am::REL, 2, 0},
+        {is::AND, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::AND, am::ZPX, 4, 1},
+        {is::ROL, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::SEC, am::IMP, 2, 0},
+        {is::AND, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::AND, am::ABX, 4, 1},
+        {is::ROL, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0},
+
+        // 0x40 - 0x4F
+        {is::RTI, am::IMP, 6, 0},
+        {is::EOR, am::IZX, 6, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 3, 1},
+        {is::EOR, am::ZP0, 3, 1},
+        {is::LSR, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::PHA, am::IMP, 3, 0},
+        {is::EOR, am::IMM, 2, 1},
+        {is::LSR, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::JMP, am::ABS, 3, 0},
+        {is::EOR, am::ABS, 4, 1},
+        {is::LSR, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0x50 - 0x5F
+        {is::BVC, am::REL, 2, 0},
+        {is::EOR, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::EOR, am::ZPX, 4, 1},
+        {is::LSR, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::CLI, am::IMP, 2, 0},
+        {is::EOR, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::EOR, am::ABX, 4, 1},
+        {is::LSR, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0},
+
+        // 0x60 - 0x6F
+        {is::RTS, am::IMP, 6, 0},
+        {is::ADC, am::IZX, 6, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 3, 1},
+        {is::ADC, am::ZP0, 3, 1},
+        {is::ROR, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::PLA, am::IMP, 4, 0},
+        {is::ADC, am::IMM, 2, 1},
+        {is::ROR, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::JMP, am::IND, 5, 0},
+        {is::ADC, am::ABS, 4, 1},
+        {is::ROR, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0x70 - 0x7F
+        {is::BVS, am::REL, 2, 0},
+        {is::ADC, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::ADC, am::ZPX, 4, 1},
+        {is::ROR, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::SEI, am::IMP, 2, 0},
+        {is::ADC, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::ADC, am::ABX, 4, 1},
+        {is::ROR, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0},
+
+        // 0x80 - 0x8F
+        {is::NOP, am::IMP, 2, 1},
+        {is::STA, am::IZX, 6, 0},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 6, 0},
+        {is::STY, am::ZP0, 3, 0},
+        {is::STA, am::ZP0, 3, 0},
+        {is::STX, am::ZP0, 3, 0},
+        {is::XXX, am::IMP, 3, 0},
+        {is::DEY, am::IMP, 2, 0},
+        {is::NOP, am::IMP, 2, 1},
+        {is::TXA, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::STY, am::ABS, 4, 0},
+        {is::STA, am::ABS, 4, 0},
+        {is::STX, am::ABS, 4, 0},
+        {is::XXX, am::IMP, 4, 0},
+
+        // 0x90 - 0x9F
+        {is::BCC, am::REL, 2, 0},
+        {is::STA, am::IZY, 6, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::STY, am::ZPX, 4, 0},
+        {is::STA, am::ZPX, 4, 0},
+        {is::STX, am::ZPY, 4, 0},
+        {is::XXX, am::IMP, 4, 0},
+        {is::TYA, am::IMP, 2, 0},
+        {is::STA, am::ABY, 5, 0},
+        {is::TXS, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::NOP, am::IMP, 5, 1},
+        {is::STA, am::ABX, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+
+        // 0xA0 - 0xAF
+        {is::LDY, am::IMM, 2, 1},
+        {is::LDA, am::IZX, 6, 1},
+        {is::LDX, am::IMM, 2, 1},
+        {is::XXX, am::IMP, 6, 0},
+        {is::LDY, am::ZP0, 3, 1},
+        {is::LDA, am::ZP0, 3, 1},
+        {is::LDX, am::ZP0, 3, 1},
+        {is::XXX, am::IMP, 3, 0},
+        {is::TAY, am::IMP, 2, 0},
+        {is::LDA, am::IMM, 2, 1},
+        {is::TAX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::LDY, am::ABS, 4, 1},
+        {is::LDA, am::ABS, 4, 1},
+        {is::LDX, am::ABS, 4, 1},
+        {is::XXX, am::IMP, 4, 0},
+
+        // 0xB0 - 0xBF
+        {is::BCS, am::REL, 2, 0},
+        {is::LDA, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::LDY, am::ZPX, 4, 1},
+        {is::LDA, am::ZPX, 4, 1},
+        {is::LDX, am::ZPY, 4, 1},
+        {is::XXX, am::IMP, 4, 0},
+        {is::CLV, am::IMP, 2, 0},
+        {is::LDA, am::ABY, 4, 1},
+        {is::TSX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 4, 0},
+        {is::LDY, am::ABX, 4, 1},
+        {is::LDA, am::ABX, 4, 1},
+        {is::LDX, am::ABY, 4, 1},
+        {is::XXX, am::IMP, 4, 0},
+
+        // 0xC0 - 0xCF
+        {is::CPY, am::IMM, 2, 0},
+        {is::CMP, am::IZX, 6, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 8, 0},
+        {is::CPY, am::ZP0, 3, 0},
+        {is::CMP, am::ZP0, 3, 1},
+        {is::DEC, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::INY, am::IMP, 2, 0},
+        {is::CMP, am::IMM, 2, 1},
+        {is::DEX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 2, 0},
+        {is::CPY, am::ABS, 4, 0},
+        {is::CMP, am::ABS, 4, 1},
+        {is::DEC, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0xD0 - 0xDF
+        {is::BNE, am::REL, 2, 0},
+        {is::CMP, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::CMP, am::ZPX, 4, 1},
+        {is::DEC, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::CLD, am::IMP, 2, 0},
+        {is::CMP, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::CMP, am::ABX, 4, 1},
+        {is::DEC, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0},
+
+        // 0xE0 - 0xEF
+        {is::CPX, am::IMM, 2, 0},
+        {is::SBC, am::IZX, 6, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 8, 0},
+        {is::CPX, am::ZP0, 3, 0},
+        {is::SBC, am::ZP0, 3, 1},
+        {is::INC, am::ZP0, 5, 0},
+        {is::XXX, am::IMP, 5, 0},
+        {is::INX, am::IMP, 2, 0},
+        {is::SBC, am::IMM, 2, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::SBC, am::IMP, 2, 1},
+        {is::CPX, am::ABS, 4, 0},
+        {is::SBC, am::ABS, 4, 1},
+        {is::INC, am::ABS, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+
+        // 0xF0 - 0xFF
+        {is::BEQ, am::REL, 2, 0},
+        {is::SBC, am::IZY, 5, 1},
+        {is::XXX, am::IMP, 2, 0},
+        {is::XXX, am::IMP, 8, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::SBC, am::ZPX, 4, 1},
+        {is::INC, am::ZPX, 6, 0},
+        {is::XXX, am::IMP, 6, 0},
+        {is::SED, am::IMP, 2, 0},
+        {is::SBC, am::ABY, 4, 1},
+        {is::NOP, am::IMP, 2, 1},
+        {is::XXX, am::IMP, 7, 0},
+        {is::NOP, am::IMP, 4, 1},
+        {is::SBC, am::ABX, 4, 1},
+        {is::INC, am::ABX, 7, 0},
+        {is::XXX, am::IMP, 7, 0}
+
+    };
+
+    // Number of operand bytes following the opcode, indexed by AddrMode
+    static constexpr uint8_t operandLengthLookup[] = {0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 1, 1};
+
+    // Whether the instruction only reads its operand into registers and flags: no write, no
+    // stack access, no change of the interrupt mask (see NES6502::SkipIdleLoop)
+    static constexpr bool IsReadOnly(Operation operation) {
+        switch (operation) {
+        case is::AND:
+        case is::BIT:
+        case is::CMP:
+        case is::CPX:
+        case is::CPY:
+        case is::EOR:
+        case is::LDA:
+        case is::LDX:
+        case is::LDY:
+        case is::NOP:
+        case is::ORA:
+        case is::TAX:
+        case is::TAY:
+        case is::TXA:
+        case is::TYA:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Whether the instruction may write memory (stores, read-modify-writes, stack pushes), and
+    // so modify code
+    static constexpr bool WritesMemory(Instruction instruction) {
+        switch (instruction.operation) {
+        case is::STA:
+        case is::STX:
+        case is::STY:
+        case is::INC:
+        case is::DEC:
+        case is::PHA:
+        case is::PHP:
+        case is::JSR:
+        case is::BRK:
+            return true;
+        case is::ASL:
+        case is::LSR:
+        case is::ROL:
+        case is::ROR:
+            return instruction.addrMode != am::IMP;
+        default:
+            return false;
+        }
+    }
+
+    // Whether the instruction ends a basic block, i.e. may not continue with the next opcode
+    static constexpr bool EndsBasicBlock(Operation operation) {
+        switch (operation) {
+        case is::BCC:
+        case is::BCS:
+        case is::BEQ:
+        case is::BMI:
+        case is::BNE:
+        case is::BPL:
+        case is::BVC:
+        case is::BVS:
+        case is::BRK:
+        case is::JMP:
+        case is::JSR:
+        case is::RTI:
+        case is::RTS:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Register file with the lazily evaluated flags, as copied in and out by the execution
+    // engines working outside of the CPU (see NES6502Jit, NES6502Aot)
+    struct Registers {
+        uint64_t clockCount; // Including the cycles of the instruction being run
+        uint16_t pc;
+        uint16_t lazyNZ;
+        uint8_t a, x, y, stkp;
+        uint8_t lazyC, lazyV1, lazyV2, lazyVResult;
+        uint8_t status; // I, D, B and U flags only
+    };
+
+    // Whole CPU state between two runs, plain data for machine snapshots (see Bus::Snapshot)
+    struct State {
+        Registers registers;
+        uint16_t operand, addr_abs, addr_rel;
+        uint8_t fetchedData, opcode;
+        bool irqLine;
+        uint64_t idleCycleCount;
+    };
+
+    // Cold disassembly data, kept apart from the lookup table above
+    static constexpr char mnemonicLookup[256][4] = {
+        // 0x00 - 0x0F
+        "BRK", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+        "PHP", "ORA", "ASL", "???", "???", "ORA", "ASL", "???",
+
+        // 0x10 - 0x1F
+        "BPL", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+        "CLC", "ORA", "???", "???", "???", "ORA", "ASL", "???",
+
+        // 0x20 - 0x2F
+        "JSR", "AND", "???", "???", "BIT", "AND", "ROL", "???",
+        "PLP", "AND", "ROL", "???", "BIT", "AND", "ROL", "???",
+
+        // 0x30 - 0x3F
+        "BMI", "AND", "???", "???", "???", "AND", "ROL", "???",
+        "SEC", "AND", "???", "???", "???", "AND", "ROL", "???",
+
+        // 0x40 - 0x4F
+        "RTI", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+        "PHA", "EOR", "LSR", "???", "JMP", "EOR", "LSR", "???",
+
+        // 0x50 - 0x5F
+        "BVC", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+        "CLI", "EOR", "???", "???", "???", "EOR", "LSR", "???",
+
+        // 0x60 - 0x6F
+        "RTS", "ADC", "???", "???", "???", "ADC", "ROR", "???",
+        "PLA", "ADC", "ROR", "???", "JMP", "ADC", "ROR", "???",
+
+        // 0x70 - 0x7F
+        "BVS", "ADC", "???", "???", "???", "ADC", "ROR", "???",
+        "SEI", "ADC", "???", "???", "???", "ADC", "ROR", "???",
 
-class Bus;
+        // 0x80 - 0x8F
+        "???", "STA", "???", "???", "STY", "STA", "STX", "???",
+        "DEY", "???", "TXA", "???", "STY", "STA", "STX", "???",
+
+        // 0x90 - 0x9F
+        "BCC", "STA", "???", "???", "STY", "STA", "STX", "???",
+        "TYA", "STA", "TXS", "???", "???", "STA", "???", "???",
+
+        // 0xA0 - 0xAF
+        "LDY", "LDA", "LDX", "???", "LDY", "LDA", "LDX", "???",
+        "TAY", "LDA", "TAX", "???", "LDY", "LDA", "LDX", "???",
+
+        // 0xB0 - 0xBF
+        "BCS", "LDA", "???", "???", "LDY", "LDA", "LDX", "???",
+        "CLV", "LDA", "TSX", "???", "LDY", "LDA", "LDX", "???",
+
+        // 0xC0 - 0xCF
+        "CPY", "CMP", "???", "???", "CPY", "CMP", "DEC", "???",
+        "INY", "CMP", "DEX", "???", "CPY", "CMP", "DEC", "???",
 
-class NES6502 {
+        // 0xD0 - 0xDF
+        "BNE", "CMP", "???", "???", "???", "CMP", "DEC", "???",
+        "CLD", "CMP", "NOP", "???", "???", "CMP", "DEC", "???",
+
+        // 0xE0 - 0xEF
+        "CPX", "SBC", "???", "???", "CPX", "SBC", "INC", "???",
+        "INX", "SBC", "NOP", "???", "CPX", "SBC", "INC", "???",
+
+        // 0xF0 - 0xFF
+        "BEQ", "SBC", "???", "???", "???", "SBC", "INC", "???",
+        "SED", "SBC", "NOP", "???", "???", "SBC", "INC", "???"
+    };
+};
+
+// Execution policies, selecting how the CPU spends the cycles of an instruction on the bus
+
+// Whole instructions at once: every access of an instruction is made at its first cycle and
+// only the accesses needed by its result are made (fastest)
+struct InstructionLevel {
+    static constexpr bool CYCLE_ACCURATE = false;
+};
+
+// Every bus cycle of an instruction in order, dummy reads and writes included, each access being
+// made at its own cycle (see GetBusCycleCount) for the devices whose state depends on it
+struct CycleAccurate {
+    static constexpr bool CYCLE_ACCURATE = true;
+};
+
+// The bus type is a template parameter so that memory accesses are inlined into the core, and
+// so is the execution policy, both policies being built from the same instruction handlers
+// (see the explicit instantiations at the end of NES6502.cpp for the supported combinations)
+template <typename BusType, typename Policy = InstructionLevel>
+class NES6502 : public NES6502Base {
 public:
-    NES6502(Bus *_bus);
+    NES6502(BusType *_bus);
+
+    // The JIT works on copies of the registers and compiles the decoded blocks
+    template <typename> friend class NES6502Jit;
 
-private:      /* Memory access */
-    Bus *bus; // The bus the CPU is connected to
-    uint8_t ReadRam(uint16_t addr) const;
-    void WriteRam(uint16_t addr, uint8_t data) const;
+private:          /* Memory access */
+    BusType *bus; // The bus the CPU is connected to
+    uint8_t ReadRam(uint16_t addr);
+    void WriteRam(uint16_t addr, uint8_t data);
+
+    // Accesses whose data is discarded, only made on the bus with the cycle-accurate policy
+    void DummyRead(uint16_t addr);
+    void DummyWrite(uint16_t addr, uint8_t data);
 
 private: /* CPU flags */
     enum FLAGS {
@@ -38,10 +555,36 @@ private:            /* CPU registers */
     uint16_t pc;    // Program counter
     uint8_t status; // Status register
 
+private:                    /* Lazily evaluated flags */
+    uint16_t lazyNZ;        // Last result: Z if its low byte is 0, N if bit 7 or 8 is set
+    uint8_t lazyC;          // Last carry out
+    uint8_t lazyV1, lazyV2; // Last operands of a signed addition...
+    uint8_t lazyVResult;    // ...and its result, V if it overflowed
+
+    // Recording of the last result and operands, the flags being derived only when observed
+    void RecordNZ(uint16_t result) { lazyNZ = result; }
+    void RecordC(bool carry) { lazyC = carry; }
+    void RecordV(uint8_t operand1, uint8_t operand2, uint8_t result) {
+        lazyV1 = operand1;
+        lazyV2 = operand2;
+        lazyVResult = result;
+    }
+
 private: /* Status register access */
     uint8_t GetFlag(FLAGS flag);
     void SetFlag(FLAGS flag, bool value);
 
+    // Status register with the lazily evaluated flags packed in, e.g. to push it on the stack
+    uint8_t GetStatus();
+
+    // Status register update, e.g. when pulled from the stack
+    void SetStatus(uint8_t value);
+
+    bool irqLine; // Interrupt request line (see SetIrqLine)
+
+    // Ends the run after the current instruction if it unmasked a pending interrupt request
+    void CheckIrqUnmasked();
+
 public: /* Address modes */
     // Implied address mode
     uint8_t IMP();
@@ -81,13 +624,13 @@ public: /* Address modes */
 
 public: /* Instruction set */
     // Add memory to accumulator with carry
-    uint8_t ADC();
+    template <AddrMode mode> uint8_t ADC();
 
     // AND memory with accumulator
-    uint8_t AND();
+    template <AddrMode mode> uint8_t AND();
 
     // Shift left one bit (memory or accumulator)
-    uint8_t ASL();
+    template <AddrMode mode> uint8_t ASL();
 
     // Branch on carry clear
     uint8_t BCC();
@@ -99,7 +642,7 @@ public: /* Instruction set */
     uint8_t BEQ();
 
     // Test bits in memory with accumulator
-    uint8_t BIT();
+    template <AddrMode mode> uint8_t BIT();
 
     // Branch on result minus
     uint8_t BMI();
@@ -132,16 +675,16 @@ public: /* Instruction set */
     uint8_t CLV();
 
     // Compare memory with accumulator
-    uint8_t CMP();
+    template <AddrMode mode> uint8_t CMP();
 
     // Compare memory and index X
-    uint8_t CPX();
+    template <AddrMode mode> uint8_t CPX();
 
     // Compare memory and index Y
-    uint8_t CPY();
+    template <AddrMode mode> uint8_t CPY();
 
     // Decrement memory by one
-    uint8_t DEC();
+    template <AddrMode mode> uint8_t DEC();
 
     // Decrement index X by one
     uint8_t DEX();
@@ -150,10 +693,10 @@ public: /* Instruction set */
     uint8_t DEY();
 
     // Exclusive-OR memory with accumulator
-    uint8_t EOR();
+    template <AddrMode mode> uint8_t EOR();
 
     // Increment memory by one
-    uint8_t INC();
+    template <AddrMode mode> uint8_t INC();
 
     // Increment index X by one
     uint8_t INX();
@@ -168,22 +711,22 @@ public: /* Instruction set */
     uint8_t JSR();
 
     // Load accumulator with memory
-    uint8_t LDA();
+    template <AddrMode mode> uint8_t LDA();
 
     // Load index X with memory
-    uint8_t LDX();
+    template <AddrMode mode> uint8_t LDX();
 
     // Load index Y with memory
-    uint8_t LDY();
+    template <AddrMode mode> uint8_t LDY();
 
     // Shift one bit right (memory or accumulator)
-    uint8_t LSR();
+    template <AddrMode mode> uint8_t LSR();
 
     // No operation
     uint8_t NOP();
 
     // OR memory with accumulator
-    uint8_t ORA();
+    template <AddrMode mode> uint8_t ORA();
 
     // Push accumulator on stack
     uint8_t PHA();
@@ -198,10 +741,10 @@ public: /* Instruction set */
     uint8_t PLP();
 
     // Rotate one bit left (memory or accumulator)
-    uint8_t ROL();
+    template <AddrMode mode> uint8_t ROL();
 
     // Rotate one bit right (memory or accumulator)
-    uint8_t ROR();
+    template <AddrMode mode> uint8_t ROR();
 
     // Return from interrupt
     uint8_t RTI();
@@ -210,7 +753,7 @@ public: /* Instruction set */
     uint8_t RTS();
 
     // Subtract memory from accumulator with borrow
-    uint8_t SBC();
+    template <AddrMode mode> uint8_t SBC();
 
     // Set carry flag
     uint8_t SEC();
@@ -252,336 +795,182 @@ public: /* Instruction set */
     // Unique to this emulator implementation
     uint8_t XXX();
 
-    struct Instruction {
-        // Instruction mnemonic
-        std::string name;
-
-        // Instruction function pointer
-        uint8_t (NES6502::*instruction)(void);
-
-        // Address mode function pointer
-        uint8_t (NES6502::*addrMode)(void);
-
-        // Clock cycles required for the instruction
-        uint8_t cycles;
-    };
-
-    using is = NES6502;
-    using am = NES6502;
-    // Lookup table in which the index is the instruction's opcode (1 byte)
-    const std::vector<Instruction> instructionSetLookup = {
-        // 0x00 - 0x0F
-        {"BRK", &is::BRK, &am::IMM, 7},
-        {"ORA", &is::ORA, &am::IZX, 6},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 3},
-        {"ORA", &is::ORA, &am::ZP0, 3},
-        {"ASL", &is::ASL, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"PHP", &is::PHP, &am::IMP, 3},
-        {"ORA", &is::ORA, &am::IMM, 2},
-        {"ASL", &is::ASL, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"ORA", &is::ORA, &am::ABS, 4},
-        {"ASL", &is::ASL, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-
-        // 0x10 - 0x1F
-        {"BPL", &is::BPL, &am::REL, 2},
-        {"ORA", &is::ORA, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"ORA", &is::ORA, &am::ZPX, 4},
-        {"ASL", &is::ASL, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"CLC", &is::CLC, &am::IMP, 2},
-        {"ORA", &is::ORA, &am::ABY, 4},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"ORA", &is::ORA, &am::ABX, 4},
-        {"ASL", &is::ASL, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7},
+public: /* CPU signals */
+    // Clock signal (synchronous)
+    void Clock();
 
-        // 0x20 - 0x2F
-        {"JSR", &is::JSR, &am::ABS, 6},
-        {"AND", &is::AND, &am::IZX, 6},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"BIT", &is::BIT, &am::ZP0, 3},
-        {"AND", &is::AND, &am::ZP0, 3},
-        {"ROL", &is::ROL, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"PLP", &is::PLP, &am::IMP, 4},
-        {"AND", &is::AND, &am::IMM, 2},
-        {"ROL", &is::ROL, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"BIT", &is::BIT, &am::ABS, 4},
-        {"AND", &is::AND, &am::ABS, 4},
-        {"ROL", &is::ROL, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
+    // Reset signal (asynchronous)
+    void Reset();
 
-        // 0x30 - 0x3F
-        {"BMI", &is::BMI, &am::REL, 2},
-        {"AND", &is::AND, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"AND", &is::AND, &am::ZPX, 4},
-        {"ROL", &is::ROL, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"SEC", &is::SEC, &am::IMP, 2},
-        {"AND", &is::AND, &am::ABY, 4},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"AND", &is::AND, &am::ABX, 4},
-        {"ROL", &is::ROL, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7},
+    // Interrupt request signal (asynchronous)
+    void IRQ();
 
-        // 0x40 - 0x4F
-        {"RTI", &is::RTI, &am::IMP, 6},
-        {"EOR", &is::EOR, &am::IZX, 6},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 3},
-        {"EOR", &is::EOR, &am::ZP0, 3},
-        {"LSR", &is::LSR, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"PHA", &is::PHA, &am::IMP, 3},
-        {"EOR", &is::EOR, &am::IMM, 2},
-        {"LSR", &is::LSR, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"JMP", &is::JMP, &am::ABS, 3},
-        {"EOR", &is::EOR, &am::ABS, 4},
-        {"LSR", &is::LSR, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
+    // Non-maskable interrupt request signal (asynchronous)
+    void NMI();
 
-        // 0x50 - 0x5F
-        {"BVC", &is::BVC, &am::REL, 2},
-        {"EOR", &is::EOR, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"EOR", &is::EOR, &am::ZPX, 4},
-        {"LSR", &is::LSR, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"CLI", &is::CLI, &am::IMP, 2},
-        {"EOR", &is::EOR, &am::ABY, 4},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"EOR", &is::EOR, &am::ABX, 4},
-        {"LSR", &is::LSR, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7},
+    // Level of the interrupt request line, held by the devices until acknowledged. The CPU
+    // doesn't check it between instructions: its owner takes the interrupt (IRQ) between runs,
+    // and a run ends early whenever an instruction unmasks a pending interrupt.
+    void SetIrqLine(bool asserted) { irqLine = asserted; }
+    bool IsIrqPending() { return irqLine && !GetFlag(I); }
+
+public: /* Batch execution */
+    // Runs whole instructions until at least the given amount of clock cycles has elapsed,
+    // returns the overshoot in clock cycles
+    uint64_t RunCycles(uint64_t budget);
+
+    // Runs whole instructions until the running cycle counter reaches the given timestamp, or
+    // the earlier one the run was stopped at (see StopRunAt), returns the overshoot in clock
+    // cycles
+    uint64_t RunUntil(uint64_t targetCycle);
+
+    // Brings the end of the run in progress forward to the given timestamp, e.g. for an event
+    // scheduled by an I/O access during the run (the overshoot is then counted from it)
+    void StopRunAt(uint64_t cycle) {
+        if (cycle < runTarget)
+            runTarget = cycle;
+    }
+
+    // Runs made by the execution engines in place of RunUntil (see NES6502Jit, NES6502Aot):
+    // started up to the given timestamp, then ended once the cycle counter reaches the run
+    // target, brought forward by StopRunAt as in RunUntil. The instructions the engines leave to
+    // the interpreter are run one at a time as part of it.
+    void BeginRun(uint64_t targetCycle) { runTarget = targetCycle; }
+    uint64_t GetRunTarget() const { return runTarget; }
+    void RunInstruction();
+
+    // Halts the CPU for the given amount of clock cycles between two instructions (DMA)
+    void Stall(uint32_t cycleCount) { clockCount += cycleCount; }
+
+    // Idle loops (e.g. waiting for the NMI handler to set a flag) are run once, then skipped up
+    // to the end of the run (the next event) at once, see SkipIdleLoop. On by default, off for
+    // the games that should be run instruction by instruction regardless.
+    void SetIdleLoopSkipping(bool enabled) { idleLoopSkipping = enabled; }
+    bool IsIdleLoopSkipping() const { return idleLoopSkipping; }
+
+    // Clock cycles skipped in idle loops since power-up
+    uint64_t GetIdleCycleCount() const { return idleCycleCount; }
+
+    // Clock cycles elapsed since power-up, used to synchronize other components
+    uint64_t GetCycleCount() const { return clockCount; }
+
+    // Clock cycle of the bus access in progress: its exact cycle with the cycle-accurate policy,
+    // the first cycle of its instruction otherwise
+    uint64_t GetBusCycleCount() const { return clockCount + busCycles; }
+
+    // Register file copies, for the execution engines working outside of the CPU
+    void SaveRegisters(Registers &registers) const;
+    void LoadRegisters(const Registers &registers);
+
+    // Whether both CPUs, and the host memory of their buses, hold the same state (differential
+    // testing of the execution engines against the interpreter)
+    bool MatchesState(NES6502 &other);
+
+    // Whole state copies, between runs (see Bus::Snapshot)
+    void SaveState(State &state) const;
+    void LoadState(const State &state);
+
+public: /* Decoded block cache */
+    // Invalidation of the decoded blocks covering the given page, called by the bus whenever
+    // the code it holds may have changed (write, remapping)
+    void InvalidateCodePage(uint8_t page);
+
+    // Invalidation of every decoded block
+    void InvalidateCode();
+
+    // Bumped on every invalidation, for the execution engines caching code of their own
+    uint32_t GetCodeGeneration() const { return codeGeneration; }
+
+private:
+    static constexpr unsigned int MAX_BLOCK_INSTRUCTIONS = 16;
+    static constexpr unsigned int BLOCK_CACHE_SIZE = 512; // Power of 2
+
+    // Pre-decoded instruction, its handler being selected by the opcode
+    struct DecodedInstruction {
+        uint16_t operand; // Operand bytes following the opcode
+        uint8_t opcode;
+    };
 
-        // 0x60 - 0x6F
-        {"RTS", &is::RTS, &am::IMP, 6},
-        {"ADC", &is::ADC, &am::IZX, 6},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 3},
-        {"ADC", &is::ADC, &am::ZP0, 3},
-        {"ROR", &is::ROR, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"PLA", &is::PLA, &am::IMP, 4},
-        {"ADC", &is::ADC, &am::IMM, 2},
-        {"ROR", &is::ROR, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"JMP", &is::JMP, &am::IND, 5},
-        {"ADC", &is::ADC, &am::ABS, 4},
-        {"ROR", &is::ROR, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
+    // Straight-line run of instructions, up to the next branch, jump, return or interrupt
+    struct DecodedBlock {
+        uint16_t startPc;
+        uint8_t length; // Number of instructions, 0 for an empty slot
+        uint8_t firstPage, lastPage;
+        bool idleLoop; // Branching back to its start, only reading (see SkipIdleLoop)
+        uint32_t firstPageGeneration, lastPageGeneration; // Generations of the pages at decoding
+        DecodedInstruction instructions[MAX_BLOCK_INSTRUCTIONS];
+    };
 
-        // 0x70 - 0x7F
-        {"BVS", &is::BVS, &am::REL, 2},
-        {"ADC", &is::ADC, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"ADC", &is::ADC, &am::ZPX, 4},
-        {"ROR", &is::ROR, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"SEI", &is::SEI, &am::IMP, 2},
-        {"ADC", &is::ADC, &am::ABY, 4},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"ADC", &is::ADC, &am::ABX, 4},
-        {"ROR", &is::ROR, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7},
+    struct BlockCache {
+        DecodedBlock blocks[BLOCK_CACHE_SIZE]; // Direct-mapped, keyed by the start PC
+        uint32_t pageGenerations[256];          // Bumped whenever a page's code may have changed
+    };
 
-        // 0x80 - 0x8F
-        {"???", &is::NOP, &am::IMP, 2},
-        {"STA", &is::STA, &am::IZX, 6},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"STY", &is::STY, &am::ZP0, 3},
-        {"STA", &is::STA, &am::ZP0, 3},
-        {"STX", &is::STX, &am::ZP0, 3},
-        {"???", &is::XXX, &am::IMP, 3},
-        {"DEY", &is::DEY, &am::IMP, 2},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"TXA", &is::TXA, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"STY", &is::STY, &am::ABS, 4},
-        {"STA", &is::STA, &am::ABS, 4},
-        {"STX", &is::STX, &am::ABS, 4},
-        {"???", &is::XXX, &am::IMP, 4},
+    // Only allocated on first use, for buses whose code can be cached (BusType::CACHES_CODE)
+    std::unique_ptr<BlockCache> blockCache;
+    uint32_t codeGeneration; // Bumped on every invalidation, to catch self-modifying blocks
 
-        // 0x90 - 0x9F
-        {"BCC", &is::BCC, &am::REL, 2},
-        {"STA", &is::STA, &am::IZY, 6},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"STY", &is::STY, &am::ZPX, 4},
-        {"STA", &is::STA, &am::ZPX, 4},
-        {"STX", &is::STX, &am::ZPY, 4},
-        {"???", &is::XXX, &am::IMP, 4},
-        {"TYA", &is::TYA, &am::IMP, 2},
-        {"STA", &is::STA, &am::ABY, 5},
-        {"TXS", &is::TXS, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"???", &is::NOP, &am::IMP, 5},
-        {"STA", &is::STA, &am::ABX, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"???", &is::XXX, &am::IMP, 5},
+    // Decoded block starting at the given address, nullptr if the code can't be cached
+    const DecodedBlock *FindBlock(uint16_t addr);
 
-        // 0xA0 - 0xAF
-        {"LDY", &is::LDY, &am::IMM, 2},
-        {"LDA", &is::LDA, &am::IZX, 6},
-        {"LDX", &is::LDX, &am::IMM, 2},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"LDY", &is::LDY, &am::ZP0, 3},
-        {"LDA", &is::LDA, &am::ZP0, 3},
-        {"LDX", &is::LDX, &am::ZP0, 3},
-        {"???", &is::XXX, &am::IMP, 3},
-        {"TAY", &is::TAY, &am::IMP, 2},
-        {"LDA", &is::LDA, &am::IMM, 2},
-        {"TAX", &is::TAX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"LDY", &is::LDY, &am::ABS, 4},
-        {"LDA", &is::LDA, &am::ABS, 4},
-        {"LDX", &is::LDX, &am::ABS, 4},
-        {"???", &is::XXX, &am::IMP, 4},
+    // Decoding of the block starting at the given address, false if the code can't be cached
+    bool DecodeBlock(uint16_t addr, DecodedBlock &block);
 
-        // 0xB0 - 0xBF
-        {"BCS", &is::BCS, &am::REL, 2},
-        {"LDA", &is::LDA, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"LDY", &is::LDY, &am::ZPX, 4},
-        {"LDA", &is::LDA, &am::ZPX, 4},
-        {"LDX", &is::LDX, &am::ZPY, 4},
-        {"???", &is::XXX, &am::IMP, 4},
-        {"CLV", &is::CLV, &am::IMP, 2},
-        {"LDA", &is::LDA, &am::ABY, 4},
-        {"TSX", &is::TSX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 4},
-        {"LDY", &is::LDY, &am::ABX, 4},
-        {"LDA", &is::LDA, &am::ABX, 4},
-        {"LDX", &is::LDX, &am::ABY, 4},
-        {"???", &is::XXX, &am::IMP, 4},
+private: /* Idle loops */
+    bool idleLoopSkipping;
+    uint64_t idleCycleCount;
 
-        // 0xC0 - 0xCF
-        {"CPY", &is::CPY, &am::IMM, 2},
-        {"CMP", &is::CMP, &am::IZX, 6},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"CPY", &is::CPY, &am::ZP0, 3},
-        {"CMP", &is::CMP, &am::ZP0, 3},
-        {"DEC", &is::DEC, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"INY", &is::INY, &am::IMP, 2},
-        {"CMP", &is::CMP, &am::IMM, 2},
-        {"DEX", &is::DEX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"CPY", &is::CPY, &am::ABS, 4},
-        {"CMP", &is::CMP, &am::ABS, 4},
-        {"DEC", &is::DEC, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
+    // Registers at the last pass of the run through the start of an idle loop, clockCount
+    // UINT64_MAX if none
+    Registers idleLoopPass;
 
-        // 0xD0 - 0xDF
-        {"BNE", &is::BNE, &am::REL, 2},
-        {"CMP", &is::CMP, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"CMP", &is::CMP, &am::ZPX, 4},
-        {"DEC", &is::DEC, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"CLD", &is::CLD, &am::IMP, 2},
-        {"CMP", &is::CMP, &am::ABY, 4},
-        {"NOP", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"CMP", &is::CMP, &am::ABX, 4},
-        {"DEC", &is::DEC, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7},
+    // Called once an idle loop branched back to its start, after an iteration started at the
+    // given cycle. If the registers are the same as when that iteration started, and all of its
+    // reads are from host memory (which only the CPU writes), every following iteration is
+    // the same until an event: as many as fit before the end of the run are skipped, the state
+    // being exactly the one they would have led to. A loop polling an I/O register for its
+    // bit 7 (e.g. PPUSTATUS for the vertical blank, see BasicBus::GetRepeatableReadEnd) is
+    // skipped up to the cycle its reads repeat until, the last iteration before it being run
+    // so that the registers hold what they return there.
+    void SkipIdleLoop(const DecodedBlock &block, uint64_t iterationStart);
 
-        // 0xE0 - 0xEF
-        {"CPX", &is::CPX, &am::IMM, 2},
-        {"SBC", &is::SBC, &am::IZX, 6},
-        {"???", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"CPX", &is::CPX, &am::ZP0, 3},
-        {"SBC", &is::SBC, &am::ZP0, 3},
-        {"INC", &is::INC, &am::ZP0, 5},
-        {"???", &is::XXX, &am::IMP, 5},
-        {"INX", &is::INX, &am::IMP, 2},
-        {"SBC", &is::SBC, &am::IMM, 2},
-        {"NOP", &is::NOP, &am::IMP, 2},
-        {"???", &is::SBC, &am::IMP, 2},
-        {"CPX", &is::CPX, &am::ABS, 4},
-        {"SBC", &is::SBC, &am::ABS, 4},
-        {"INC", &is::INC, &am::ABS, 6},
-        {"???", &is::XXX, &am::IMP, 6},
+private: /* Internal emulation helpers */
+    // Data fetching according to address mode, populates the fetched data variable
+    template <AddrMode mode> uint8_t FetchData();
 
-        // 0xF0 - 0xFF
-        {"BEQ", &is::BEQ, &am::REL, 2},
-        {"SBC", &is::SBC, &am::IZY, 5},
-        {"???", &is::XXX, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 8},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"SBC", &is::SBC, &am::ZPX, 4},
-        {"INC", &is::INC, &am::ZPX, 6},
-        {"???", &is::XXX, &am::IMP, 6},
-        {"SED", &is::SED, &am::IMP, 2},
-        {"SBC", &is::SBC, &am::ABY, 4},
-        {"NOP", &is::NOP, &am::IMP, 2},
-        {"???", &is::XXX, &am::IMP, 7},
-        {"???", &is::NOP, &am::IMP, 4},
-        {"SBC", &is::SBC, &am::ABX, 4},
-        {"INC", &is::INC, &am::ABX, 7},
-        {"???", &is::XXX, &am::IMP, 7}
+    // Operand bytes fetching, then fused handler
+    template <uint8_t op> void Execute();
 
-    };
+    // Fused handler, from an instruction decoded beforehand
+    template <uint8_t op> void ExecuteDecoded(uint16_t decodedOperand);
 
-public: /* CPU signals */
-    // Clock signal (synchronous)
-    void Clock();
+    // Fused address mode and instruction handler, instantiated once per opcode
+    template <uint8_t op> void Run();
 
-    // Reset signal (asynchronous)
-    void Reset();
+    // Decodes and executes the instruction of the given opcode
+    void Dispatch(uint8_t op);
 
-    // Interrupt request signal (asynchronous)
-    void IRQ();
+    // Executes an instruction decoded beforehand
+    void DispatchDecoded(const DecodedInstruction &instruction);
 
-    // Non-maskable interrupt request signal (asynchronous)
-    void NMI();
+    // Executes decoded blocks from the given one on, each of them up to its end, the end of the
+    // run, or a write to its own code, then chaining into the block at the PC while there is
+    // one. With threaded dispatch, each handler jumps straight to the next instruction's, its
+    // indirect branch being predicted from the opcode it follows.
+    void RunBlocks(const DecodedBlock *block);
 
-private: /* Internal emulation helpers */
-    // Data fetching according to address mode, populates the fetched data variable
-    uint8_t FetchData();
+    // Taken branch to addr_rel, with its additional clock cycles
+    void TakeBranch();
 
     uint8_t fetchedData; // Working input value to the ALU
+    uint16_t operand;    // Current instruction's operand bytes
     uint16_t addr_abs;   // Current absolute memory address
     uint16_t addr_rel;   // Jump-relative memory address
     uint8_t opcode;      // Current instruction's opcode
     uint8_t cycles;      // Current instruction's duration in clock cycles
+    uint8_t busCycles;   // Bus cycles elapsed in the current instruction (cycle-accurate only)
+    uint64_t clockCount; // Running clock cycle counter (timestamp)
+    uint64_t runTarget;  // Timestamp the run in progress ends at (see RunUntil, StopRunAt)
 };
 
 #endif // !NES6502_H
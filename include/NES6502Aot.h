@@ -0,0 +1,204 @@
+#pragma once
+
+#ifndef NES6502AOT_H
+#define NES6502AOT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Bus.h"
+
+// Program translated ahead of time into C++ by the static recompiler (tools/recompile.cpp).
+// Routines are discovered from the vectors and the subroutine calls of a cartridge's program,
+// each of them becoming a function working on a copy of the registers through the Bus.
+
+// Translated routine, running from the program counter held in the registers until it leaves
+// the routine or reaches the target cycle. Returns true if it stopped at an instruction left to
+// the interpreter (I/O accesses, instructions it doesn't translate), pc pointing to it.
+using AotRoutine = bool (*)(Bus &bus, NES6502Base::Registers &registers, uint64_t targetCycle);
+
+// Routine translating the instruction at the given address
+struct AotEntry {
+    uint16_t pc;
+    AotRoutine routine;
+};
+
+struct AotProgram {
+    uint64_t programHash; // Hash of the program space translated (see HashProgramSpace)
+    const AotEntry *entries;
+    uint32_t entryCount;
+};
+
+// FNV-1a hash of the program space ($8000 - $FFFF) as seen by the CPU
+inline uint64_t HashProgramSpace(const uint8_t *programSpace, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ programSpace[i]) * 0x100000001B3;
+
+    return hash;
+}
+
+// Execution engine running a translated program instead of the CPU's own RunCycles/RunUntil
+// (e.g. by the bus's event loop, see BasicBus::RunUntil), the instructions without a
+// translation being run by the interpreter. The translation is only used while the program
+// space holds the translated program: writes to it are watched, and everything goes through the
+// interpreter as long as it doesn't match anymore.
+class NES6502Aot {
+public:
+    NES6502Aot(Bus *_bus, const AotProgram &_program);
+
+    // Whether the bus currently maps the program the translation was made from
+    bool MatchesProgramSpace() const;
+
+public: /* Batch execution (see NES6502) */
+    uint64_t RunCycles(uint64_t budget);
+    uint64_t RunUntil(uint64_t targetCycle);
+
+public: /* Differential mode */
+    // Runs a reference bus along with the translation, through the interpreter only, and
+    // compares both machines after every routine run. Both buses must hold the same state
+    // beforehand, the translation being run through its bus as well (see BasicBus::RunUntil).
+    void EnableDifferential(Bus *_referenceBus);
+
+    // Whether both machines diverged, execution stopping at the first divergence
+    bool HasDiverged() const { return diverged; }
+
+    // Address the routine run after which the divergence was found started from
+    uint16_t GetDivergencePc() const { return divergencePc; }
+
+public: /* Statistics */
+    uint64_t GetRoutineRunCount() const { return routineRunCount; }
+    uint64_t GetInterpretedInstructionCount() const { return interpretedInstructionCount; }
+
+private:
+    static constexpr uint16_t PROGRAM_SPACE_START = 0x8000;
+    static constexpr size_t PROGRAM_SPACE_SIZE = 0x8000;
+
+    Bus *bus;
+    NES6502<Bus> &cpu;
+    const AotProgram &program;
+
+    // Routine translating each address of the program space, nullptr if none
+    AotRoutine routines[PROGRAM_SPACE_SIZE];
+
+    bool translationUsable;  // Whether the program space matches the translation
+    uint32_t codeGeneration; // CPU's code generation when the program space was last checked
+
+    Bus *referenceBus;
+    bool diverged;
+    uint16_t divergencePc;
+
+    uint64_t routineRunCount;
+    uint64_t interpretedInstructionCount;
+
+    // Watches the writes to the program space (see Bus::WatchCodePage), then checks whether
+    // it still matches the translation
+    void CheckProgramSpace();
+
+    // Runs the reference machine up to the same timestamp, through its bus as well, and
+    // compares both
+    void CheckReference(uint16_t routinePc);
+};
+
+// Instruction semantics shared by the translated routines, matching the interpreter's
+// (including its lazy evaluation of N, Z, C and V, see NES6502Base::Registers)
+namespace aot {
+
+using Registers = NES6502Base::Registers;
+
+// Status flags left in the I, D, B and U bits
+constexpr uint8_t FLAG_I = 1 << 2;
+constexpr uint8_t FLAG_D = 1 << 3;
+
+// Whether accesses to the given address have no side effects, the others (I/O registers) being
+// left to the interpreter so that they happen at the right cycle
+inline bool IsReadable(Bus &bus, uint16_t addr) { return bus.GetReadPages()[addr >> 8]; }
+inline bool IsWritable(Bus &bus, uint16_t addr) { return bus.GetWritePages()[addr >> 8]; }
+
+// Addressing
+
+inline bool CrossesPage(uint16_t base, uint16_t addr) { return (base ^ addr) & 0xFF00; }
+
+// Pointer held in the zero page, wrapping around it
+inline uint16_t ZeroPagePointer(Bus &bus, uint8_t addr) {
+    uint16_t lo = bus.ReadRam(addr);
+    uint16_t hi = bus.ReadRam(uint8_t(addr + 1));
+    return (hi << 8) | lo;
+}
+
+// Stack, always in RAM
+
+inline void Push(Bus &bus, Registers &r, uint8_t data) {
+    bus.WriteRam(0x0100 + r.stkp, data);
+    r.stkp--;
+}
+
+inline uint8_t Pull(Bus &bus, Registers &r) {
+    r.stkp++;
+    return bus.ReadRam(0x0100 + r.stkp);
+}
+
+// Flags
+
+inline bool N(const Registers &r) { return r.lazyNZ & 0x180; }
+inline bool Z(const Registers &r) { return (r.lazyNZ & 0xFF) == 0; }
+inline bool C(const Registers &r) { return r.lazyC; }
+inline bool V(const Registers &r) {
+    return (r.lazyV1 ^ r.lazyVResult) & (r.lazyV2 ^ r.lazyVResult) & 0x80;
+}
+
+// Operations
+
+inline void ADC(Registers &r, uint8_t data) {
+    uint16_t temp = uint16_t(r.a) + data + r.lazyC;
+    r.lazyC = temp > 0xFF;
+    r.lazyV1 = r.a;
+    r.lazyV2 = data;
+    r.lazyVResult = uint8_t(temp);
+    r.a = uint8_t(temp);
+    r.lazyNZ = r.a;
+}
+
+inline void SBC(Registers &r, uint8_t data) { ADC(r, data ^ 0xFF); }
+
+inline void Compare(Registers &r, uint8_t reg, uint8_t data) {
+    r.lazyC = reg >= data;
+    r.lazyNZ = uint8_t(reg - data);
+}
+
+inline void BIT(Registers &r, uint8_t data) {
+    // Z from A & M, N and V from M
+    r.lazyNZ = (r.a & data) | ((data & 0x80) << 1);
+    r.lazyV1 = r.lazyV2 = data << 1;
+    r.lazyVResult = 0;
+}
+
+inline uint8_t ASL(Registers &r, uint8_t data) {
+    r.lazyC = data >> 7;
+    r.lazyNZ = uint8_t(data << 1);
+    return uint8_t(r.lazyNZ);
+}
+
+inline uint8_t LSR(Registers &r, uint8_t data) {
+    r.lazyC = data & 0x01;
+    r.lazyNZ = data >> 1;
+    return uint8_t(r.lazyNZ);
+}
+
+inline uint8_t ROL(Registers &r, uint8_t data) {
+    uint8_t result = uint8_t(data << 1) | r.lazyC;
+    r.lazyC = data >> 7;
+    r.lazyNZ = result;
+    return result;
+}
+
+inline uint8_t ROR(Registers &r, uint8_t data) {
+    uint8_t result = (data >> 1) | (r.lazyC << 7);
+    r.lazyC = data & 0x01;
+    r.lazyNZ = result;
+    return result;
+}
+
+} // namespace aot
+
+#endif // !NES6502AOT_H
@@ -0,0 +1,144 @@
+#pragma once
+
+#ifndef NES6502JIT_H
+#define NES6502JIT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "NES6502.h"
+
+// Native code generation is only available on x86-64 Linux, the JIT running everything through
+// the interpreter elsewhere
+#if defined(__x86_64__) && defined(__linux__)
+#define NES6502JIT_NATIVE 1
+#else
+#define NES6502JIT_NATIVE 0
+#endif
+
+// Executable memory the compiled blocks are emitted into, mmap'd once and reused from the
+// start whenever full
+class JitArena {
+public:
+    JitArena(size_t _size);
+    ~JitArena();
+
+    JitArena(const JitArena &) = delete;
+    JitArena &operator=(const JitArena &) = delete;
+
+    // Whether executable memory could be mapped at all
+    bool IsAvailable() const { return memory != nullptr; }
+
+    uint8_t *GetTop() { return memory + used; }
+    size_t GetFreeSize() const { return size - used; }
+
+    // Commits the given amount of bytes emitted at the top
+    void Commit(size_t bytes) { used += bytes; }
+
+    // Drops every emitted block
+    void Clear() { used = 0; }
+
+private:
+    uint8_t *memory;
+    size_t size;
+    size_t used;
+};
+
+// Optional dynamic recompiler, used instead of the CPU's own RunCycles/RunUntil, e.g. by the
+// bus's event loop (see BasicBus::RunUntil).
+// Hot basic blocks of the CPU's decoded block cache are translated into x86-64 code, which works
+// on a copy of the registers (see Context) and accounts for cycles at block exits. Accesses to
+// pages without plain host memory (I/O, watched code) leave the native code, the instruction
+// being run by the interpreter instead. The bus must expose its page tables (GetReadPages,
+// GetWritePages).
+template <typename BusType> class NES6502Jit {
+public:
+    NES6502Jit(BusType *_bus);
+
+public: /* Batch execution (see NES6502) */
+    uint64_t RunCycles(uint64_t budget);
+    uint64_t RunUntil(uint64_t targetCycle);
+
+public: /* Differential mode */
+    // Runs a reference bus along with the JIT, through the interpreter only, and compares both
+    // machines after every block. Both buses must hold the same state beforehand, the JIT being
+    // run through its bus as well (see BasicBus::RunUntil).
+    void EnableDifferential(BusType *_referenceBus);
+
+    // Whether both machines diverged, execution stopping at the first divergence
+    bool HasDiverged() const { return diverged; }
+
+    // Start of the block after which the divergence was found
+    uint16_t GetDivergencePc() const { return divergencePc; }
+
+public: /* Statistics */
+    uint64_t GetCompiledBlockCount() const { return compiledBlockCount; }
+    uint64_t GetNativeBlockCount() const { return nativeBlockCount; }
+    uint64_t GetInterpretedInstructionCount() const { return interpretedInstructionCount; }
+
+public: /* Native code interface */
+    // CPU state worked on by the native code, copied from and to the CPU around native runs
+    struct Context {
+        NES6502Base::Registers registers;
+
+        // Bus page tables, nullptr entries leaving the native code
+        const uint8_t *const *readPages;
+        uint8_t *const *writePages;
+
+        // Pages written, marked as by the bus (see Bus::GetDirtyPages)
+        uint8_t *dirtyPages;
+    };
+
+    // Compiled block, returns 0 once done or 1 + the index of the instruction it stopped at,
+    // which is left for the interpreter to run
+    using BlockCode = uint32_t (*)(Context *context);
+
+private:
+    using Cpu = NES6502<BusType>;
+    using DecodedBlock = typename Cpu::DecodedBlock;
+
+    static constexpr unsigned int HOT_THRESHOLD = 4; // Interpreted runs before compilation
+    static constexpr unsigned int MAX_INSTRUCTION_CYCLES = 7; // Of those compiled
+    static constexpr size_t ARENA_SIZE = 4 * 1024 * 1024;
+    static constexpr size_t MAX_BLOCK_CODE_SIZE = 8 * 1024;
+
+    // Compiled counterpart of each slot of the CPU's decoded block cache
+    struct CompiledBlock {
+        uint16_t startPc;
+        uint16_t hits;
+        uint32_t firstPageGeneration, lastPageGeneration; // Those of the decoded block
+        uint32_t arenaEpoch;
+        BlockCode code; // nullptr if not compiled (yet, or at all)
+    };
+
+    BusType *bus;
+    Cpu &cpu;
+    Context context;
+
+    JitArena arena;
+    uint32_t arenaEpoch; // Bumped whenever the arena is cleared
+    CompiledBlock compiledBlocks[Cpu::BLOCK_CACHE_SIZE];
+
+    BusType *referenceBus;
+    bool diverged;
+    uint16_t divergencePc;
+
+    uint64_t compiledBlockCount;
+    uint64_t nativeBlockCount;
+    uint64_t interpretedInstructionCount;
+
+    // Compiled code of the given decoded block, compiling it once hot
+    BlockCode FindCode(const DecodedBlock &block);
+
+    // Translation of the given decoded block, nullptr if its first instruction isn't supported
+    BlockCode Compile(const DecodedBlock &block);
+
+    // Runs the given instructions of a decoded block through the interpreter
+    void Interpret(const DecodedBlock &block, unsigned int first, unsigned int count);
+
+    // Runs the reference machine up to the same timestamp, through its bus as well, and
+    // compares both
+    void CheckReference(uint16_t blockPc);
+};
+
+#endif // !NES6502JIT_H
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef PPUPIPELINE_H
+#define PPUPIPELINE_H
+
+#include <cstdint>
+
+// SIMD kernels on SSE2 (part of the x86-64 baseline), the palette lookup through byte shuffles
+// if SSSE3 is enabled too (e.g. -march=native), scalar kernels elsewhere
+#if defined(__SSE2__)
+#define PPUPIPELINE_SSE2 1
+#else
+#define PPUPIPELINE_SSE2 0
+#endif
+
+// Pixel pipeline of the PPU's renderer (see NES2C02::RenderSpan), working on whole spans
+// rather than pixel by pixel: decoding of rows of tiles from their bitplanes, search of the
+// sprites on each scanline, then composition of the background and sprite pixels into palette
+// colors.
+// Pixels are decoded with their palette in bits 2-3 and their color in bits 0-1 (0 if
+// transparent), sprite pixels also carrying SPRITE_BEHIND and SPRITE_ZERO.
+struct PpuPipeline {
+    static constexpr uint8_t SPRITE_BEHIND = 0x20; // Behind opaque background pixels
+    static constexpr uint8_t SPRITE_ZERO = 0x40;   // From sprite 0, for sprite 0 hits
+
+    // Rows decoded at once by the SIMD kernel: DecodeTileRows reads and writes whole batches
+    static constexpr unsigned int TILE_BATCH = 8;
+
+    // Decodes the given rows of tiles, from their low and high bitplanes (leftmost pixel in the
+    // most significant bit) and palettes (0 - 3), into 8 pixels each
+    static void DecodeTileRows(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                               const uint8_t *palettes, unsigned int count, uint8_t *pixels);
+
+    // Finds the sprites (64, of the given height) covering each of the given lines (up to 256),
+    // from their Y coordinates: bit i of masks[line] set if 0 <= line - y[i] < height
+    static void FindSprites(const uint8_t *y, unsigned int height, unsigned int lineCount,
+                            uint64_t *masks);
+
+    // Composes the given background and sprite pixels into colors of the palette RAM (32
+    // entries), returns whether an opaque pixel of sprite 0 overlapped an opaque background one
+    static bool Compose(const uint8_t *background, const uint8_t *sprites, unsigned int count,
+                        const uint8_t *palette, uint8_t colorMask, uint8_t *colors);
+
+public: /* Kernels, exposed to be compared with each other (see the ppu-check benchmark) */
+    static void DecodeTileRowsScalar(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                                     const uint8_t *palettes, unsigned int count,
+                                     uint8_t *pixels);
+    static void FindSpritesScalar(const uint8_t *y, unsigned int height, unsigned int lineCount,
+                                  uint64_t *masks);
+    static bool ComposeScalar(const uint8_t *background, const uint8_t *sprites,
+                              unsigned int count, const uint8_t *palette, uint8_t colorMask,
+                              uint8_t *colors);
+
+#if PPUPIPELINE_SSE2
+    static void DecodeTileRowsSse2(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                                   const uint8_t *palettes, unsigned int count,
+                                   uint8_t *pixels);
+    static void FindSpritesSse2(const uint8_t *y, unsigned int height, unsigned int lineCount,
+                                uint64_t *masks);
+    static bool ComposeSse2(const uint8_t *background, const uint8_t *sprites,
+                            unsigned int count, const uint8_t *palette, uint8_t colorMask,
+                            uint8_t *colors);
+#endif
+};
+
+inline void PpuPipeline::DecodeTileRows(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                                        const uint8_t *palettes, unsigned int count,
+                                        uint8_t *pixels) {
+#if PPUPIPELINE_SSE2
+    DecodeTileRowsSse2(lowPlanes, highPlanes, palettes, count, pixels);
+#else
+    DecodeTileRowsScalar(lowPlanes, highPlanes, palettes, count, pixels);
+#endif
+}
+
+inline void PpuPipeline::FindSprites(const uint8_t *y, unsigned int height,
+                                     unsigned int lineCount, uint64_t *masks) {
+#if PPUPIPELINE_SSE2
+    FindSpritesSse2(y, height, lineCount, masks);
+#else
+    FindSpritesScalar(y, height, lineCount, masks);
+#endif
+}
+
+inline bool PpuPipeline::Compose(const uint8_t *background, const uint8_t *sprites,
+                                 unsigned int count, const uint8_t *palette, uint8_t colorMask,
+                                 uint8_t *colors) {
+#if PPUPIPELINE_SSE2
+    return ComposeSse2(background, sprites, count, palette, colorMask, colors);
+#else
+    return ComposeScalar(background, sprites, count, palette, colorMask, colors);
+#endif
+}
+
+#endif // !PPUPIPELINE_H
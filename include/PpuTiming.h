@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef PPUTIMING_H
+#define PPUTIMING_H
+
+#include <cstdint>
+
+// NTSC PPU timing, as a function of the CPU clock cycle count: 3 PPU dots per CPU cycle, the PPU
+// starting at dot 0 of scanline 0 at power-up (the dot skipped on odd frames is not modeled).
+// Lets devices clocked by the PPU (e.g. the MMC3 scanline counter) schedule their events instead
+// of being clocked along with it.
+struct PpuTiming {
+    static constexpr uint64_t DOTS_PER_CPU_CYCLE = 3;
+    static constexpr uint64_t DOTS_PER_SCANLINE = 341;
+    static constexpr uint64_t SCANLINES_PER_FRAME = 262;
+    static constexpr uint64_t DOTS_PER_FRAME = DOTS_PER_SCANLINE * SCANLINES_PER_FRAME;
+
+    static constexpr uint64_t VISIBLE_SCANLINES = 240;
+    static constexpr uint64_t VBLANK_SCANLINE = 241; // Vertical blank starting at its dot 1
+    static constexpr uint64_t PRE_RENDER_SCANLINE = 261;
+
+    // PPU address line A12 rises once per rendered scanline (visible ones and the pre-render
+    // one) while rendering is enabled, clocking scanline counters. At dot 260 with background
+    // patterns at $0000 and sprite patterns at $1000 (the usual setup), when fetching sprites,
+    // at dot 324 the other way around, when fetching the next background tiles. Not at all if
+    // both are fetched from the same pattern table. 8x16 sprites are assumed to be at $1000,
+    // as the fetches for the unused sprite slots are.
+    static constexpr uint64_t A12_RISE_DOT = 260;
+    static constexpr uint64_t A12_RISE_DOT_BACKGROUND = 324;
+    static constexpr uint64_t NO_A12_RISE = 0;
+    static constexpr uint64_t A12_RISES_PER_FRAME = VISIBLE_SCANLINES + 1;
+
+    // Dot A12 rises at on rendered scanlines with the given PPUCTRL and PPUMASK values,
+    // NO_A12_RISE if it doesn't
+    static uint64_t FindA12RiseDot(uint8_t ctrl, uint8_t mask) {
+        bool renderingEnabled = mask & 0x18;
+        bool backgroundHigh = ctrl & 0x10, spritesHigh = ctrl & 0x28; // Or 8x16 sprites
+        if (!renderingEnabled || backgroundHigh == spritesHigh)
+            return NO_A12_RISE;
+
+        return spritesHigh ? A12_RISE_DOT : A12_RISE_DOT_BACKGROUND;
+    }
+
+    // Number of A12 rises happening before the given dot, A12 rising at the given dot of
+    // rendered scanlines
+    static uint64_t CountA12RisesBefore(uint64_t dot, uint64_t riseDot) {
+        if (riseDot == NO_A12_RISE)
+            return 0;
+
+        uint64_t frames = dot / DOTS_PER_FRAME, frameDot = dot % DOTS_PER_FRAME;
+        uint64_t scanline = frameDot / DOTS_PER_SCANLINE;
+        uint64_t scanlineDot = frameDot % DOTS_PER_SCANLINE;
+
+        uint64_t rises = frames * A12_RISES_PER_FRAME;
+        if (scanline < VISIBLE_SCANLINES)
+            rises += scanline + (scanlineDot > riseDot);
+        else
+            rises += VISIBLE_SCANLINES +
+                     (scanline == PRE_RENDER_SCANLINE && scanlineDot > riseDot);
+
+        return rises;
+    }
+
+    // Number of A12 rises during the CPU cycles after fromCycle, up to toCycle included
+    static uint64_t CountA12Rises(uint64_t fromCycle, uint64_t toCycle, uint64_t riseDot) {
+        return CountA12RisesBefore((toCycle + 1) * DOTS_PER_CPU_CYCLE, riseDot) -
+               CountA12RisesBefore((fromCycle + 1) * DOTS_PER_CPU_CYCLE, riseDot);
+    }
+
+    // CPU cycle of the given A12 rise after afterCycle (1 for the next one), A12 rising at
+    // the given dot of rendered scanlines (not NO_A12_RISE)
+    static uint64_t FindA12Rise(uint64_t afterCycle, uint64_t rise, uint64_t riseDot) {
+        uint64_t index =
+            CountA12RisesBefore((afterCycle + 1) * DOTS_PER_CPU_CYCLE, riseDot) + rise - 1;
+
+        uint64_t frames = index / A12_RISES_PER_FRAME, frameRise = index % A12_RISES_PER_FRAME;
+        uint64_t scanline = frameRise < VISIBLE_SCANLINES ? frameRise : PRE_RENDER_SCANLINE;
+
+        uint64_t dot = frames * DOTS_PER_FRAME + scanline * DOTS_PER_SCANLINE + riseDot;
+        return dot / DOTS_PER_CPU_CYCLE;
+    }
+
+    // CPU cycle of the first vertical blank start after afterCycle
+    static uint64_t FindVblankStart(uint64_t afterCycle) {
+        const uint64_t VBLANK_DOT = VBLANK_SCANLINE * DOTS_PER_SCANLINE + 1;
+
+        uint64_t dot = (afterCycle + 1) * DOTS_PER_CPU_CYCLE;
+        uint64_t vblankDot = dot / DOTS_PER_FRAME * DOTS_PER_FRAME + VBLANK_DOT;
+        if (vblankDot < dot)
+            vblankDot += DOTS_PER_FRAME;
+
+        return vblankDot / DOTS_PER_CPU_CYCLE;
+    }
+};
+
+#endif // !PPUTIMING_H
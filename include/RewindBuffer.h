@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Bus.h"
+
+// Delta encoding on SSE2 (part of the x86-64 baseline), scalar elsewhere
+#if defined(__SSE2__)
+#define REWINDBUFFER_SSE2 1
+#else
+#define REWINDBUFFER_SSE2 0
+#endif
+
+// History of machine states, one per frame, to step back through (rewind). Only the last state
+// is kept whole: each previous one is the XOR delta leading back to it, most of a state being
+// the same from one frame to the next. Deltas are run-length encoded by 16-byte blocks into a
+// ring of fixed size, allocated once, the oldest ones being dropped when out of room.
+class RewindBuffer {
+public:
+    // Up to the given number of states (the last one included), their deltas taking up to the
+    // given amount of memory (at least MaxDeltaSize(sizeof(MachineState)))
+    RewindBuffer(unsigned int _frameCapacity, size_t byteCapacity);
+
+    // Appends the given state, e.g. saved by Bus::Snapshot at the end of each frame
+    void Push(const MachineState &state);
+
+    // Drops the last state, going back to the one before it, false if there is none
+    bool StepBack();
+
+    // Last state, to be restored (see Bus::Restore), valid if GetFrameCount() isn't 0
+    const MachineState &GetState() const { return *state; }
+
+    // States held, the last one included, and memory taken by their deltas
+    unsigned int GetFrameCount() const { return stateHeld ? deltaCount + 1 : 0; }
+    size_t GetDeltaBytes() const { return deltaBytes; }
+
+    void Clear();
+
+public: /* Delta encoding */
+    // Blocks of 16 bytes are either the same in both states (zero blocks of the XOR delta) or
+    // not (literal blocks). A delta is a sequence of runs, each being its number of zero blocks
+    // and of literal blocks (16 bits each) followed by the latter, then the size % 16 last
+    // bytes as is.
+    static constexpr size_t BLOCK_SIZE = 16;
+
+    // Upper bound of the size of the delta of states of the given size (each block a run)
+    static constexpr size_t MaxDeltaSize(size_t size) {
+        return size / BLOCK_SIZE * (4 + BLOCK_SIZE) + 4 + BLOCK_SIZE;
+    }
+
+    // Encodes the delta from previous to current into delta, previous being updated to
+    // current along the way, returns the size of the delta
+    static size_t EncodeDelta(uint8_t *previous, const uint8_t *current, size_t size,
+                              uint8_t *delta);
+
+    // Applies the given delta to the given state, either way
+    static void ApplyDelta(uint8_t *state, size_t size, const uint8_t *delta);
+
+public: /* Kernels, exposed to be compared with each other (see the rewind benchmark) */
+    static size_t EncodeDeltaScalar(uint8_t *previous, const uint8_t *current, size_t size,
+                                    uint8_t *delta);
+#if REWINDBUFFER_SSE2
+    static size_t EncodeDeltaSse2(uint8_t *previous, const uint8_t *current, size_t size,
+                                  uint8_t *delta);
+#endif
+
+private:
+    struct Delta {
+        size_t offset; // In the ring
+        size_t size;
+    };
+
+    std::unique_ptr<MachineState> state; // Last state
+    bool stateHeld;
+
+    // Deltas leading back from the last state, from the oldest one on, as a circular queue
+    std::unique_ptr<Delta[]> deltas;
+    unsigned int deltaCapacity;
+    unsigned int firstDelta, deltaCount;
+    size_t deltaBytes;
+
+    // Memory of the deltas, laid out from the oldest one on as well, wrapping around
+    std::unique_ptr<uint8_t[]> ring;
+    size_t ringSize;
+    size_t ringHead; // Where the next delta goes
+
+    void DropOldestDelta();
+};
+
+inline size_t RewindBuffer::EncodeDelta(uint8_t *previous, const uint8_t *current, size_t size,
+                                        uint8_t *delta) {
+#if REWINDBUFFER_SSE2
+    return EncodeDeltaSse2(previous, current, size, delta);
+#else
+    return EncodeDeltaScalar(previous, current, size, delta);
+#endif
+}
+
+#endif // !REWINDBUFFER_H
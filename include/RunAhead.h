@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef RUNAHEAD_H
+#define RUNAHEAD_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "Bus.h"
+
+// Input latency reduction (run-ahead): games show the effect of the input they read a frame or
+// more later, so each host frame the machine runs its next frame, then the given number of
+// frames further from a snapshot it is then restored to, only the last of them being rendered
+// and presented. Frames not presented are run in render skip mode (see NES2C02::SetRenderSkip),
+// the snapshots being incremental (see Bus::SnapshotIncremental).
+template <typename BusType> class RunAhead {
+public:
+    using Duration = std::chrono::steady_clock::duration;
+
+    // Host frame at the NES's refresh rate (NTSC, 60.0988 Hz)
+    static constexpr std::chrono::nanoseconds FRAME_BUDGET{16'639'267};
+
+    // Runs the given machine, its cartridge inserted, the given number of frames ahead (none
+    // if its cartridge has more RAM than a snapshot holds)
+    RunAhead(BusType &_bus, unsigned int _frames);
+
+    void SetFrames(unsigned int _frames) { frames = _frames; }
+    unsigned int GetFrames() const { return frames; }
+
+    // Runs one host frame, the input for it being set beforehand (once controllers are
+    // emulated), returns the frame to present (see NES2C02::GetFrameBuffer)
+    const uint8_t *RunFrame();
+
+public: /* Timing */
+    // Time taken by each part of a host frame
+    struct FrameTiming {
+        Duration frame;    // Next frame
+        Duration snapshot; // Of the state after it
+        Duration ahead;    // Frames run ahead
+        Duration restore;
+
+        Duration GetTotal() const { return frame + snapshot + ahead + restore; }
+    };
+
+    // Of the last host frame, and of the longest one since the timing was reset
+    const FrameTiming &GetLastTiming() const { return lastTiming; }
+    const FrameTiming &GetWorstTiming() const { return worstTiming; }
+
+    // Host frames run since the timing was reset, their average time, and those that took
+    // longer than FRAME_BUDGET
+    uint64_t GetFrameCount() const { return frameCount; }
+    Duration GetAverageTime() const {
+        return frameCount ? totalTime / static_cast<Duration::rep>(frameCount) : Duration{};
+    }
+    uint64_t GetOverBudgetCount() const { return overBudgetCount; }
+
+    void ResetTiming();
+
+private:
+    BusType &bus;
+    unsigned int frames;
+    bool snapshots; // Whether the machine's state fits in one
+
+    std::unique_ptr<MachineState> state; // As of the next frame, restored after running ahead
+
+    FrameTiming lastTiming, worstTiming;
+    Duration totalTime;
+    uint64_t frameCount, overBudgetCount;
+
+    // Runs the machine up to the start of its next vertical blank, the frame being complete
+    void RunToVblank();
+};
+
+#endif // !RUNAHEAD_H
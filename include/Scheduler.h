@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+
+// Timed events of the machine, at most one of each kind pending at a time (scheduling one again
+// moves it), so that the scheduler never grows
+enum class EventType : uint8_t {
+    PPU,     // PPU's vertical blank start, catching it up (see NES2C02)
+    NMI,     // Non-maskable interrupt request (e.g. PPU vertical blank)
+    IRQ,     // Assertion of the interrupt request line (e.g. APU frame counter)
+    MAPPER,  // Mapper's own timer (e.g. MMC3 scanline counter, see Mapper::HandleEvent)
+    OAM_DMA, // Sprite DMA transfer, halting the CPU
+    COUNT
+};
+
+// Pending events ordered by timestamp, in CPU clock cycles since power-up (see
+// NES6502::GetCycleCount), the master clock of the machine. The CPU runs up to the next
+// timestamp instead of checking every device on every cycle, so that idle devices cost nothing.
+// Plain data, so that it can be copied along with the rest of the machine's state.
+class Scheduler {
+public:
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    Scheduler();
+
+    // Schedules the given event, replacing its pending occurrence if any
+    void Schedule(EventType type, uint64_t timestamp);
+
+    // Removes the pending occurrence of the given event, if any
+    void Cancel(EventType type);
+
+    bool IsScheduled(EventType type) const { return positions[(uint8_t)type] != NOT_SCHEDULED; }
+
+    // Timestamp of the pending occurrence of the given event, NEVER if none
+    uint64_t GetTimestamp(EventType type) const {
+        return IsScheduled(type) ? heap[positions[(uint8_t)type]].timestamp : NEVER;
+    }
+
+    // Timestamp of the earliest pending event, NEVER if none
+    uint64_t GetNextTimestamp() const { return count ? heap[0].timestamp : NEVER; }
+
+    // Removes the earliest pending event and returns its type (events sharing a timestamp come
+    // in EventType order)
+    EventType PopNext();
+
+private:
+    static constexpr uint8_t CAPACITY = (uint8_t)EventType::COUNT;
+    static constexpr uint8_t NOT_SCHEDULED = 0xFF;
+
+    struct Event {
+        uint64_t timestamp;
+        EventType type;
+    };
+
+    // Binary min-heap, along with the position of each event type in it
+    Event heap[CAPACITY];
+    uint8_t positions[CAPACITY];
+    uint8_t count;
+
+    static bool Precedes(const Event &a, const Event &b) {
+        return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.type < b.type);
+    }
+
+    // Stores the event at the given position of the heap
+    void Place(uint8_t position, const Event &event);
+
+    // Restores the heap order from the given position, upwards then downwards
+    void SiftUp(uint8_t position);
+    void SiftDown(uint8_t position);
+
+    // Removes the event at the given position
+    void Remove(uint8_t position);
+};
+
+#endif // !SCHEDULER_H
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef TRACINGBUS_H
+#define TRACINGBUS_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "NES6502.h"
+
+// Flat 64 KiB RAM bus recording every CPU access, e.g. to compare the bus activity of two runs,
+// its CPU running with the given execution policy (see NES6502)
+template <typename Policy> class BasicTracingBus {
+public:
+    struct Access {
+        uint64_t timestamp; // CPU clock cycle of the access (see NES6502::GetBusCycleCount)
+        uint16_t addr;      // Accessed address
+        uint8_t data;       // Data read or written
+        bool write;         // Whether the access is a write
+    };
+
+private:
+    NES6502<BasicTracingBus, Policy> cpu;
+    std::unique_ptr<uint8_t[]> ram; // 64 KiB RAM
+    std::vector<Access> trace;
+
+public:
+    BasicTracingBus();
+
+    uint8_t ReadRam(uint16_t addr, bool bReadOnly = false) {
+        if (!bReadOnly) // Debugging reads are not part of the CPU's activity
+            trace.push_back({cpu.GetBusCycleCount(), addr, ram[addr], false});
+
+        return ram[addr];
+    }
+
+    void WriteRam(uint16_t addr, uint8_t data) {
+        trace.push_back({cpu.GetBusCycleCount(), addr, data, true});
+
+        ram[addr] = data;
+    }
+
+    // Code caching (see NES6502's decoded block cache), disabled since instruction fetches
+    // are part of the trace
+    static constexpr bool CACHES_CODE = false;
+    const uint8_t *GetCodePage(uint8_t page) const { return nullptr; }
+    void WatchCodePage(uint8_t page) {}
+
+    // Idle loops (see NES6502::SkipIdleLoop), never skipped without decoded blocks
+    uint64_t GetRepeatableReadEnd(uint16_t addr) const { return 0; }
+
+    NES6502<BasicTracingBus, Policy> &GetCpu() { return cpu; }
+
+    const std::vector<Access> &GetTrace() const { return trace; }
+    void ClearTrace() { trace.clear(); }
+};
+
+using TracingBus = BasicTracingBus<InstructionLevel>;
+using CycleAccurateTracingBus = BasicTracingBus<CycleAccurate>;
+
+#endif // !TRACINGBUS_H
@@ -1,47 +1,655 @@
 #include "../include/Bus.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "../include/PpuTiming.h"
+
 /*
 
 Overview of the NES data bus
 
-      ┌───────────┐ ┌──────────────────────────┐
-      │┆┆┆┆┆┆┆┆┆┆┆│ │          64 KiB          │
-      │┆┆┆6502┆┆┆┆│ │                          │
-      │┆┆┆┆┆┆┆┆┆┆┆│ │           RAM            │
-      │┆┆┆CPU┆┆┆┆┆│ │                          │
-      │┆┆┆┆┆┆┆┆┆┆┆│ │                          │
-      └──│────∧───┘ └────────────∧─────────────┘
-        A│   D│                  │
-         │    │                  │
-      ┌──∨────∨──────────────────∨─────────────┐
-      │==================Bus===================│
-      └────────────────────────────────────────┘
-      │                                        │
-     0x0000                                   0xFFFF
+      ┌───────────┐ ┌──────────┐ ┌──────────┐ ┌──────────┐ ┌──────────────────┐
+      │┆┆┆┆┆┆┆┆┆┆┆│ │  2 KiB   │ │   PPU    │ │ APU, I/O │ │                  │
+      │┆┆┆6502┆┆┆┆│ │   RAM    │ │registers │ │registers │ │    Cartridge     │
+      │┆┆┆┆┆┆┆┆┆┆┆│ │          │ │          │ │          │ │      space       │
+      │┆┆┆CPU┆┆┆┆┆│ │(mirrored)│ │(mirrored)│ │          │ │                  │
+      │┆┆┆┆┆┆┆┆┆┆┆│ │          │ │          │ │          │ │                  │
+      └──│────∧───┘ └────∧─────┘ └────∧─────┘ └────∧─────┘ └────────∧─────────┘
+        A│   D│          │            │            │                │
+         │    │          │            │            │                │
+      ┌──∨────∨──────────∨────────────∨────────────∨────────────────∨─────────┐
+      │==================================Bus==================================│
+      └───────────────────────────────────────────────────────────────────────┘
+      │                  │            │            │                          │
+     0x0000            0x2000       0x4000       0x4020                     0xFFFF
+
+The bus resolves every address through a page table (256 pages of 256 bytes):
+pages backed by host memory are accessed directly, the others through I/O handlers.
+Writable pages the CPU decoded code from are temporarily handled by WriteCodePage,
+so that self-modifying code is caught without any cost on the other writes. Pages of
+memory shared with clones are handled by WriteSharedPage the same way, until copied.
+
+Timed events (interrupts, DMA) are kept by a scheduler in timestamp order: the CPU runs
+uninterrupted up to the next one, which is then dispatched, so that the devices never have
+to be polled from the CPU loop. The PPU isn't clocked either: it is caught up to the CPU
+whenever it is accessed, and once per frame by its vertical blank event.
 
 */
 
-Bus::Bus() : cpu(this) {
-    const unsigned int RAM_SIZE = 64 * 1024;
-    ram = new uint8_t[RAM_SIZE];
-    unsigned int i = 0;
-    while (i < RAM_SIZE) {
-        ram[i++] = 0;
-    }
+template <typename Policy>
+BasicBus<Policy>::BasicBus()
+    : cpu(this), ppu(chrReadPages, chrWritePages), cartridge(nullptr), chrReadPages(),
+      chrWritePages(), watchedPages(), ram(), prgRam(), cartridgeSpace(), chrRamSize(0),
+      scheduler(), oamDmaPage(0) {
+    const unsigned int RAM_SIZE = 2 * 1024;
+    const unsigned int CARTRIDGE_SPACE_SIZE = (0xFF - 0x41 + 1) * PAGE_SIZE;
+
+    // $0000 - $1FFF: internal RAM, mirrored every 2 KiB
+    CreateRegion(ram, 0x00, 0x1F, nullptr, RAM_SIZE);
+
+    // $2000 - $3FFF: PPU registers, mirrored every 8 bytes
+    MapReadHandler(0x20, 0x3F, &BasicBus::ReadPpuRegisters);
+    MapWriteHandler(0x20, 0x3F, &BasicBus::WritePpuRegisters);
+
+    // $4000 - $40FF: APU and I/O registers
+    MapReadHandler(0x40, 0x40, &BasicBus::ReadApuIoRegisters);
+    MapWriteHandler(0x40, 0x40, &BasicBus::WriteApuIoRegisters);
+
+    // $4100 - $FFFF: cartridge space, plain memory until a cartridge is inserted
+    CreateRegion(cartridgeSpace, 0x41, 0xFF, nullptr, CARTRIDGE_SPACE_SIZE);
+
+    StartEpoch();
+
+    // The PPU runs from power-up, caught up at least once per frame
+    ScheduleEvent(EventType::PPU, PpuTiming::FindVblankStart(cpu.GetCycleCount()));
+
     cpu.ZP0();
 }
 
-uint8_t Bus::ReadRam(uint16_t addr, bool bReadOnly) const {
-    // RAM address space
-    if (addr >= 0x0000 && addr <= 0xFFFF)
-        return ram[addr];
+// Memory map
+
+// Copy of a page, of which the given size is left (whole pages being the common case, of
+// constant size)
+static void CopyPage(uint8_t *destination, const uint8_t *source, size_t size) {
+    const unsigned int PAGE_SIZE = Bus::PAGE_SIZE;
+    if (size >= PAGE_SIZE)
+        std::memcpy(destination, source, PAGE_SIZE);
+    else
+        std::memcpy(destination, source, size);
+}
+
+// Offset of the page following the one at the given offset, in memory mirrored every size bytes
+// (dividing on wrap-around only, bank switches remapping whole banks at a time)
+static unsigned int NextPageOffset(unsigned int offset, unsigned int pageSize, uint32_t size) {
+    offset += pageSize;
+    return offset < size ? offset : offset % size;
+}
+
+// (remapping a page invalidates the code the CPU decoded from it)
+
+template <typename Policy>
+void BasicBus<Policy>::MapReadMemory(uint8_t firstPage, uint8_t lastPage,
+                                     const uint8_t *memory, uint32_t size) {
+    for (unsigned int page = firstPage, offset = 0; page <= lastPage;
+         page++, offset = NextPageOffset(offset, PAGE_SIZE, size)) {
+        if (readPages[page] == memory + offset) // Same bank selected again, code still valid
+            continue;
+
+        readPages[page] = memory + offset;
+        readHandlers[page] = nullptr;
+        cpu.InvalidateCodePage(page);
+    }
+}
+
+template <typename Policy>
+void BasicBus<Policy>::MapWriteMemory(uint8_t firstPage, uint8_t lastPage, uint8_t *memory,
+                                      uint32_t size) {
+    for (unsigned int page = firstPage, offset = 0; page <= lastPage;
+         page++, offset = NextPageOffset(offset, PAGE_SIZE, size)) {
+        if (watchedPages[page])
+            ReleaseCodeMemory(watchedPages[page]);
+
+        writePages[page] = memory + offset;
+        writeHandlers[page] = nullptr;
+    }
+}
+
+template <typename Policy>
+void BasicBus<Policy>::MapReadHandler(uint8_t firstPage, uint8_t lastPage, ReadHandler handler) {
+    for (unsigned int page = firstPage; page <= lastPage; page++) {
+        readPages[page] = nullptr;
+        readHandlers[page] = handler;
+        cpu.InvalidateCodePage(page);
+    }
+}
+
+template <typename Policy>
+void BasicBus<Policy>::MapWriteHandler(uint8_t firstPage, uint8_t lastPage, WriteHandler handler) {
+    for (unsigned int page = firstPage; page <= lastPage; page++) {
+        if (watchedPages[page])
+            ReleaseCodeMemory(watchedPages[page]);
+
+        writePages[page] = nullptr;
+        writeHandlers[page] = handler;
+    }
+}
+
+// Cartridge
+
+// Hashes of the games run without idle loop skipping, shared by every machine
+static std::vector<uint64_t> idleLoopSkippingExceptions;
+
+void AddIdleLoopSkippingException(uint64_t cartridgeHash) {
+    idleLoopSkippingExceptions.push_back(cartridgeHash);
+}
+
+bool IsIdleLoopSkippingException(uint64_t cartridgeHash) {
+    return std::find(idleLoopSkippingExceptions.begin(), idleLoopSkippingExceptions.end(),
+                     cartridgeHash) != idleLoopSkippingExceptions.end();
+}
+
+template <typename Policy> bool BasicBus<Policy>::InsertCartridge(Cartridge *_cartridge) {
+    std::unique_ptr<Mapper<BasicBus>> cartridgeMapper = CreateMapper(*this, *_cartridge);
+    if (!cartridgeMapper)
+        return false;
+
+    cartridge = _cartridge;
+    mapper = std::move(cartridgeMapper);
+
+    // The machine's own PRG-RAM and CHR-RAM, from the cartridge's power-up contents
+    if (cartridge->GetPrgRam())
+        CreateRegion(prgRam, 0x60, 0x7F, cartridge->GetPrgRam(), cartridge->GetPrgRamSize());
+    else
+        prgRam = {};
+    chrRamSize = cartridge->GetChrRamSize();
+    if (chrRamSize)
+        chrRam.reset(new uint8_t[chrRamSize]());
+    else
+        chrRam.reset();
+
+    MapCartridge();
+
+    cpu.SetIdleLoopSkipping(!IsIdleLoopSkippingException(cartridge->GetHash()));
+    return true;
+}
+
+template <typename Policy> void BasicBus<Policy>::MapCartridge() {
+    // $4100 - $5FFF: expansion area, unused by the supported boards
+    MapReadHandler(0x41, 0x5F, &BasicBus::ReadCartridgeSpace);
+    MapWriteHandler(0x41, 0x5F, &BasicBus::WriteCartridgeSpace);
+
+    // $6000 - $7FFF: PRG-RAM, mirrored
+    if (prgRam.pages) {
+        MapRegion(prgRam);
+    } else {
+        MapReadHandler(0x60, 0x7F, &BasicBus::ReadCartridgeSpace);
+        MapWriteHandler(0x60, 0x7F, &BasicBus::WriteCartridgeSpace);
+    }
+
+    // $8000 - $FFFF: PRG-ROM banks straight from the image, and the mapper's registers
+    MapWriteHandler(0x80, 0xFF, &BasicBus::WriteCartridgeSpace);
+
+    // Power-up banks, CHR-ROM also straight from the image
+    if (cartridge->GetChrRom())
+        ppu.SetChrMemory(cartridge->GetChrRom(), cartridge->GetChrRomSize());
+    else
+        ppu.SetChrMemory(chrRam.get(), chrRamSize);
+    mapper->Reset();
+    mapper->UpdatePpuSetup(ppu.GetControl(), ppu.GetMask());
+    ppu.SetMirroring(mapper->GetMirroring());
+
+    // Stand-in cartridge space unmapped by now
+    cartridgeSpace = {};
+}
+
+template <typename Policy>
+void BasicBus<Policy>::MapChrRom(uint8_t firstPage, uint8_t lastPage, const uint8_t *memory,
+                                 uint32_t size) {
+    for (unsigned int page = firstPage, offset = 0; page <= lastPage;
+         page++, offset = NextPageOffset(offset, CHR_PAGE_SIZE, size)) {
+        chrReadPages[page] = memory + offset;
+        chrWritePages[page] = nullptr;
+    }
+}
+
+template <typename Policy>
+void BasicBus<Policy>::MapChrRam(uint8_t firstPage, uint8_t lastPage, uint8_t *memory,
+                                 uint32_t size) {
+    for (unsigned int page = firstPage, offset = 0; page <= lastPage;
+         page++, offset = NextPageOffset(offset, CHR_PAGE_SIZE, size)) {
+        chrWritePages[page] = memory + offset;
+        chrReadPages[page] = chrWritePages[page];
+    }
+}
+
+// Code caching
+
+template <typename Policy> uint64_t BasicBus<Policy>::GetRepeatableReadEnd(uint16_t addr) const {
+    // PPUSTATUS, its vertical blank flag (bit 7) and write toggle cleared by the read just
+    // made, until the vertical blank starts (its PPU event). Its sprite flags may change
+    // meanwhile.
+    if (addr >= 0x2000 && addr < 0x4000 && (addr & 0x0007) == 0x0002)
+        return scheduler.IsScheduled(EventType::PPU) ? scheduler.GetTimestamp(EventType::PPU) : 0;
 
-    // Out-of-bounds space
     return 0;
 }
 
-void Bus::WriteRam(uint16_t addr, uint8_t data) const {
-    // RAM address space
-    if (addr >= 0x0000 && addr <= 0xFFFF)
-        ram[addr] = data;
+template <typename Policy> void BasicBus<Policy>::WatchCodePage(uint8_t page) {
+    // Every page writing to the same memory (e.g. RAM mirrors) is watched
+    const uint8_t *memory = readPages[page];
+
+    for (unsigned int mirror = 0; mirror < PAGE_COUNT; mirror++) {
+        if (writePages[mirror] && writePages[mirror] == memory) {
+            watchedPages[mirror] = writePages[mirror];
+            writePages[mirror] = nullptr;
+            writeHandlers[mirror] = &BasicBus::WriteCodePage;
+        }
+    }
+}
+
+template <typename Policy> void BasicBus<Policy>::WriteCodePage(uint16_t addr, uint8_t data) {
+    uint8_t *memory = watchedPages[addr >> 8];
+    memory[addr & 0x00FF] = data;
+
+    ReleaseCodeMemory(memory);
+}
+
+template <typename Policy> void BasicBus<Policy>::ReleaseCodeMemory(const uint8_t *memory) {
+    for (unsigned int page = 0; page < PAGE_COUNT; page++) {
+        // Back to plain writes, until the CPU decodes code from this memory again
+        if (watchedPages[page] == memory) {
+            writePages[page] = watchedPages[page];
+            writeHandlers[page] = nullptr;
+            watchedPages[page] = nullptr;
+        }
+
+        if (readPages[page] == memory)
+            cpu.InvalidateCodePage(page);
+    }
+}
+
+// Copy-on-write memory
+
+template <typename Policy>
+const uint8_t *BasicBus<Policy>::GetPageMemory(const std::shared_ptr<MemoryPage> &page) {
+    static const MemoryPage ZERO_PAGE = {};
+    return page ? page->data : ZERO_PAGE.data;
+}
+
+template <typename Policy>
+void BasicBus<Policy>::CreateRegion(MemoryRegion &region, uint8_t firstPage, uint8_t lastPage,
+                                    const uint8_t *contents, size_t size) {
+    region.pageCount = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    region.pages.reset(new std::shared_ptr<MemoryPage>[region.pageCount]);
+    region.firstPage = firstPage;
+    region.lastPage = lastPage;
+
+    for (unsigned int index = 0; contents && index < region.pageCount; index++) {
+        size_t offset = index * PAGE_SIZE;
+        region.pages[index] = std::make_shared<MemoryPage>();
+        std::memcpy(region.pages[index]->data, contents + offset,
+                    std::min<size_t>(PAGE_SIZE, size - offset));
+    }
+
+    MapRegion(region);
+}
+
+template <typename Policy>
+void BasicBus<Policy>::ShareRegion(MemoryRegion &region, const MemoryRegion &source) {
+    region.pageCount = source.pageCount;
+    region.pages.reset(source.pages ? new std::shared_ptr<MemoryPage>[region.pageCount]
+                                    : nullptr);
+    region.firstPage = source.firstPage;
+    region.lastPage = source.lastPage;
+
+    for (unsigned int index = 0; index < region.pageCount; index++)
+        region.pages[index] = source.pages[index];
+}
+
+template <typename Policy> void BasicBus<Policy>::MapRegion(MemoryRegion &region) {
+    for (unsigned int index = 0; index < region.pageCount; index++)
+        MapRegionPage(region, index);
 }
+
+template <typename Policy>
+void BasicBus<Policy>::MapRegionPage(MemoryRegion &region, unsigned int index) {
+    const std::shared_ptr<MemoryPage> &memoryPage = region.pages[index];
+    bool shared = IsShared(memoryPage);
+
+    for (unsigned int page = region.firstPage + index; page <= region.lastPage;
+         page += region.pageCount) {
+        MapReadMemory(page, page, GetPageMemory(memoryPage), PAGE_SIZE);
+        if (shared)
+            MapWriteHandler(page, page, &BasicBus::WriteSharedPage);
+        else
+            MapWriteMemory(page, page, memoryPage->data, PAGE_SIZE);
+    }
+}
+
+template <typename Policy>
+uint8_t *BasicBus<Policy>::UnsharePage(MemoryRegion &region, unsigned int index, bool copy) {
+    // The other owners may have made it their own already
+    std::shared_ptr<MemoryPage> &memoryPage = region.pages[index];
+    if (IsShared(memoryPage)) {
+        std::shared_ptr<MemoryPage> ownPage = std::make_shared<MemoryPage>(); // Zeros
+        if (copy && memoryPage)
+            std::memcpy(ownPage->data, memoryPage->data, PAGE_SIZE);
+        memoryPage = std::move(ownPage);
+    }
+
+    MapRegionPage(region, index);
+    return memoryPage->data;
+}
+
+template <typename Policy> void BasicBus<Policy>::WriteSharedPage(uint16_t addr, uint8_t data) {
+    // Internal RAM, or whichever region the cartridge space has
+    uint8_t page = addr >> 8;
+    MemoryRegion &region = page <= ram.lastPage ? ram : cartridge ? prgRam : cartridgeSpace;
+    uint8_t *memory = UnsharePage(region, (page - region.firstPage) % region.pageCount, true);
+    memory[addr & 0x00FF] = data;
+
+    // Code decoded from the page while shared wasn't watched
+    ReleaseCodeMemory(memory);
+}
+
+template <typename Policy> void BasicBus<Policy>::UnshareChrRam(bool copy) {
+    if (!chrRam || chrRam.use_count() <= 1)
+        return;
+
+    std::shared_ptr<uint8_t[]> ownChrRam(new uint8_t[chrRamSize]);
+    if (copy)
+        std::memcpy(ownChrRam.get(), chrRam.get(), chrRamSize);
+
+    // Same banks, in the copy
+    for (unsigned int page = 0; page < CHR_PAGE_COUNT; page++) {
+        uintptr_t offset = (uintptr_t)chrWritePages[page] - (uintptr_t)chrRam.get();
+        if (chrWritePages[page] && offset < chrRamSize) {
+            chrWritePages[page] = ownChrRam.get() + offset;
+            chrReadPages[page] = chrWritePages[page];
+        }
+    }
+
+    ppu.SetChrMemory(ownChrRam.get(), chrRamSize);
+    chrRam = std::move(ownChrRam);
+}
+
+template <typename Policy>
+void BasicBus<Policy>::RestoreMemory(MemoryRegion &region, const uint8_t *data, size_t size) {
+    for (unsigned int index = 0; index < region.pageCount && index * PAGE_SIZE < size; index++) {
+        size_t offset = index * PAGE_SIZE;
+        uint8_t *memory = IsShared(region.pages[index]) ? UnsharePage(region, index, false)
+                                                        : region.pages[index]->data;
+        CopyPage(memory, data + offset, size - offset);
+
+        // Code may only have been decoded from pages not written to directly: watched ones,
+        // back to plain writes, and shared ones
+        for (unsigned int page = region.firstPage + index; page <= region.lastPage;
+             page += region.pageCount) {
+            if (writePages[page])
+                continue;
+
+            if (watchedPages[page]) {
+                writePages[page] = watchedPages[page];
+                writeHandlers[page] = nullptr;
+                watchedPages[page] = nullptr;
+            }
+            cpu.InvalidateCodePage(page);
+        }
+    }
+}
+
+// Cloning
+
+template <typename Policy> std::unique_ptr<BasicBus<Policy>> BasicBus<Policy>::Clone() {
+    std::unique_ptr<BasicBus> clone = std::make_unique<BasicBus>();
+
+    // Memory shared, each machine copying the pages it writes to from now on
+    clone->ShareRegion(clone->ram, ram);
+    clone->ShareRegion(clone->prgRam, prgRam);
+    clone->ShareRegion(clone->cartridgeSpace, cartridgeSpace);
+    clone->chrRam = chrRam;
+    clone->chrRamSize = chrRamSize;
+    for (BasicBus *machine : {this, clone.get()}) {
+        machine->MapRegion(machine->ram);
+        machine->MapRegion(machine->cartridgeSpace);
+    }
+
+    NES6502Base::State cpuState;
+    cpu.SaveState(cpuState);
+    clone->cpu.LoadState(cpuState);
+
+    // Same cartridge, the banks mapped again from the mapper's registers, then the PPU on top
+    // of them (see Restore)
+    if (cartridge) {
+        MapRegion(prgRam);
+
+        clone->cartridge = cartridge;
+        clone->mapper = CreateMapper(*clone, *cartridge);
+        clone->MapCartridge();
+        clone->cpu.SetIdleLoopSkipping(!IsIdleLoopSkippingException(cartridge->GetHash()));
+
+        MapperState mapperState;
+        mapper->SaveState(mapperState);
+        clone->mapper->LoadState(mapperState);
+        clone->ppu.SetMirroring(clone->mapper->GetMirroring());
+    }
+
+    NES2C02::State ppuState;
+    ppu.SaveState(ppuState);
+    clone->ppu.LoadState(ppuState);
+
+    // Pending events last, the mapper's reset having cancelled its own
+    clone->scheduler = scheduler;
+    clone->oamDmaPage = oamDmaPage;
+
+    return clone;
+}
+
+// Snapshots
+
+template <typename Policy> bool BasicBus<Policy>::Snapshot(MachineState &state) {
+    return SaveState(state, false);
+}
+
+template <typename Policy> bool BasicBus<Policy>::SnapshotIncremental(MachineState &state) {
+    // Only if the state holds the memory as of the start of the epoch
+    return SaveState(state, TRACKS_DIRTY_PAGES && state.epoch == epoch);
+}
+
+template <typename Policy>
+bool BasicBus<Policy>::SaveState(MachineState &state, bool incremental) {
+    size_t prgRamSize = cartridge ? cartridge->GetPrgRamSize() : 0;
+    size_t chrRamSize = cartridge ? cartridge->GetChrRamSize() : 0;
+    if (prgRamSize > MachineState::MAX_PRG_RAM_SIZE || chrRamSize > MachineState::MAX_CHR_RAM_SIZE)
+        return false;
+
+    state.version = MachineState::VERSION;
+    state.size = sizeof(MachineState);
+    state.cartridgeHash = cartridge ? cartridge->GetHash() : 0;
+
+    cpu.SaveState(state.cpu);
+    ppu.SaveState(state.ppu);
+    if (mapper)
+        mapper->SaveState(state.mapper);
+    state.scheduler = scheduler;
+    state.oamDmaPage = oamDmaPage;
+
+    // CHR-RAM is written by the PPU, untracked
+    SaveMemory(state.ram, ram, MachineState::RAM_SIZE, incremental);
+    if (prgRamSize)
+        SaveMemory(state.prgRam, prgRam, prgRamSize, incremental);
+    if (chrRamSize)
+        std::memcpy(state.chrRam, chrRam.get(), chrRamSize);
+
+    StartEpoch();
+    state.epoch = epoch;
+
+    return true;
+}
+
+template <typename Policy>
+void BasicBus<Policy>::SaveMemory(uint8_t *data, const MemoryRegion &region, size_t size,
+                                  bool incremental) {
+    for (unsigned int index = 0; index < region.pageCount && index * PAGE_SIZE < size; index++) {
+        // Written through any of its mirrors
+        bool dirty = !incremental;
+        for (unsigned int page = region.firstPage + index; page <= region.lastPage && !dirty;
+             page += region.pageCount)
+            dirty = dirtyPages[page];
+
+        if (dirty) {
+            size_t offset = index * PAGE_SIZE;
+            CopyPage(data + offset, GetPageMemory(region.pages[index]), size - offset);
+        }
+    }
+}
+
+template <typename Policy> void BasicBus<Policy>::StartEpoch() {
+    static std::atomic<uint64_t> lastEpoch(0);
+
+    std::fill(dirtyPages, dirtyPages + PAGE_COUNT, 0);
+    epoch = ++lastEpoch;
+}
+
+template <typename Policy> bool BasicBus<Policy>::Restore(const MachineState &state) {
+    if (state.version != MachineState::VERSION || state.size != sizeof(MachineState) ||
+        state.cartridgeHash != (cartridge ? cartridge->GetHash() : 0))
+        return false;
+
+    cpu.LoadState(state.cpu);
+    scheduler = state.scheduler;
+    oamDmaPage = state.oamDmaPage;
+
+    // Code decoded from RAM is dropped, CHR-RAM tiles decoded again
+    RestoreMemory(ram, state.ram, MachineState::RAM_SIZE);
+    if (prgRam.pages)
+        RestoreMemory(prgRam, state.prgRam, cartridge->GetPrgRamSize());
+    if (chrRam) {
+        UnshareChrRam(false);
+        std::memcpy(chrRam.get(), state.chrRam, chrRamSize);
+        ppu.InvalidateTileCache();
+    }
+
+    // Banks mapped again, then the PPU on top of them
+    if (mapper) {
+        mapper->LoadState(state.mapper);
+        ppu.SetMirroring(mapper->GetMirroring());
+    }
+    ppu.LoadState(state.ppu);
+
+    // Memory as held by the state from now on
+    std::fill(dirtyPages, dirtyPages + PAGE_COUNT, 0);
+    epoch = state.epoch;
+
+    return true;
+}
+
+// Timed events
+
+template <typename Policy> void BasicBus<Policy>::DispatchEvent(EventType type) {
+    switch (type) {
+    case EventType::PPU:
+        // Frame complete, then vertical blank NMI if enabled
+        ppu.CatchUp(cpu.GetCycleCount());
+        if (ppu.IsNmiAsserted())
+            ScheduleEvent(EventType::NMI, cpu.GetCycleCount());
+
+        ScheduleEvent(EventType::PPU, PpuTiming::FindVblankStart(cpu.GetCycleCount()));
+        break;
+    case EventType::NMI:
+        cpu.NMI();
+        break;
+    case EventType::IRQ:
+        AssertIrq(); // Until acknowledged
+        break;
+    case EventType::MAPPER:
+        if (mapper)
+            mapper->HandleEvent();
+        break;
+    case EventType::OAM_DMA:
+        RunOamDma();
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename Policy> void BasicBus<Policy>::RunOamDma() {
+    // Written through OAMDATA, i.e. from OAMADDR on
+    ppu.CatchUp(cpu.GetCycleCount());
+    if (readPages[oamDmaPage]) {
+        // One copy straight from host memory (RAM, usually)
+        ppu.WriteOam(readPages[oamDmaPage]);
+    } else {
+        // Byte by byte through the I/O handlers, written through OAMDATA as by the console
+        // (a transfer from the PPU's registers reading OAM back as it is being written)
+        for (unsigned int i = 0; i < PAGE_SIZE; i++)
+            ppu.WriteRegister(0x2004, ReadRam((oamDmaPage << 8) | i), cpu.GetCycleCount());
+    }
+
+    // 256 reads and writes, after one cycle (two on odd cycles) aligning the transfer
+    cpu.Stall(513 + (cpu.GetCycleCount() & 1));
+}
+
+// I/O handlers
+
+template <typename Policy> uint8_t BasicBus<Policy>::ReadPpuRegisters(uint16_t addr) {
+    return ppu.ReadRegister(addr, cpu.GetBusCycleCount());
+}
+
+template <typename Policy> void BasicBus<Policy>::WritePpuRegisters(uint16_t addr, uint8_t data) {
+    // CHR-RAM shared with other machines, copied before a write to the pattern tables
+    if ((addr & 0x0007) == 0x0007 && chrRam && chrRam.use_count() > 1) {
+        ppu.CatchUp(cpu.GetBusCycleCount());
+        if (ppu.GetVramAddress() < 0x2000)
+            UnshareChrRam(true);
+    }
+
+    bool nmi = ppu.IsNmiAsserted();
+    ppu.WriteRegister(addr, data, cpu.GetBusCycleCount());
+
+    // NMI enabled during vertical blank, raised after this instruction
+    if (!nmi && ppu.IsNmiAsserted())
+        ScheduleEvent(EventType::NMI, cpu.GetBusCycleCount());
+
+    // Pattern tables, sprite size or rendering switched (PPUCTRL, PPUMASK)
+    if ((addr & 0x0007) <= 0x0001 && mapper)
+        mapper->UpdatePpuSetup(ppu.GetControl(), ppu.GetMask());
+}
+
+template <typename Policy> uint8_t BasicBus<Policy>::ReadApuIoRegisters(uint16_t addr) {
+    // No APU nor controllers yet, open bus
+    return 0;
+}
+
+template <typename Policy>
+void BasicBus<Policy>::WriteApuIoRegisters(uint16_t addr, uint8_t data) {
+    // No APU nor controllers yet, only the sprite DMA register ($4014)
+    if (addr == 0x4014) {
+        // Starts once the writing cycle is over
+        oamDmaPage = data;
+        ScheduleEvent(EventType::OAM_DMA, cpu.GetBusCycleCount() + 1);
+    }
+}
+
+template <typename Policy> uint8_t BasicBus<Policy>::ReadCartridgeSpace(uint16_t addr) {
+    // Nothing answers, open bus
+    return 0;
+}
+
+template <typename Policy>
+void BasicBus<Policy>::WriteCartridgeSpace(uint16_t addr, uint8_t data) {
+    // Bank switching, the supported mappers having no registers below $8000
+    if (addr >= 0x8000 && mapper) {
+        ppu.CatchUp(cpu.GetBusCycleCount());
+        mapper->WriteRegister(addr, data);
+        ppu.SetMirroring(mapper->GetMirroring());
+    }
+}
+
+// Supported execution policies
+template class BasicBus<InstructionLevel>;
+template class BasicBus<CycleAccurate>;
@@ -0,0 +1,206 @@
+#include "../include/Cartridge.h"
+
+#include <cstring>
+
+#if CARTRIDGE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+/*
+
+iNES / NES 2.0 image layout
+
+ - 16 byte header: "NES\x1A", PRG-ROM size (16 KiB units), CHR-ROM size (8 KiB units), flags 6
+   (mirroring, battery, trainer, mapper low nibble), flags 7 (NES 2.0 identifier, mapper high
+   nibble), then either iNES's PRG-RAM size or NES 2.0's extensions: mapper bits 8-11 and
+   submapper, ROM sizes high nibbles (or exponent-multiplier notation), RAM sizes as shifts
+ - 512 byte trainer, if flags 6 says so, loaded at $7000
+ - PRG-ROM, then CHR-ROM (none for boards with CHR-RAM)
+
+*/
+
+Cartridge::Cartridge()
+    : image(nullptr), imageSize(0), error(nullptr), nes20(false), mapperNumber(0),
+      submapperNumber(0), mirroring(Mirroring::HORIZONTAL), battery(false), prgRom(nullptr),
+      prgRomSize(0), chrRom(nullptr), chrRomSize(0), prgRamSize(0), chrRamSize(0), hash(0),
+      hashed(false) {}
+
+Cartridge::~Cartridge() { CloseImage(); }
+
+bool Cartridge::Load(const char *path) {
+    CloseImage();
+    hashed = false;
+
+    if (!OpenImage(path))
+        return Fail("cannot be read");
+
+    return ParseHeader();
+}
+
+// Image access
+
+bool Cartridge::OpenImage(const char *path) {
+#if CARTRIDGE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd); // The mapping keeps the file referenced
+    if (mapping == MAP_FAILED)
+        return false;
+
+    image = (const uint8_t *)mapping;
+    imageSize = info.st_size;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    imageSize = file.tellg();
+    imageBuffer.reset(new uint8_t[imageSize]);
+    file.seekg(0);
+    if (!file.read((char *)imageBuffer.get(), imageSize)) {
+        imageBuffer.reset();
+        return false;
+    }
+
+    image = imageBuffer.get();
+#endif
+
+    return true;
+}
+
+void Cartridge::CloseImage() {
+#if CARTRIDGE_MMAP
+    if (image)
+        munmap((void *)image, imageSize);
+#else
+    imageBuffer.reset();
+#endif
+
+    image = nullptr;
+    imageSize = 0;
+    prgRom = chrRom = nullptr;
+    prgRomSize = chrRomSize = 0;
+    prgRam.reset();
+    prgRamSize = chrRamSize = 0;
+}
+
+// Header parsing
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t TRAINER_SIZE = 512;
+constexpr size_t PRG_ROM_UNIT = 16 * 1024;
+constexpr size_t CHR_ROM_UNIT = 8 * 1024;
+constexpr size_t DEFAULT_RAM_SIZE = 8 * 1024;
+
+// NES 2.0 ROM size, from its low byte and high nibble
+size_t Nes20RomSize(uint8_t lsb, uint8_t msb, size_t unit) {
+    if (msb != 0x0F)
+        return ((size_t(msb) << 8) | lsb) * unit;
+
+    // Exponent-multiplier notation (2^E * (MM * 2 + 1) bytes), for sizes not multiple of the unit
+    unsigned int exponent = lsb >> 2;
+    if (exponent > 40) // Way beyond any image, rejected by the size checks
+        return SIZE_MAX;
+
+    return (size_t(1) << exponent) * ((lsb & 0x03) * 2 + 1);
+}
+
+// NES 2.0 RAM size, from its shift count (none if 0)
+size_t Nes20RamSize(uint8_t shift) { return shift ? size_t(64) << shift : 0; }
+
+} // namespace
+
+bool Cartridge::ParseHeader() {
+    if (imageSize < HEADER_SIZE || std::memcmp(image, "NES\x1A", 4) != 0)
+        return Fail("not an iNES image");
+
+    const uint8_t *header = image;
+    uint8_t flags6 = header[6], flags7 = header[7];
+
+    nes20 = (flags7 & 0x0C) == 0x08;
+    mirroring = flags6 & 0x08   ? Mirroring::FOUR_SCREEN
+                : flags6 & 0x01 ? Mirroring::VERTICAL
+                                : Mirroring::HORIZONTAL;
+    battery = flags6 & 0x02;
+
+    if (nes20) {
+        mapperNumber = (flags6 >> 4) | (flags7 & 0xF0) | ((header[8] & 0x0F) << 8);
+        submapperNumber = header[8] >> 4;
+        prgRomSize = Nes20RomSize(header[4], header[9] & 0x0F, PRG_ROM_UNIT);
+        chrRomSize = Nes20RomSize(header[5], header[9] >> 4, CHR_ROM_UNIT);
+        prgRamSize = Nes20RamSize(header[10] & 0x0F) + Nes20RamSize(header[10] >> 4);
+        chrRamSize = Nes20RamSize(header[11] & 0x0F) + Nes20RamSize(header[11] >> 4);
+    } else {
+        // Old dumping tools left garbage in bytes 7 to 15 (e.g. "DiskDude!"), then flags 7 is
+        // meaningless too
+        bool garbage = header[12] || header[13] || header[14] || header[15];
+
+        mapperNumber = (flags6 >> 4) | (garbage ? 0 : flags7 & 0xF0);
+        submapperNumber = 0;
+        prgRomSize = header[4] * PRG_ROM_UNIT;
+        chrRomSize = header[5] * CHR_ROM_UNIT;
+        prgRamSize = (header[8] && !garbage ? header[8] : 1) * DEFAULT_RAM_SIZE;
+        chrRamSize = 0;
+    }
+
+    // Boards without CHR-ROM have 8 KiB of CHR-RAM unless told otherwise
+    if (chrRomSize == 0 && chrRamSize == 0)
+        chrRamSize = DEFAULT_RAM_SIZE;
+
+    size_t offset = HEADER_SIZE;
+    const uint8_t *trainer = nullptr;
+    if (flags6 & 0x04) {
+        trainer = image + offset;
+        offset += TRAINER_SIZE;
+
+        // Loaded at $7000
+        if (prgRamSize < DEFAULT_RAM_SIZE)
+            prgRamSize = DEFAULT_RAM_SIZE;
+    }
+
+    if (prgRomSize == 0 || offset > imageSize || prgRomSize > imageSize - offset ||
+        chrRomSize > imageSize - offset - prgRomSize)
+        return Fail("truncated image");
+
+    // ROM used in place
+    prgRom = image + offset;
+    chrRom = chrRomSize ? prgRom + prgRomSize : nullptr;
+
+    if (prgRamSize)
+        prgRam.reset(new uint8_t[prgRamSize]());
+
+    if (trainer)
+        std::memcpy(prgRam.get() + 0x1000, trainer, TRAINER_SIZE);
+
+    error = nullptr;
+    return true;
+}
+
+// Hash
+
+uint64_t Cartridge::GetHash() {
+    if (!hashed) {
+        // PRG-ROM and CHR-ROM are contiguous in the image
+        hash = 0xCBF29CE484222325;
+        for (size_t i = 0; i < prgRomSize + chrRomSize; i++)
+            hash = (hash ^ prgRom[i]) * 0x100000001B3;
+
+        hashed = true;
+    }
+
+    return hash;
+}
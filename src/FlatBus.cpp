@@ -0,0 +1,10 @@
+#include "../include/FlatBus.h"
+
+template <typename Policy> BasicFlatBus<Policy>::BasicFlatBus() : cpu(this), watchedPages() {
+    const unsigned int RAM_SIZE = 64 * 1024;
+    ram.reset(new uint8_t[RAM_SIZE]());
+}
+
+// Supported execution policies
+template class BasicFlatBus<InstructionLevel>;
+template class BasicFlatBus<CycleAccurate>;
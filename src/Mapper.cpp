@@ -0,0 +1,497 @@
+#include "../include/Mapper.h"
+#include "../include/Bus.h"
+#include "../include/PpuTiming.h"
+
+/*
+
+Supported boards
+
+ - NROM (0): no bank switching, 16 or 32 KiB of PRG-ROM, 8 KiB of CHR
+ - MMC1 (1): serial port loading 5 bit registers, 16 or 32 KiB PRG banks, 4 or 8 KiB CHR banks,
+   mirroring control
+ - UxROM (2): 16 KiB PRG bank at $8000, the last one fixed at $C000
+ - CNROM (3): 8 KiB CHR bank
+ - MMC3 (4): 8 KiB PRG banks, 1 and 2 KiB CHR banks, mirroring control, and a scanline counter
+   clocked by the PPU raising an IRQ
+
+Bus conflicts (UxROM, CNROM) are not emulated, games avoiding them anyway.
+
+*/
+
+template <typename BusType>
+Mapper<BusType>::Mapper(BusType &_bus, Cartridge &_cartridge)
+    : bus(_bus), cartridge(_cartridge), mirroring(_cartridge.GetMirroring()) {}
+
+// Bank mapping
+
+template <typename BusType> void Mapper<BusType>::MapPrg(uint16_t addr, uint32_t size, int bank) {
+    const uint8_t *prgRom = cartridge.GetPrgRom();
+    size_t prgRomSize = cartridge.GetPrgRomSize();
+
+    // ROMs smaller than the bank are mirrored across it
+    if (prgRomSize < size) {
+        bus.MapReadMemory(addr >> 8, (addr + size - 1) >> 8, prgRom, prgRomSize);
+        return;
+    }
+
+    int bankCount = prgRomSize / size;
+    bank = (bank % bankCount + bankCount) % bankCount;
+    bus.MapReadMemory(addr >> 8, (addr + size - 1) >> 8, prgRom + bank * size, size);
+}
+
+template <typename BusType> void Mapper<BusType>::MapChr(uint16_t addr, uint32_t size, int bank) {
+    uint8_t firstPage = addr / BusType::CHR_PAGE_SIZE;
+    uint8_t lastPage = (addr + size - 1) / BusType::CHR_PAGE_SIZE;
+
+    if (cartridge.GetChrRom()) {
+        const uint8_t *chrRom = cartridge.GetChrRom();
+        size_t chrRomSize = cartridge.GetChrRomSize();
+
+        int bankCount = chrRomSize < size ? 1 : chrRomSize / size;
+        bank = (bank % bankCount + bankCount) % bankCount;
+        bus.MapChrRom(firstPage, lastPage, chrRom + bank * size,
+                      chrRomSize < size ? chrRomSize : size);
+    } else {
+        uint8_t *chrRam = bus.GetChrRam();
+        size_t chrRamSize = cartridge.GetChrRamSize();
+
+        int bankCount = chrRamSize < size ? 1 : chrRamSize / size;
+        bank = (bank % bankCount + bankCount) % bankCount;
+        bus.MapChrRam(firstPage, lastPage, chrRam + bank * size,
+                      chrRamSize < size ? chrRamSize : size);
+    }
+}
+
+// Boards
+
+namespace {
+
+template <typename BusType> class Nrom : public Mapper<BusType> {
+public:
+    using Mapper<BusType>::Mapper;
+
+    void Reset() override {
+        this->MapPrg(0x8000, 32 * 1024, 0);
+        this->MapChr(0x0000, 8 * 1024, 0);
+    }
+};
+
+template <typename BusType> class Mmc1 : public Mapper<BusType> {
+public:
+    using Mapper<BusType>::Mapper;
+
+    void Reset() override {
+        shiftRegister = SHIFT_REGISTER_EMPTY;
+        lastWriteCycle = UINT64_MAX - 1;
+        control = 0x0C; // Last PRG bank fixed at $C000
+        chrBank0 = chrBank1 = prgBank = 0;
+
+        UpdateBanks();
+    }
+
+    void WriteRegister(uint16_t addr, uint8_t data) override {
+        // Writes on consecutive cycles (read-modify-write instructions) only load the first one
+        uint64_t cycle = this->bus.GetCpu().GetBusCycleCount();
+        bool consecutive = cycle == lastWriteCycle + 1;
+        lastWriteCycle = cycle;
+        if (consecutive)
+            return;
+
+        if (data & 0x80) { // Reset of the serial port
+            shiftRegister = SHIFT_REGISTER_EMPTY;
+            control |= 0x0C;
+            UpdateBanks();
+            return;
+        }
+
+        // 5 bits, least significant first, the marker bit reaching bit 0 once full
+        bool full = shiftRegister & 1;
+        shiftRegister = (shiftRegister >> 1) | ((data & 1) << 4);
+        if (!full)
+            return;
+
+        switch ((addr >> 13) & 0x03) {
+        case 0:
+            control = shiftRegister;
+            break;
+        case 1:
+            chrBank0 = shiftRegister;
+            break;
+        case 2:
+            chrBank1 = shiftRegister;
+            break;
+        case 3:
+            prgBank = shiftRegister & 0x0F; // Bit 4 (PRG-RAM disable) ignored
+            break;
+        }
+
+        shiftRegister = SHIFT_REGISTER_EMPTY;
+        UpdateBanks();
+    }
+
+    void SaveState(MapperState &state) const override {
+        Mapper<BusType>::SaveState(state);
+        this->SaveRegisters(
+            state, Registers{lastWriteCycle, shiftRegister, control, chrBank0, chrBank1, prgBank});
+    }
+
+    void LoadState(const MapperState &state) override {
+        Mapper<BusType>::LoadState(state);
+        Registers registers = this->template LoadRegisters<Registers>(state);
+        lastWriteCycle = registers.lastWriteCycle;
+        shiftRegister = registers.shiftRegister;
+        control = registers.control;
+        chrBank0 = registers.chrBank0;
+        chrBank1 = registers.chrBank1;
+        prgBank = registers.prgBank;
+
+        UpdateBanks();
+    }
+
+private:
+    static constexpr uint8_t SHIFT_REGISTER_EMPTY = 0x10; // Marker bit only
+
+    struct Registers {
+        uint64_t lastWriteCycle;
+        uint8_t shiftRegister, control, chrBank0, chrBank1, prgBank;
+    };
+
+    uint8_t shiftRegister;
+    uint64_t lastWriteCycle;
+    uint8_t control, chrBank0, chrBank1, prgBank;
+
+    void UpdateBanks() {
+        static constexpr Cartridge::Mirroring MIRRORINGS[4] = {
+            Cartridge::Mirroring::SINGLE_SCREEN_LOW, Cartridge::Mirroring::SINGLE_SCREEN_HIGH,
+            Cartridge::Mirroring::VERTICAL, Cartridge::Mirroring::HORIZONTAL};
+
+        if (this->cartridge.GetMirroring() != Cartridge::Mirroring::FOUR_SCREEN)
+            this->mirroring = MIRRORINGS[control & 0x03];
+
+        // 512 KiB boards (SUROM) select the 256 KiB half through CHR bank 0's bit 4
+        int prgHalf = this->cartridge.GetPrgRomSize() > 256 * 1024 ? (chrBank0 & 0x10) : 0;
+
+        switch ((control >> 2) & 0x03) {
+        case 0:
+        case 1: // 32 KiB
+            this->MapPrg(0x8000, 32 * 1024, (prgHalf | prgBank) >> 1);
+            break;
+        case 2: // First bank fixed at $8000
+            this->MapPrg(0x8000, 16 * 1024, prgHalf);
+            this->MapPrg(0xC000, 16 * 1024, prgHalf | prgBank);
+            break;
+        case 3: // Last bank fixed at $C000
+            this->MapPrg(0x8000, 16 * 1024, prgHalf | prgBank);
+            this->MapPrg(0xC000, 16 * 1024, prgHalf | 0x0F);
+            break;
+        }
+
+        if (control & 0x10) { // Two 4 KiB banks
+            this->MapChr(0x0000, 4 * 1024, chrBank0);
+            this->MapChr(0x1000, 4 * 1024, chrBank1);
+        } else {
+            this->MapChr(0x0000, 8 * 1024, chrBank0 >> 1);
+        }
+    }
+};
+
+template <typename BusType> class Uxrom : public Mapper<BusType> {
+public:
+    using Mapper<BusType>::Mapper;
+
+    void Reset() override {
+        bank = 0;
+        this->MapPrg(0x8000, 16 * 1024, bank);
+        this->MapPrg(0xC000, 16 * 1024, -1);
+        this->MapChr(0x0000, 8 * 1024, 0);
+    }
+
+    void WriteRegister(uint16_t addr, uint8_t data) override {
+        bank = data;
+        this->MapPrg(0x8000, 16 * 1024, bank);
+    }
+
+    void SaveState(MapperState &state) const override {
+        Mapper<BusType>::SaveState(state);
+        this->SaveRegisters(state, bank);
+    }
+
+    void LoadState(const MapperState &state) override {
+        Mapper<BusType>::LoadState(state);
+        bank = this->template LoadRegisters<uint8_t>(state);
+        this->MapPrg(0x8000, 16 * 1024, bank);
+    }
+
+private:
+    uint8_t bank; // At $8000
+};
+
+template <typename BusType> class Cnrom : public Mapper<BusType> {
+public:
+    using Mapper<BusType>::Mapper;
+
+    void Reset() override {
+        bank = 0;
+        this->MapPrg(0x8000, 32 * 1024, 0);
+        this->MapChr(0x0000, 8 * 1024, bank);
+    }
+
+    void WriteRegister(uint16_t addr, uint8_t data) override {
+        bank = data;
+        this->MapChr(0x0000, 8 * 1024, bank);
+    }
+
+    void SaveState(MapperState &state) const override {
+        Mapper<BusType>::SaveState(state);
+        this->SaveRegisters(state, bank);
+    }
+
+    void LoadState(const MapperState &state) override {
+        Mapper<BusType>::LoadState(state);
+        bank = this->template LoadRegisters<uint8_t>(state);
+        this->MapChr(0x0000, 8 * 1024, bank);
+    }
+
+private:
+    uint8_t bank; // CHR
+};
+
+// The scanline counter is not clocked along with the PPU: its value is only brought up to date
+// (from the A12 rises elapsed, see PpuTiming) when the program writes to it or changes the PPU
+// setup the rises depend on, and the cycle it reaches 0 at is scheduled as the mapper's event
+template <typename BusType> class Mmc3 : public Mapper<BusType> {
+public:
+    using Mapper<BusType>::Mapper;
+
+    void Reset() override {
+        bankSelect = 0;
+        for (int i = 0; i < 8; i++)
+            banks[i] = i < 6 ? i : i - 6; // Arbitrary until written
+        irqLatch = irqCounter = 0;
+        irqReload = irqEnabled = false;
+        counterCycle = this->bus.GetCpu().GetCycleCount();
+        irqCycle = 0;
+        a12RiseDot = PpuTiming::NO_A12_RISE; // Until told otherwise (see UpdatePpuSetup)
+        this->bus.CancelEvent(EventType::MAPPER);
+
+        MapPrgBanks();
+        MapChrBanks();
+    }
+
+    void WriteRegister(uint16_t addr, uint8_t data) override {
+        switch (addr & 0xE001) {
+        case 0x8000: { // Bank select, remapping the banks only if their arrangement changes
+            uint8_t changed = bankSelect ^ data;
+            bankSelect = data;
+            if (changed & 0x40)
+                MapPrgBanks();
+            if (changed & 0x80)
+                MapChrBanks();
+            break;
+        }
+        case 0x8001: // Bank data, remapping the selected bank only
+            banks[bankSelect & 0x07] = data;
+            MapBank(bankSelect & 0x07);
+            break;
+        case 0xA000: // Mirroring
+            if (this->cartridge.GetMirroring() != Cartridge::Mirroring::FOUR_SCREEN)
+                this->mirroring = data & 1 ? Cartridge::Mirroring::HORIZONTAL
+                                           : Cartridge::Mirroring::VERTICAL;
+            break;
+        case 0xA001: // PRG-RAM protection, ignored
+            break;
+        case 0xC000: // IRQ latch
+            CatchUpCounter();
+            irqLatch = data;
+            ScheduleIrq();
+            break;
+        case 0xC001: // IRQ reload, at the next A12 rise
+            CatchUpCounter();
+            irqCounter = 0;
+            irqReload = true;
+            ScheduleIrq();
+            break;
+        case 0xE000: // IRQ disable, acknowledging the pending one
+            CatchUpCounter();
+            irqEnabled = false;
+            this->bus.AcknowledgeIrq();
+            ScheduleIrq();
+            break;
+        case 0xE001: // IRQ enable
+            CatchUpCounter();
+            irqEnabled = true;
+            ScheduleIrq();
+            break;
+        }
+    }
+
+    void UpdatePpuSetup(uint8_t ctrl, uint8_t mask) override {
+        // Rises up to the write counted with the previous setup
+        CatchUpCounter();
+        a12RiseDot = PpuTiming::FindA12RiseDot(ctrl, mask);
+        ScheduleIrq();
+    }
+
+    void HandleEvent() override {
+        // Counter reaching 0 at the scheduled A12 rise
+        CatchUpCounter(irqCycle);
+        this->bus.AssertIrq();
+
+        ScheduleIrq();
+    }
+
+    void SaveState(MapperState &state) const override {
+        Mapper<BusType>::SaveState(state);
+
+        Registers registers;
+        registers.counterCycle = counterCycle;
+        registers.irqCycle = irqCycle;
+        registers.bankSelect = bankSelect;
+        std::memcpy(registers.banks, banks, sizeof(banks));
+        registers.irqLatch = irqLatch;
+        registers.irqCounter = irqCounter;
+        registers.irqReload = irqReload;
+        registers.irqEnabled = irqEnabled;
+        registers.a12RiseDot = a12RiseDot;
+        this->SaveRegisters(state, registers);
+    }
+
+    void LoadState(const MapperState &state) override {
+        Mapper<BusType>::LoadState(state);
+
+        Registers registers = this->template LoadRegisters<Registers>(state);
+        counterCycle = registers.counterCycle;
+        irqCycle = registers.irqCycle;
+        bankSelect = registers.bankSelect;
+        std::memcpy(banks, registers.banks, sizeof(banks));
+        irqLatch = registers.irqLatch;
+        irqCounter = registers.irqCounter;
+        irqReload = registers.irqReload;
+        irqEnabled = registers.irqEnabled;
+        a12RiseDot = registers.a12RiseDot;
+
+        MapPrgBanks();
+        MapChrBanks();
+    }
+
+private:
+    struct Registers {
+        uint64_t counterCycle, irqCycle;
+        uint8_t bankSelect;
+        uint8_t banks[8];
+        uint8_t irqLatch, irqCounter;
+        bool irqReload, irqEnabled;
+        uint16_t a12RiseDot;
+    };
+
+    uint8_t bankSelect;
+    uint8_t banks[8]; // R0 - R7
+
+    uint8_t irqLatch, irqCounter;
+    bool irqReload, irqEnabled;
+    uint64_t counterCycle; // CPU cycle irqCounter is up to date at
+    uint64_t irqCycle;     // CPU cycle of the scheduled IRQ
+    uint16_t a12RiseDot;   // Of rendered scanlines, with the current PPU setup (see PpuTiming)
+
+    // Maps the bank selected by the given register (R0 - R7) where the arrangement puts it
+    void MapBank(uint8_t reg) {
+        // PRG: R6 and the second to last bank swap places at $8000 and $C000
+        // CHR: 2 KiB banks (R0, R1) and 1 KiB ones (R2 - R5) swap halves with A12 inversion
+        uint16_t inversion = bankSelect & 0x80 ? 0x1000 : 0x0000;
+        if (reg == 6)
+            this->MapPrg(bankSelect & 0x40 ? 0xC000 : 0x8000, 8 * 1024, banks[6]);
+        else if (reg == 7)
+            this->MapPrg(0xA000, 8 * 1024, banks[7]);
+        else if (reg < 2)
+            this->MapChr((reg * 0x0800) ^ inversion, 2 * 1024, banks[reg] >> 1);
+        else
+            this->MapChr((0x1000 + (reg - 2) * 0x0400) ^ inversion, 1024, banks[reg]);
+    }
+
+    void MapPrgBanks() {
+        MapBank(6);
+        MapBank(7);
+        this->MapPrg(bankSelect & 0x40 ? 0x8000 : 0xC000, 8 * 1024, -2);
+        this->MapPrg(0xE000, 8 * 1024, -1);
+    }
+
+    void MapChrBanks() {
+        for (uint8_t reg = 0; reg < 6; reg++)
+            MapBank(reg);
+    }
+
+    // Applies the A12 rises elapsed since counterCycle: each of them reloads the counter from
+    // the latch if 0 (or asked to), decrements it otherwise
+    void CatchUpCounter(uint64_t cycle) {
+        uint64_t rises = PpuTiming::CountA12Rises(counterCycle, cycle, a12RiseDot);
+        counterCycle = cycle;
+        if (rises == 0)
+            return;
+
+        uint8_t counter = irqCounter == 0 || irqReload ? irqLatch : irqCounter - 1;
+        irqReload = false;
+        rises--;
+
+        // Then counting down to 0 and reloading again, every irqLatch + 1 rises
+        if (rises <= counter) {
+            irqCounter = counter - rises;
+        } else {
+            uint64_t phase = (rises - counter) % (irqLatch + 1);
+            irqCounter = phase == 0 ? 0 : irqLatch - (phase - 1);
+        }
+    }
+
+    void CatchUpCounter() {
+        uint64_t cycle = this->bus.GetCpu().GetBusCycleCount();
+
+        // IRQ due earlier in the instruction writing to the mapper, its event being dispatched
+        // after the instruction only
+        if (irqEnabled && irqCycle > counterCycle && irqCycle <= cycle) {
+            CatchUpCounter(irqCycle);
+            this->bus.AssertIrq();
+        }
+
+        CatchUpCounter(cycle);
+    }
+
+    // Schedules the A12 rise the counter reaches 0 at, if enabled and A12 rises at all
+    void ScheduleIrq() {
+        if (!irqEnabled || a12RiseDot == PpuTiming::NO_A12_RISE) {
+            this->bus.CancelEvent(EventType::MAPPER);
+            return;
+        }
+
+        // Reload first if 0 (then an IRQ on every rise if the latch is 0 too)
+        uint64_t rises = irqCounter == 0 || irqReload ? irqLatch + 1 : irqCounter;
+
+        irqCycle = PpuTiming::FindA12Rise(counterCycle, rises, a12RiseDot);
+        this->bus.ScheduleEvent(EventType::MAPPER, irqCycle);
+    }
+};
+
+} // namespace
+
+template <typename BusType>
+std::unique_ptr<Mapper<BusType>> CreateMapper(BusType &bus, Cartridge &cartridge) {
+    switch (cartridge.GetMapperNumber()) {
+    case 0:
+        return std::make_unique<Nrom<BusType>>(bus, cartridge);
+    case 1:
+        return std::make_unique<Mmc1<BusType>>(bus, cartridge);
+    case 2:
+        return std::make_unique<Uxrom<BusType>>(bus, cartridge);
+    case 3:
+        return std::make_unique<Cnrom<BusType>>(bus, cartridge);
+    case 4:
+        return std::make_unique<Mmc3<BusType>>(bus, cartridge);
+    default:
+        return nullptr;
+    }
+}
+
+// Supported bus types
+template class Mapper<Bus>;
+template class Mapper<CycleAccurateBus>;
+template std::unique_ptr<Mapper<Bus>> CreateMapper(Bus &bus, Cartridge &cartridge);
+template std::unique_ptr<Mapper<CycleAccurateBus>> CreateMapper(CycleAccurateBus &bus,
+                                                                 Cartridge &cartridge);
@@ -0,0 +1,503 @@
+#include "../include/NES2C02.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../include/PpuPipeline.h"
+#include "../include/PpuTiming.h"
+
+/*
+
+Frame of the NTSC PPU, 341 dots per scanline
+
+ - Scanlines 0 - 239: visible, pixel x being output at dot x + 1. The scroll position moves
+   down a row at dot 256 and back to the left edge at dot 257, then the sprites of the next
+   scanline are fetched (dots 257 - 320).
+ - Scanline 240: idle
+ - Scanlines 241 - 260: vertical blank, flagged (and NMI raised) from dot 1 of scanline 241
+ - Scanline 261: pre-render, clearing the flags at dot 1 and reloading the vertical scroll
+   position (dots 280 - 304)
+
+Only these milestones are run: pixels are rendered by spans, the fetches leading to them being
+done at once instead of dot by dot. The scroll position is kept as loaded at the start of the
+scanline (or by a PPUADDR write mid-scanline), pixels being located from it, rather than
+incremented tile by tile.
+
+*/
+
+NES2C02::NES2C02(const uint8_t *const *_chrReadPages, uint8_t *const *_chrWritePages)
+    : chrReadPages(_chrReadPages), chrWritePages(_chrWritePages), dot(0), catchUpCount(0),
+      spanCount(0), frameCount(0), vram(), palette(), oam(), chrMemory(nullptr),
+      chrTileCount(0), uncachedTile(), frameBuffer(), spanV(0), spanX(0), spriteLine(),
+      spriteMasks(), spriteMasksValid(false), renderSkip(false), spriteZeroX(SCREEN_WIDTH) {
+    Reset();
+    SetMirroring(Cartridge::Mirroring::HORIZONTAL);
+}
+
+void NES2C02::Reset() {
+    ctrl = mask = status = 0;
+    oamAddr = ioLatch = readBuffer = 0;
+    v = t = 0;
+    fineX = 0;
+    w = false;
+}
+
+// CPU interface
+
+uint8_t NES2C02::ReadRegister(uint16_t addr, uint64_t cycle) {
+    CatchUp(cycle);
+
+    switch (addr & 0x0007) {
+    case 2: // PPUSTATUS, acknowledging the vertical blank
+        ioLatch = (status & 0xE0) | (ioLatch & 0x1F);
+        status &= ~0x80;
+        w = false;
+        break;
+    case 4: // OAMDATA
+        ioLatch = oam[oamAddr];
+        break;
+    case 7: // PPUDATA
+        if ((v & 0x3FFF) >= 0x3F00) {
+            // Palette read right away, the buffer getting the nametable byte underneath
+            ioLatch = (ReadVram(v) & 0x3F) | (ioLatch & 0xC0);
+            readBuffer = ReadVram(v - 0x1000);
+        } else {
+            ioLatch = readBuffer;
+            readBuffer = ReadVram(v);
+        }
+        v = (v + (ctrl & 0x04 ? 32 : 1)) & 0x7FFF;
+        break;
+    default: // Write-only registers
+        break;
+    }
+
+    return ioLatch;
+}
+
+void NES2C02::WriteRegister(uint16_t addr, uint8_t data, uint64_t cycle) {
+    CatchUp(cycle);
+    ioLatch = data;
+
+    switch (addr & 0x0007) {
+    case 0: // PPUCTRL, its nametable select being the scroll position's
+        if ((ctrl ^ data) & 0x20)
+            InvalidateSprites(); // Height
+        ctrl = data;
+        t = (t & ~0x0C00) | ((data & 0x03) << 10);
+        break;
+    case 1: // PPUMASK
+        mask = data;
+        break;
+    case 3: // OAMADDR
+        oamAddr = data;
+        break;
+    case 4: // OAMDATA
+        oam[oamAddr++] = data;
+        InvalidateSprites();
+        break;
+    case 5: // PPUSCROLL, X then Y
+        if (!w) {
+            t = (t & ~0x001F) | (data >> 3);
+            fineX = data & 0x07;
+        } else {
+            t = (t & ~0x73E0) | ((data & 0x07) << 12) | ((data & 0xF8) << 2);
+        }
+        w = !w;
+        break;
+    case 6: // PPUADDR, high then low byte, the latter loading the scroll position
+        if (!w) {
+            t = (t & 0x00FF) | ((data & 0x3F) << 8);
+        } else {
+            t = (t & 0xFF00) | data;
+            v = t;
+
+            // Rest of the scanline rendered from there
+            unsigned int lineDot = dot % PpuTiming::DOTS_PER_SCANLINE;
+            spanV = v;
+            spanX = lineDot == 0 ? 0 : lineDot > SCREEN_WIDTH ? SCREEN_WIDTH : lineDot - 1;
+        }
+        w = !w;
+        break;
+    case 7: // PPUDATA
+        WriteVram(v, data);
+        v = (v + (ctrl & 0x04 ? 32 : 1)) & 0x7FFF;
+        break;
+    default: // PPUSTATUS is read-only
+        break;
+    }
+}
+
+void NES2C02::WriteOam(const uint8_t *data) {
+    // Wrapping around to the start of OAM if OAMADDR isn't 0
+    std::memcpy(oam + oamAddr, data, sizeof(oam) - oamAddr);
+    std::memcpy(oam, data + sizeof(oam) - oamAddr, oamAddr);
+    InvalidateSprites();
+}
+
+void NES2C02::SetMirroring(Cartridge::Mirroring mirroring) {
+    static constexpr uint16_t KIB = 1024;
+    static constexpr uint16_t OFFSETS[5][4] = {
+        {0, 0, KIB, KIB},           // Horizontal
+        {0, KIB, 0, KIB},           // Vertical
+        {0, KIB, 2 * KIB, 3 * KIB}, // Four-screen
+        {0, 0, 0, 0},               // Single screen, lower bank
+        {KIB, KIB, KIB, KIB},       // Single screen, upper bank
+    };
+
+    std::memcpy(nametableOffsets, OFFSETS[(uint8_t)mirroring], sizeof(nametableOffsets));
+}
+
+// Memory
+
+void NES2C02::SetChrMemory(const uint8_t *memory, size_t size) {
+    chrMemory = memory;
+    chrTileCount = size / 16;
+    tileCache.reset(new uint8_t[chrTileCount * 64]);
+    tilesDecoded.reset(new bool[chrTileCount]);
+    InvalidateTileCache();
+}
+
+void NES2C02::InvalidateTileCache() {
+    std::fill(tilesDecoded.get(), tilesDecoded.get() + chrTileCount, false);
+}
+
+const uint8_t *NES2C02::DecodeTile(const uint8_t *pattern, size_t tile) {
+    static const uint8_t NO_PALETTES[8] = {};
+
+    // The 8 rows of a tile are one batch: low bitplanes, then high ones
+    uint8_t *pixels = tile < chrTileCount ? &tileCache[tile * 64] : uncachedTile;
+    PpuPipeline::DecodeTileRows(pattern, pattern + 8, NO_PALETTES, 8, pixels);
+    if (tile < chrTileCount)
+        tilesDecoded[tile] = true;
+
+    return pixels;
+}
+
+uint8_t NES2C02::ReadVram(uint16_t addr) {
+    addr &= 0x3FFF;
+
+    if (addr < 0x2000)
+        return ReadChr(addr);
+    if (addr < 0x3F00)
+        return Nametable(addr);
+
+    return palette[PaletteIndex(addr)] & (mask & 0x01 ? 0x30 : 0x3F);
+}
+
+void NES2C02::WriteVram(uint16_t addr, uint8_t data) {
+    addr &= 0x3FFF;
+
+    if (addr < 0x2000) {
+        // CHR-RAM only
+        uint8_t *page = chrWritePages[addr >> 10];
+        if (page) {
+            page[addr & 0x03FF] = data;
+
+            size_t tile = ((uintptr_t)(page + (addr & 0x03F0)) - (uintptr_t)chrMemory) >> 4;
+            if (tile < chrTileCount)
+                tilesDecoded[tile] = false;
+        }
+    } else if (addr < 0x3F00) {
+        Nametable(addr) = data;
+    } else {
+        palette[PaletteIndex(addr)] = data & 0x3F;
+    }
+}
+
+// Synchronization
+
+void NES2C02::CatchUp(uint64_t cycle) {
+    uint64_t targetDot = (cycle + 1) * PpuTiming::DOTS_PER_CPU_CYCLE;
+    if (dot >= targetDot)
+        return;
+
+    catchUpCount++;
+
+    // Scanline by scanline, the last one possibly partially
+    while (dot < targetDot) {
+        uint64_t frameDot = dot % PpuTiming::DOTS_PER_FRAME;
+        unsigned int scanline = frameDot / PpuTiming::DOTS_PER_SCANLINE;
+        unsigned int fromDot = frameDot % PpuTiming::DOTS_PER_SCANLINE;
+
+        uint64_t scanlineEnd = dot - fromDot + PpuTiming::DOTS_PER_SCANLINE;
+        uint64_t endDot = targetDot < scanlineEnd ? targetDot : scanlineEnd;
+
+        RunScanline(scanline, fromDot, fromDot + (endDot - dot));
+        dot = endDot;
+    }
+}
+
+void NES2C02::IncrementY() {
+    if ((v & 0x7000) != 0x7000) {
+        v += 0x1000; // Fine Y
+        return;
+    }
+
+    // Next row of tiles, wrapping to the nametable below after the 30th (rows 30 and 31, in
+    // the attribute table, only being reached by scrolling there explicitly)
+    v &= ~0x7000;
+    uint16_t coarseY = (v >> 5) & 0x1F;
+    if (coarseY == 29) {
+        coarseY = 0;
+        v ^= 0x0800;
+    } else if (coarseY == 31) {
+        coarseY = 0;
+    } else {
+        coarseY++;
+    }
+    v = (v & ~0x03E0) | (coarseY << 5);
+}
+
+// Rendering
+
+void NES2C02::RunScanline(unsigned int scanline, unsigned int fromDot, unsigned int toDot) {
+    auto reaches = [&](unsigned int milestone) {
+        return fromDot <= milestone && milestone < toDot;
+    };
+    bool fetching = scanline < SCREEN_HEIGHT || scanline == PpuTiming::PRE_RENDER_SCANLINE;
+
+    if (scanline < SCREEN_HEIGHT) {
+        // Pixels of dots 1 - 256
+        unsigned int fromX = fromDot > 1 ? fromDot - 1 : 0;
+        unsigned int toX = toDot > SCREEN_WIDTH + 1 ? SCREEN_WIDTH : toDot > 1 ? toDot - 1 : 0;
+        if (fromX < toX)
+            RenderSpan(scanline, fromX, toX);
+    }
+
+    if (fetching && IsRenderingEnabled()) {
+        if (reaches(256))
+            IncrementY();
+        if (reaches(257))
+            CopyX();
+        if (scanline == PpuTiming::PRE_RENDER_SCANLINE && reaches(280))
+            CopyY();
+    }
+
+    // Sprites of the next scanline (none on the first one)
+    if (fetching && reaches(257)) {
+        if (scanline + 1 < SCREEN_HEIGHT && IsRenderingEnabled()) {
+            EvaluateSprites(scanline + 1);
+        } else {
+            std::memset(spriteLine, 0, sizeof(spriteLine));
+            spriteZeroX = SCREEN_WIDTH;
+        }
+    }
+
+    if (scanline == PpuTiming::VBLANK_SCANLINE && reaches(1)) {
+        status |= 0x80;
+        frameCount++;
+    }
+
+    if (scanline == PpuTiming::PRE_RENDER_SCANLINE && reaches(1))
+        status &= ~0xE0;
+}
+
+void NES2C02::RenderSpan(unsigned int scanline, unsigned int fromX, unsigned int toX) {
+    spanCount++;
+    uint8_t *colors = frameBuffer[scanline];
+    uint8_t colorMask = mask & 0x01 ? 0x30 : 0x3F; // Grayscale
+
+    if (!IsRenderingEnabled()) {
+        if (!renderSkip)
+            std::memset(colors + fromX, palette[0] & colorMask, toX - fromX);
+        return;
+    }
+
+    // Scroll position as loaded at the start of the scanline, unless PPUADDR was written since
+    if (fromX == 0) {
+        spanV = v;
+        spanX = 0;
+    }
+
+    // Skipped frame: only the pixels of sprite 0 matter, until it hits
+    uint8_t skippedColors[SCREEN_WIDTH];
+    if (renderSkip) {
+        if (status & 0x40 || (mask & 0x18) != 0x18)
+            return;
+
+        fromX = fromX > spriteZeroX ? fromX : spriteZeroX;
+        toX = toX < spriteZeroX + 8 ? toX : spriteZeroX + 8;
+        if (fromX >= toX)
+            return;
+
+        colors = skippedColors;
+    }
+
+    // Background and sprite pixels of the span, from fromX on
+    static const uint8_t TRANSPARENT[SCREEN_WIDTH] = {};
+    uint8_t backgroundTiles[SPAN_TILES * 8];
+    const uint8_t *background =
+        mask & 0x08 ? RenderBackground(fromX, toX, backgroundTiles) : TRANSPARENT + fromX;
+    const uint8_t *sprites = (mask & 0x10 ? spriteLine : TRANSPARENT) + fromX;
+
+    // Leftmost 8 pixels hidden unless enabled
+    bool spriteZeroHit = false;
+    unsigned int shown = 0;
+    if (fromX < 8 && (~mask & 0x06)) {
+        shown = (toX < 8 ? toX : 8) - fromX;
+
+        uint8_t shownBackground[8], shownSprites[8];
+        for (unsigned int i = 0; i < shown; i++) {
+            shownBackground[i] = mask & 0x02 ? background[i] : 0;
+            shownSprites[i] = mask & 0x04 ? sprites[i] : 0;
+        }
+
+        spriteZeroHit = PpuPipeline::Compose(shownBackground, shownSprites, shown, palette,
+                                             colorMask, colors + fromX);
+    }
+
+    spriteZeroHit |= PpuPipeline::Compose(background + shown, sprites + shown,
+                                          toX - fromX - shown, palette, colorMask,
+                                          colors + fromX + shown);
+    if (spriteZeroHit)
+        status |= 0x40;
+}
+
+const uint8_t *NES2C02::RenderBackground(unsigned int fromX, unsigned int toX,
+                                         uint8_t *pixels) {
+    unsigned int fineY = (spanV >> 12) & 0x07;
+    unsigned int coarseY = (spanV >> 5) & 0x1F;
+    uint16_t patternTable = ctrl & 0x10 ? 0x1000 : 0x0000;
+
+    // Column of the two horizontally adjacent nametables the first pixel lies in, then tiles
+    // covering the span, partial ones at both ends
+    unsigned int column = ((spanV & 0x1F) << 3) + fineX + (fromX - spanX);
+    unsigned int tileCount = ((column & 0x07) + (toX - fromX) + 7) / 8;
+
+    for (unsigned int i = 0; i < tileCount; i++) {
+        unsigned int tileX = ((column >> 3) + i) & 0x3F;
+        uint16_t nametable = 0x2000 | ((spanV & 0x0C00) ^ ((tileX & 0x20) << 5));
+        tileX &= 0x1F;
+
+        uint8_t tile = Nametable(nametable | (coarseY << 5) | tileX);
+        uint8_t attribute = Nametable(nametable | 0x03C0 | ((coarseY >> 2) << 3) | (tileX >> 2));
+        uint8_t tilePalette = (attribute >> (((coarseY & 0x02) << 1) | (tileX & 0x02))) & 0x03;
+
+        // Palette merged into the opaque pixels of the decoded row, 8 at once
+        uint64_t row, opaque;
+        std::memcpy(&row, GetTileRow(patternTable | (tile << 4) | fineY), 8);
+        opaque = (row | (row >> 1)) & 0x0101010101010101;
+        row |= opaque * (tilePalette << 2);
+        std::memcpy(pixels + i * 8, &row, 8);
+    }
+
+    return pixels + (column & 0x07);
+}
+
+void NES2C02::EvaluateSprites(unsigned int scanline) {
+    std::memset(spriteLine, 0, sizeof(spriteLine));
+
+    unsigned int height = ctrl & 0x20 ? 16 : 8;
+    if (!spriteMasksValid) {
+        uint8_t spriteY[64];
+        for (unsigned int i = 0; i < 64; i++)
+            spriteY[i] = oam[i * 4];
+
+        PpuPipeline::FindSprites(spriteY, height, SCREEN_HEIGHT, spriteMasks);
+        spriteMasksValid = true;
+    }
+
+    // Up to 8 sprites on the scanline (without the hardware's false positives), in OAM order,
+    // sprites being delayed by one scanline
+    uint64_t found = spriteMasks[scanline - 1];
+    if (__builtin_popcountll(found) > 8)
+        status |= 0x20;
+
+    spriteZeroX = found & 1 ? oam[3] : SCREEN_WIDTH;
+    if (renderSkip)
+        found &= 1; // Only sprite 0, for its hits
+
+    for (unsigned int count = 0; found && count < 8; count++, found &= found - 1) {
+        unsigned int i = __builtin_ctzll(found);
+        const uint8_t *sprite = oam + i * 4;
+        uint8_t tile = sprite[1], attributes = sprite[2], spriteX = sprite[3];
+
+        unsigned int row = scanline - 1 - sprite[0];
+        if (attributes & 0x80)
+            row = height - 1 - row; // Vertical flip
+
+        uint16_t pattern;
+        if (height == 16)
+            pattern = ((tile & 0x01) << 12) | ((tile & 0xFE) << 4) | ((row & 0x08) << 1);
+        else
+            pattern = (ctrl & 0x08 ? 0x1000 : 0x0000) | (tile << 4);
+        pattern |= row & 0x07;
+
+        uint64_t colors;
+        std::memcpy(&colors, GetTileRow(pattern), 8);
+        if (attributes & 0x40)
+            colors = __builtin_bswap64(colors); // Horizontal flip, reversing the pixels
+
+        // 8 pixels at once: palette and flags merged into the opaque ones, which are drawn
+        // where no earlier sprite is opaque (earlier sprites taking precedence, even behind the
+        // background)
+        uint8_t flags = ((attributes & 0x03) << 2) |
+                        (attributes & 0x20 ? PpuPipeline::SPRITE_BEHIND : 0) |
+                        (i == 0 ? PpuPipeline::SPRITE_ZERO : 0);
+        uint64_t line;
+        std::memcpy(&line, spriteLine + spriteX, 8);
+
+        const uint64_t LOW_BITS = 0x0101010101010101;
+        uint64_t opaque = (colors | (colors >> 1)) & LOW_BITS;
+        uint64_t covered = (line | (line >> 1)) & LOW_BITS;
+        uint64_t drawn = (opaque & ~covered) * 0xFF;
+        line = (line & ~drawn) | ((colors | opaque * flags) & drawn);
+        std::memcpy(spriteLine + spriteX, &line, 8);
+    }
+
+    // No sprite 0 hit on the last pixel
+    spriteLine[SCREEN_WIDTH - 1] &= ~PpuPipeline::SPRITE_ZERO;
+}
+
+// Snapshots
+
+void NES2C02::SaveState(State &state) const {
+    state.dot = dot;
+    state.catchUpCount = catchUpCount;
+    state.spanCount = spanCount;
+    state.frameCount = frameCount;
+    state.ctrl = ctrl;
+    state.mask = mask;
+    state.status = status;
+    state.oamAddr = oamAddr;
+    state.ioLatch = ioLatch;
+    state.readBuffer = readBuffer;
+    state.v = v;
+    state.t = t;
+    state.fineX = fineX;
+    state.w = w;
+    state.spanV = spanV;
+    state.spanX = spanX;
+    state.spriteZeroX = spriteZeroX;
+    std::memcpy(state.vram, vram, sizeof(vram));
+    std::memcpy(state.palette, palette, sizeof(palette));
+    std::memcpy(state.oam, oam, sizeof(oam));
+    std::memcpy(state.spriteLine, spriteLine, sizeof(spriteLine));
+}
+
+void NES2C02::LoadState(const State &state) {
+    dot = state.dot;
+    catchUpCount = state.catchUpCount;
+    spanCount = state.spanCount;
+    frameCount = state.frameCount;
+    ctrl = state.ctrl;
+    mask = state.mask;
+    status = state.status;
+    oamAddr = state.oamAddr;
+    ioLatch = state.ioLatch;
+    readBuffer = state.readBuffer;
+    v = state.v;
+    t = state.t;
+    fineX = state.fineX;
+    w = state.w;
+    spanV = state.spanV;
+    spanX = state.spanX;
+    spriteZeroX = state.spriteZeroX;
+    std::memcpy(vram, state.vram, sizeof(vram));
+    std::memcpy(palette, state.palette, sizeof(palette));
+    std::memcpy(oam, state.oam, sizeof(oam));
+    std::memcpy(spriteLine, state.spriteLine, sizeof(spriteLine));
+
+    // Found again from the OAM loaded
+    InvalidateSprites();
+}
@@ -1,7 +1,33 @@
 #include "../include/NES6502.h"
 #include "../include/Bus.h"
-
-NES6502::NES6502(Bus *_bus) {
+#include "../include/FlatBus.h"
+#include "../include/TracingBus.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Handlers indexed by NES6502Base::AddrMode
+template <typename BusType, typename Policy, typename Cpu = NES6502<BusType, Policy>>
+static constexpr uint8_t (Cpu::*addrModeHandlers[])() = {
+    &Cpu::IMP, &Cpu::IMM, &Cpu::ZP0, &Cpu::ZPX, &Cpu::ZPY, &Cpu::REL, &Cpu::ABS, &Cpu::ABX,
+    &Cpu::ABY, &Cpu::IND, &Cpu::IZX, &Cpu::IZY};
+
+// Handlers indexed by NES6502Base::Operation, specialized for the given address mode
+template <typename BusType, typename Policy, NES6502Base::AddrMode mode,
+          typename Cpu = NES6502<BusType, Policy>>
+static constexpr uint8_t (Cpu::*operationHandlers[])() = {
+    &Cpu::template ADC<mode>, &Cpu::template AND<mode>, &Cpu::template ASL<mode>, &Cpu::BCC,
+    &Cpu::BCS, &Cpu::BEQ, &Cpu::template BIT<mode>, &Cpu::BMI, &Cpu::BNE, &Cpu::BPL, &Cpu::BRK,
+    &Cpu::BVC, &Cpu::BVS, &Cpu::CLC, &Cpu::CLD, &Cpu::CLI, &Cpu::CLV, &Cpu::template CMP<mode>,
+    &Cpu::template CPX<mode>, &Cpu::template CPY<mode>, &Cpu::template DEC<mode>, &Cpu::DEX,
+    &Cpu::DEY, &Cpu::template EOR<mode>, &Cpu::template INC<mode>, &Cpu::INX, &Cpu::INY, &Cpu::JMP,
+    &Cpu::JSR, &Cpu::template LDA<mode>, &Cpu::template LDX<mode>, &Cpu::template LDY<mode>,
+    &Cpu::template LSR<mode>, &Cpu::NOP, &Cpu::template ORA<mode>, &Cpu::PHA, &Cpu::PHP, &Cpu::PLA,
+    &Cpu::PLP, &Cpu::template ROL<mode>, &Cpu::template ROR<mode>, &Cpu::RTI, &Cpu::RTS,
+    &Cpu::template SBC<mode>, &Cpu::SEC, &Cpu::SED, &Cpu::SEI, &Cpu::STA, &Cpu::STX, &Cpu::STY,
+    &Cpu::TAX, &Cpu::TAY, &Cpu::TSX, &Cpu::TXA, &Cpu::TXS, &Cpu::TYA, &Cpu::XXX};
+
+template <typename BusType, typename Policy> NES6502<BusType, Policy>::NES6502(BusType *_bus) {
     bus = _bus;
 
     /* CPU registers */
@@ -11,6 +37,10 @@ NES6502::NES6502(Bus *_bus) {
     stkp = 0;
     pc = 0;
     status = 0;
+    lazyNZ = 1;
+    lazyC = 0;
+    lazyV1 = lazyV2 = lazyVResult = 0;
+    irqLine = false;
 
     /* Internal emulation helpers */
     fetchedData = 0;
@@ -18,39 +48,149 @@ NES6502::NES6502(Bus *_bus) {
     addr_rel = 0;
     opcode = 0;
     cycles = 0;
+    busCycles = 0;
+    clockCount = 0;
+    runTarget = 0;
+    operand = 0;
+
+    /* Decoded block cache */
+    codeGeneration = 0;
+
+    /* Idle loops */
+    idleLoopSkipping = true;
+    idleCycleCount = 0;
+    idleLoopPass = {};
 }
 
 // Memory access
+// With the cycle-accurate policy, every access takes one bus cycle of the current instruction
+// (see GetBusCycleCount)
+
+template <typename BusType, typename Policy>
+uint8_t NES6502<BusType, Policy>::ReadRam(uint16_t addr) {
+    uint8_t data = bus->ReadRam(addr);
+
+    if constexpr (Policy::CYCLE_ACCURATE)
+        busCycles++;
 
-uint8_t NES6502::ReadRam(uint16_t addr) const { return bus->ReadRam(addr); }
+    return data;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::WriteRam(uint16_t addr, uint8_t data) {
+    bus->WriteRam(addr, data);
 
-void NES6502::WriteRam(uint16_t addr, uint8_t data) const { return bus->WriteRam(addr, data); }
+    if constexpr (Policy::CYCLE_ACCURATE)
+        busCycles++;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::DummyRead(uint16_t addr) {
+    if constexpr (Policy::CYCLE_ACCURATE)
+        ReadRam(addr);
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::DummyWrite(uint16_t addr, uint8_t data) {
+    if constexpr (Policy::CYCLE_ACCURATE)
+        WriteRam(addr, data);
+}
 
 // Status register access
 
-uint8_t NES6502::GetFlag(FLAGS flag) { return 0; }
+// N, Z, C and V are evaluated lazily: instructions only record their result and operands
+// (see RecordNZ, RecordC and RecordV), and the flags are derived from them when observed.
+// The other flags are kept in the status register as is.
+
+template <typename BusType, typename Policy>
+uint8_t NES6502<BusType, Policy>::GetFlag(FLAGS flag) {
+    switch (flag) {
+    case C:
+        return lazyC;
+    case Z:
+        return (lazyNZ & 0x00FF) == 0;
+    case N:
+        return (lazyNZ & 0x0180) != 0;
+    case V:
+        return ((lazyV1 ^ lazyVResult) & (lazyV2 ^ lazyVResult) & 0x80) != 0;
+    default:
+        return (status & flag) != 0;
+    }
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::SetFlag(FLAGS flag, bool value) {
+    switch (flag) {
+    case C:
+        lazyC = value;
+        break;
+    case Z: // N is kept through bit 8, which does not take part in Z
+        lazyNZ = (GetFlag(N) << 8) | !value;
+        break;
+    case N:
+        lazyNZ = (value << 8) | !GetFlag(Z);
+        break;
+    case V:
+        RecordV(value << 7, value << 7, 0);
+        break;
+    default:
+        if (value)
+            status |= flag;
+        else
+            status &= ~flag;
+    }
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::GetStatus() {
+    // Packing of the lazily evaluated flags into the status register
+    uint8_t packed = status & ~(C | Z | V | N);
 
-void NES6502::SetFlag(FLAGS flag, bool value) {}
+    packed |= GetFlag(C) ? C : 0;
+    packed |= GetFlag(Z) ? Z : 0;
+    packed |= GetFlag(V) ? V : 0;
+    packed |= GetFlag(N) ? N : 0;
+
+    return packed;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::SetStatus(uint8_t value) {
+    status = value;
+
+    SetFlag(C, value & C);
+    SetFlag(V, value & V);
+    lazyNZ = ((value & N) << 1) | !(value & Z); // Both N and Z at once
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::CheckIrqUnmasked() {
+    // Taken by the owner of the run once it returns (see SetIrqLine)
+    if (IsIrqPending())
+        StopRunAt(clockCount);
+}
 
 // Address modes
+// The operand bytes following the opcode are fetched beforehand (see Execute)
 
-uint8_t NES6502::IMP() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::IMP() {
     // The operand's address is implicitly given in the instruction
 
+    DummyRead(pc); // The byte following the opcode is read all the same
+
     fetchedData = a; // May operate on the accumulator
 
     return 0;
 }
 
-uint8_t NES6502::IMM() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::IMM() {
     // The operand is directly supplied in the instruction
 
-    addr_abs = pc++; // The operand (data) is located in the next byte
+    addr_abs = pc - 1; // The operand (data) is located in the previous byte, already fetched
 
     return 0;
 }
 
-uint8_t NES6502::ZP0() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ZP0() {
     // Addresses' structure:
     //
     // --------------------------------
@@ -66,38 +206,40 @@ uint8_t NES6502::ZP0() {
     // Here, we "shortcut" the page byte reading (which takes time!) and directly assume page
     // zero.
 
-    addr_abs = ReadRam(pc++); // why increment here while already in clock?
-    addr_abs &=
-        0x00FF; // 0x00XX for page zero (page byte at 00)
-                // 8b(returned by ReadRam) into 16b will always keep high byte at 0, useless?
+    addr_abs = operand;
+    addr_abs &= 0x00FF; // 0x00XX for page zero (page byte at 00)
 
     return 0;
 }
 
-uint8_t NES6502::ZPX() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ZPX() {
     // X register offsets the absolute memory address
 
-    addr_abs = ReadRam(pc++) + x;
+    DummyRead(operand & 0x00FF); // Read from the base address while indexing
+
+    addr_abs = operand + x;
     addr_abs &= 0x00FF; // same remarks as in ZP0
 
     return 0;
 }
 
-uint8_t NES6502::ZPY() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ZPY() {
     // Y register offsets the absolute memory address
 
-    addr_abs = ReadRam(pc++) + y;
+    DummyRead(operand & 0x00FF); // Read from the base address while indexing
+
+    addr_abs = operand + y;
     addr_abs &= 0x00FF; // same remarks as in ZP0
 
     return 0;
 }
 
-uint8_t NES6502::REL() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::REL() {
     // Only used for branching instructions,
     // that can't jump anywhere in the addressable space,
     // only to the current address' vicinity (at most 127 meomry locations)
 
-    addr_rel = ReadRam(pc++);
+    addr_rel = operand;
 
     // Since the address in question is relative,
     // the determination of whether it is ahead or behind the current address
@@ -109,12 +251,11 @@ uint8_t NES6502::REL() {
     return 0;
 }
 
-uint8_t NES6502::ABS() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ABS() {
     // The operand's absolute memory address is directly supplied in the instruction
 
-    uint16_t lo = ReadRam(pc++);
-    uint16_t hi = ReadRam(pc++);
-    // uint16_t hi = ReadRam(pc++) << 8; better to bitshift here?
+    uint16_t lo = operand & 0x00FF;
+    uint16_t hi = operand >> 8;
 
     addr_abs = (hi << 8) | lo;
     // addr_abs = hi | lo;
@@ -122,11 +263,11 @@ uint8_t NES6502::ABS() {
     return 0;
 }
 
-uint8_t NES6502::ABX() {
-    uint16_t lo = ReadRam(pc++);
-    uint16_t hi = ReadRam(pc++);
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ABX() {
+    uint16_t lo = operand & 0x00FF;
+    uint16_t hi = operand >> 8;
 
-    addr_abs = (hi << 8) | lo + x;
+    addr_abs = ((hi << 8) | lo) + x;
 
     // If the page boundary has been crossed...
     if ((addr_abs & 0xFF00) != (hi << 8))
@@ -135,11 +276,11 @@ uint8_t NES6502::ABX() {
         return 0; // ...exit without an additional clock cycle requirement
 }
 
-uint8_t NES6502::ABY() {
-    uint16_t lo = ReadRam(pc++);
-    uint16_t hi = ReadRam(pc++);
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::ABY() {
+    uint16_t lo = operand & 0x00FF;
+    uint16_t hi = operand >> 8;
 
-    addr_abs = (hi << 8) | lo + y;
+    addr_abs = ((hi << 8) | lo) + y;
 
     // If the page boundary has been crossed...
     if ((addr_abs & 0xFF00) != (hi << 8))
@@ -148,26 +289,31 @@ uint8_t NES6502::ABY() {
         return 0; // ...exit without an additional clock cycle requirement
 }
 
-uint8_t NES6502::IND() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::IND() {
     // Similar to the absolute address mode,
     // but its operand is a pointer to the address of the data.
 
-    uint16_t p_lo = ReadRam(pc++);
-    uint16_t p_hi = ReadRam(pc++);
+    uint16_t p_lo = operand & 0x00FF;
+    uint16_t p_hi = operand >> 8;
 
     uint16_t p_addr_abs = (p_hi << 8) | p_lo;
 
-    if (p_lo != 0x00FF) // Page boundary hardware bug simulation
+    // Low byte first, then high byte
+    addr_abs = ReadRam(p_addr_abs);
+
+    if (p_lo == 0x00FF) // Page boundary hardware bug simulation
         // see www.nesdev.org/6502bugs.txt "*An indirect JMP (xxFF) will fail because..."
-        addr_abs = (ReadRam(p_addr_abs & 0xFF00) << 8) | ReadRam(p_addr_abs);
+        addr_abs |= ReadRam(p_addr_abs & 0xFF00) << 8;
     else // Normal behaviour
-        addr_abs = (ReadRam(p_addr_abs + 1) << 8) | ReadRam(p_addr_abs);
+        addr_abs |= ReadRam(p_addr_abs + 1) << 8;
 
     return 0;
 }
 
-uint8_t NES6502::IZX() {
-    uint16_t zp_addr = ReadRam(pc++); // Zero page assumed
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::IZX() {
+    uint16_t zp_addr = operand; // Zero page assumed
+
+    DummyRead(zp_addr); // Read from the pointer's base address while indexing
 
     uint16_t lo = ReadRam((zp_addr + (uint16_t)x) & 0x00FF);
     uint16_t hi = ReadRam((zp_addr + (uint16_t)x + 1) & 0x00FF);
@@ -177,15 +323,15 @@ uint8_t NES6502::IZX() {
     return 0;
 }
 
-uint8_t NES6502::IZY() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::IZY() {
     // Same as IZX but the offset is applied to the obtained absolute address
 
-    uint16_t zp_addr = ReadRam(pc++); // Zero page assumed
+    uint16_t zp_addr = operand; // Zero page assumed
 
     uint16_t lo = ReadRam(zp_addr & 0x00FF);
     uint16_t hi = ReadRam((zp_addr + 1) & 0x00FF);
 
-    addr_abs = (hi << 8) | lo + y;
+    addr_abs = ((hi << 8) | lo) + y;
 
     // If the page boundary has been crossed...
     if ((addr_abs & 0xFF00) != (hi << 8))
@@ -196,17 +342,17 @@ uint8_t NES6502::IZY() {
 
 // Instruction set
 
-uint8_t NES6502::ADC() {
-    FetchData();
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::ADC() {
+    FetchData<mode>();
 
     uint16_t temp = (uint16_t)(a + fetchedData + GetFlag(C));
 
     // Status registers update
-    SetFlag(C, temp > 0x00FF);        // If the operation result holds a carry bit
-    SetFlag(Z, (temp & 0x00FF) == 0); // If the operation result is 0
-    SetFlag(N, temp & 0x0080);        // If bit 7 is equal to 1
-    SetFlag(V, (~((uint16_t)a ^ (uint16_t)fetchedData) & ((uint16_t)a ^ temp)) & 0x0080);
-    // See overflow logic equation
+    RecordC(temp > 0x00FF);        // If the operation result holds a carry bit
+    RecordNZ(temp & 0x00FF);       // If the operation result is 0, or if bit 7 is equal to 1
+    RecordV(a, fetchedData, temp); // See overflow logic equation
 
     a = temp & 0x00FF; // Result stored in the accumulator
 
@@ -216,222 +362,358 @@ uint8_t NES6502::ADC() {
               // the address mode too may require it
 }
 
-uint8_t NES6502::AND() {
-    FetchData();
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::AND() {
+    FetchData<mode>();
 
     // AND logical operation
     a &= fetchedData;
 
     // Status registers update
-    SetFlag(Z, a == 0);
-    SetFlag(N, a & 0x0080);
+    RecordNZ(a);
 
     return 1;
 }
 
-uint8_t NES6502::ASL() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::ASL() {
+    FetchData<mode>();
 
-uint8_t NES6502::BCC() {
-    if (GetFlag(C) == 0) {
-        cycles++; // Necessary additional clock cycle
+    uint8_t temp = fetchedData << 1;
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    // Status registers update
+    RecordC(fetchedData >> 7); // Bit 7 is shifted out into the carry
+    RecordNZ(temp);
+
+    if constexpr (mode == AddrMode::IMP) { // Operates on the accumulator
+        a = temp;
+    } else {
+        DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+        WriteRam(addr_abs, temp);
+    }
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+    return 0;
+}
 
-        pc = addr_abs; // Program counter update
-    }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BCC() {
+    if (GetFlag(C) == 0)
+        TakeBranch();
 
     return 0;
 }
 
-uint8_t NES6502::BCS() {
-    if (GetFlag(C) == 1) {
-        cycles++; // Necessary additional clock cycle
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BCS() {
+    if (GetFlag(C) == 1)
+        TakeBranch();
+
+    return 0;
+}
 
-        addr_abs = pc + addr_rel; // Absolute address update
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BEQ() {
+    if (GetFlag(Z) == 1)
+        TakeBranch();
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-                      // (see R650X datasheet, "Instruction set summary" table)
+    return 0;
+}
 
-        pc = addr_abs; // Program counter update
-    }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::BIT() {
+    FetchData<mode>();
+
+    // Status registers update
+    // Z comes from the AND of both operands, while N and V are bits 7 and 6 of the memory
+    RecordNZ((a & fetchedData) | ((fetchedData & 0x0080) << 1));
+    RecordV(fetchedData << 1, fetchedData << 1, 0);
 
     return 0;
 }
 
-uint8_t NES6502::BEQ() {
-    if (GetFlag(Z) == 1) {
-        cycles++; // Necessary additional clock cycle
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BMI() {
+    if (GetFlag(N) == 1)
+        TakeBranch();
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    return 0;
+}
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BNE() {
+    if (GetFlag(Z) == 0)
+        TakeBranch();
 
-        pc = addr_abs; // Program counter update
-    }
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BPL() {
+    if (GetFlag(N) == 0)
+        TakeBranch();
 
     return 0;
 }
 
-uint8_t NES6502::BIT() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BRK() {
+    // The padding byte following BRK was already skipped by its immediate address mode
+
+    WriteRam(0x0100 + stkp--, (pc >> 8) & 0x00FF); // 0x0100 is the hard coded base stack address
+    WriteRam(0x0100 + stkp--, pc & 0x00FF);
 
-uint8_t NES6502::BMI() {
-    if (GetFlag(N) == 1) {
-        cycles++; // Necessary additional clock cycle
+    // The status register is pushed with the break flag set
+    WriteRam(0x0100 + stkp--, GetStatus() | B | U);
+    SetFlag(I, true);
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    pc = (uint16_t)ReadRam(0xFFFE);
+    pc |= (uint16_t)ReadRam(0xFFFF) << 8;
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+    return 0;
+}
 
-        pc = addr_abs; // Program counter update
-    }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BVC() {
+    if (GetFlag(V) == 0)
+        TakeBranch();
 
     return 0;
 }
 
-uint8_t NES6502::BNE() {
-    if (GetFlag(Z) == 0) {
-        cycles++; // Necessary additional clock cycle
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::BVS() {
+    if (GetFlag(V) == 1)
+        TakeBranch();
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    return 0;
+}
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::CLC() {
+    SetFlag(C, false);
 
-        pc = addr_abs; // Program counter update
-    }
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::CLD() {
+    SetFlag(D, false);
 
     return 0;
 }
 
-uint8_t NES6502::BPL() {
-    if (GetFlag(N) == 0) {
-        cycles++; // Necessary additional clock cycle
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::CLI() {
+    SetFlag(I, false);
+    CheckIrqUnmasked();
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    return 0;
+}
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::CLV() {
+    SetFlag(V, false);
 
-        pc = addr_abs; // Program counter update
-    }
+    return 0;
+}
+
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::CMP() {
+    FetchData<mode>();
+
+    // Status registers update
+    RecordC(a >= fetchedData);
+    RecordNZ((uint8_t)(a - fetchedData));
+
+    return 1;
+}
+
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::CPX() {
+    FetchData<mode>();
+
+    // Status registers update
+    RecordC(x >= fetchedData);
+    RecordNZ((uint8_t)(x - fetchedData));
 
     return 0;
 }
 
-uint8_t NES6502::BRK() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::CPY() {
+    FetchData<mode>();
 
-uint8_t NES6502::BVC() {
-    if (GetFlag(V) == 0) {
-        cycles++; // Necessary additional clock cycle
+    // Status registers update
+    RecordC(y >= fetchedData);
+    RecordNZ((uint8_t)(y - fetchedData));
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    return 0;
+}
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::DEC() {
+    FetchData<mode>();
 
-        pc = addr_abs; // Program counter update
-    }
+    uint8_t temp = fetchedData - 1;
+    DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+    WriteRam(addr_abs, temp);
+
+    RecordNZ(temp);
 
     return 0;
 }
 
-uint8_t NES6502::BVS() {
-    if (GetFlag(V) == 1) {
-        cycles++; // Necessary additional clock cycle
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::DEX() {
+    x--;
 
-        addr_abs = pc + addr_rel; // Absolute address update
+    RecordNZ(x);
 
-        // If the page boundary has been crossed...
-        if ((addr_abs & 0xFF00) != (pc & 0xFF00))
-            cycles++; // Another additional clock cycle
-        // (see R650X datasheet, "Instruction set summary" table)
+    return 0;
+}
 
-        pc = addr_abs; // Program counter update
-    }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::DEY() {
+    y--;
+
+    RecordNZ(y);
 
     return 0;
 }
 
-uint8_t NES6502::CLC() {
-    SetFlag(C, false);
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::EOR() {
+    FetchData<mode>();
+
+    // Exclusive-OR logical operation
+    a ^= fetchedData;
+
+    RecordNZ(a);
+
+    return 1;
+}
+
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::INC() {
+    FetchData<mode>();
+
+    uint8_t temp = fetchedData + 1;
+    DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+    WriteRam(addr_abs, temp);
+
+    RecordNZ(temp);
 
     return 0;
 }
 
-uint8_t NES6502::CLD() {
-    SetFlag(D, false);
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::INX() {
+    x++;
+
+    RecordNZ(x);
 
     return 0;
 }
 
-uint8_t NES6502::CLI() {
-    SetFlag(I, false);
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::INY() {
+    y++;
+
+    RecordNZ(y);
 
     return 0;
 }
 
-uint8_t NES6502::CLV() {
-    SetFlag(V, false);
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::JMP() {
+    pc = addr_abs;
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::JSR() {
+    // The return address pushed is the last byte of the instruction, which the cycle-accurate
+    // policy only reads once the return address is pushed (see Execute)
+    if constexpr (!Policy::CYCLE_ACCURATE)
+        pc--;
+
+    DummyRead(0x0100 + stkp); // Internal cycle
+
+    WriteRam(0x0100 + stkp--, (pc >> 8) & 0x00FF); // 0x0100 is the hard coded base stack address
+    WriteRam(0x0100 + stkp--, pc & 0x00FF);
+
+    if constexpr (Policy::CYCLE_ACCURATE)
+        addr_abs |= ReadRam(pc) << 8;
+
+    pc = addr_abs;
 
     return 0;
 }
 
-uint8_t NES6502::CMP() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::LDA() {
+    FetchData<mode>();
+
+    a = fetchedData;
+
+    RecordNZ(a);
+
+    return 1;
+}
 
-uint8_t NES6502::CPX() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::LDX() {
+    FetchData<mode>();
 
-uint8_t NES6502::CPY() { return 0; }
+    x = fetchedData;
 
-uint8_t NES6502::DEC() { return 0; }
+    RecordNZ(x);
 
-uint8_t NES6502::DEX() { return 0; }
+    return 1;
+}
 
-uint8_t NES6502::DEY() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::LDY() {
+    FetchData<mode>();
 
-uint8_t NES6502::EOR() { return 0; }
+    y = fetchedData;
 
-uint8_t NES6502::INC() { return 0; }
+    RecordNZ(y);
 
-uint8_t NES6502::INX() { return 0; }
+    return 1;
+}
 
-uint8_t NES6502::INY() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::LSR() {
+    FetchData<mode>();
 
-uint8_t NES6502::JMP() { return 0; }
+    uint8_t temp = fetchedData >> 1;
 
-uint8_t NES6502::JSR() { return 0; }
+    // Status registers update
+    RecordC(fetchedData & 0x01); // Bit 0 is shifted out into the carry
+    RecordNZ(temp);
+
+    if constexpr (mode == AddrMode::IMP) { // Operates on the accumulator
+        a = temp;
+    } else {
+        DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+        WriteRam(addr_abs, temp);
+    }
 
-uint8_t NES6502::LDA() { return 0; }
+    return 0;
+}
 
-uint8_t NES6502::LDX() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::NOP() { return 0; }
 
-uint8_t NES6502::LDY() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::ORA() {
+    FetchData<mode>();
 
-uint8_t NES6502::LSR() { return 0; }
+    // OR logical operation
+    a |= fetchedData;
 
-uint8_t NES6502::NOP() { return 0; }
+    RecordNZ(a);
 
-uint8_t NES6502::ORA() { return 0; }
+    return 1;
+}
 
-uint8_t NES6502::PHA() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::PHA() {
     WriteRam(0x0100 + stkp, a); // 0x0100 is the hard coded base stack address
 
     stkp--;
@@ -439,114 +721,236 @@ uint8_t NES6502::PHA() {
     return 0;
 }
 
-uint8_t NES6502::PHP() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::PHP() {
+    // The status register is pushed with the break and unused flags set
+    WriteRam(0x0100 + stkp--, GetStatus() | B | U); // 0x0100 is the hard coded base stack address
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::PLA() {
+    DummyRead(0x0100 + stkp); // Internal cycle, incrementing the stack pointer
 
-uint8_t NES6502::PLA() {
     a = ReadRam(0x0100 + ++stkp); // 0x0100 is the hard coded base stack address
 
-    SetFlag(Z, a == 0);
-    SetFlag(N, a & 0x0080);
+    RecordNZ(a);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::PLP() {
+    DummyRead(0x0100 + stkp); // Internal cycle, incrementing the stack pointer
+
+    SetStatus(ReadRam(0x0100 + ++stkp)); // 0x0100 is the hard coded base stack address
+
+    SetFlag(U, true);
+    SetFlag(B, false);
+    CheckIrqUnmasked();
+
+    return 0;
+}
+
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::ROL() {
+    FetchData<mode>();
+
+    uint8_t temp = (fetchedData << 1) | GetFlag(C);
+
+    // Status registers update
+    RecordC(fetchedData >> 7); // Bit 7 is rotated out into the carry
+    RecordNZ(temp);
+
+    if constexpr (mode == AddrMode::IMP) { // Operates on the accumulator
+        a = temp;
+    } else {
+        DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+        WriteRam(addr_abs, temp);
+    }
 
     return 0;
 }
 
-uint8_t NES6502::PLP() { return 0; }
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::ROR() {
+    FetchData<mode>();
 
-uint8_t NES6502::ROL() { return 0; }
+    uint8_t temp = (GetFlag(C) << 7) | (fetchedData >> 1);
 
-uint8_t NES6502::ROR() { return 0; }
+    // Status registers update
+    RecordC(fetchedData & 0x01); // Bit 0 is rotated out into the carry
+    RecordNZ(temp);
+
+    if constexpr (mode == AddrMode::IMP) { // Operates on the accumulator
+        a = temp;
+    } else {
+        DummyWrite(addr_abs, fetchedData); // The unmodified value is written back first
+        WriteRam(addr_abs, temp);
+    }
+
+    return 0;
+}
 
-uint8_t NES6502::RTI() {
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::RTI() {
     // Return when the program has serviced the interrupt
     // This instruction restores the CPU to its
     // previous state before the interrupt
 
-    status = ReadRam(0x0100 + ++stkp);
+    DummyRead(0x0100 + stkp); // Internal cycle, incrementing the stack pointer
+
+    SetStatus(ReadRam(0x0100 + ++stkp));
     status &= ~B;
     status &= ~U;
 
     pc = (uint16_t)ReadRam(0x0100 + ++stkp);
     pc |= (uint16_t)ReadRam(0x0100 + ++stkp) << 8;
 
+    CheckIrqUnmasked();
+
     return 0;
 }
 
-uint8_t NES6502::RTS() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::RTS() {
+    DummyRead(0x0100 + stkp); // Internal cycle, incrementing the stack pointer
 
-uint8_t NES6502::SBC() {
-    FetchData();
+    pc = (uint16_t)ReadRam(0x0100 + ++stkp); // 0x0100 is the hard coded base stack address
+    pc |= (uint16_t)ReadRam(0x0100 + ++stkp) << 8;
+
+    DummyRead(pc); // Internal cycle, incrementing the program counter
+    pc++;          // JSR pushed the address of its last byte
+
+    return 0;
+}
+
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::SBC() {
+    FetchData<mode>();
 
     uint16_t inv = (uint16_t)fetchedData ^ 0x00FF; // Inversion for two's complement
 
     uint16_t temp = (uint16_t)(a + inv + GetFlag(C));
 
     // Status registers update
-    SetFlag(C, temp & 0xFF00);
-    SetFlag(Z, (temp & 0x00FF) == 0);
-    SetFlag(N, temp & 0x0080);
-    SetFlag(V, (temp ^ (uint16_t)a) & (temp ^ inv) & 0x0080);
+    RecordC((temp & 0xFF00) != 0);
+    RecordNZ(temp & 0x00FF);
+    RecordV(a, inv, temp);
 
     a = temp & 0x00FF;
 
     return 1;
 }
 
-uint8_t NES6502::SEC() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::SEC() {
+    SetFlag(C, true);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::SED() {
+    SetFlag(D, true);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::SEI() {
+    SetFlag(I, true);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::STA() {
+    WriteRam(addr_abs, a);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::STX() {
+    WriteRam(addr_abs, x);
 
-uint8_t NES6502::SED() { return 0; }
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::STY() {
+    WriteRam(addr_abs, y);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TAX() {
+    x = a;
+
+    RecordNZ(x);
+
+    return 0;
+}
+
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TAY() {
+    y = a;
+
+    RecordNZ(y);
+
+    return 0;
+}
 
-uint8_t NES6502::SEI() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TSX() {
+    x = stkp;
 
-uint8_t NES6502::STA() { return 0; }
+    RecordNZ(x);
 
-uint8_t NES6502::STX() { return 0; }
+    return 0;
+}
 
-uint8_t NES6502::STY() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TXA() {
+    a = x;
 
-uint8_t NES6502::TAX() { return 0; }
+    RecordNZ(a);
+
+    return 0;
+}
 
-uint8_t NES6502::TAY() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TXS() {
+    stkp = x;
 
-uint8_t NES6502::TSX() { return 0; }
+    return 0;
+}
 
-uint8_t NES6502::TXA() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::TYA() {
+    a = y;
 
-uint8_t NES6502::TXS() { return 0; }
+    RecordNZ(a);
 
-uint8_t NES6502::TYA() { return 0; }
+    return 0;
+}
 
-uint8_t NES6502::XXX() { return 0; }
+template <typename BusType, typename Policy> uint8_t NES6502<BusType, Policy>::XXX() { return 0; }
 
 // CPU signals
 
-void NES6502::Clock() {
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::Clock() {
     if (cycles == 0) // i.e. no running instructions' cycles left
     {
         // Reading next instruction and incrementing the program counter
         opcode = ReadRam(pc++);
 
-        // Setting required cycles for the current instruction
-        cycles = instructionSetLookup[opcode].cycles;
-
-        // Address mode and instruction calls
-        uint8_t additional_cycle1 = (this->*instructionSetLookup[opcode].addrMode)();
-        uint8_t additional_cycle2 = (this->*instructionSetLookup[opcode].instruction)();
-
-        // Additional cycle if addrMode and (&) instruction both return 1
-        cycles += additional_cycle1 & additional_cycle2;
+        // Address mode and instruction calls, fused into a single handler
+        Dispatch(opcode);
+        busCycles = 0;
     }
 
     cycles--;
+    clockCount++;
 }
 
-void NES6502::Reset() {
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::Reset() {
     // CPU reset to default known condition
 
     a = 0;
     x = 0;
     y = 0;
     stkp = 0xFD;    // 0xFD is ?
-    status = 0 | U; // = U ?
+    SetStatus(0 | U); // = U ?
 
     addr_abs = 0xFFFC; // 0xFFFC is the hard coded address containing the
                        // address to reset the program counter in this case
@@ -561,20 +965,23 @@ void NES6502::Reset() {
     fetchedData = 0;
 
     cycles = 8; // Hard coded clock cycles for this reset signal
+    busCycles = 0;
 }
 
-void NES6502::IRQ() {
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::IRQ() {
     if (GetFlag(I) == 0) {
+        // Two internal cycles reading the next opcode, which is not executed
+        DummyRead(pc);
+        DummyRead(pc);
+
         WriteRam(0x0100 + stkp--,
                  (pc >> 8) & 0x00FF); // 0x0100 is the hard coded base stack address
         WriteRam(0x0100 + stkp--, pc & 0x00FF);
 
-        SetFlag(B, false);
-        SetFlag(U, true);
+        // The status register is pushed with the break flag clear, before interrupts are disabled
+        WriteRam(0x0100 + stkp--, (GetStatus() & ~B) | U);
         SetFlag(I, true);
 
-        WriteRam(0x0100 + stkp--, status);
-
         addr_abs = 0xFFFE; // 0xFFFE is the hard coded address containing the
                            // address to set the program counter in this case
 
@@ -584,20 +991,23 @@ void NES6502::IRQ() {
         pc = (hi << 8) | lo;
 
         cycles = 7; // Hard coded clock cycles for this interrupt request signal
+        busCycles = 0;
     }
 }
 
-void NES6502::NMI() {
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::NMI() {
+    // Two internal cycles reading the next opcode, which is not executed
+    DummyRead(pc);
+    DummyRead(pc);
+
     WriteRam(0x0100 + stkp--,
              (pc >> 8) & 0x00FF); // 0x0100 is the hard coded base stack address
     WriteRam(0x0100 + stkp--, pc & 0x00FF);
 
-    SetFlag(B, false);
-    SetFlag(U, true);
+    // The status register is pushed with the break flag clear, before interrupts are disabled
+    WriteRam(0x0100 + stkp--, (GetStatus() & ~B) | U);
     SetFlag(I, true);
 
-    WriteRam(0x0100 + stkp--, status);
-
     addr_abs = 0xFFFA; // 0xFFFA is the hard coded address containing the
                        // address to set the program counter in this case
 
@@ -606,18 +1016,536 @@ void NES6502::NMI() {
 
     pc = (hi << 8) | lo;
 
-    cycles = 8; // Hard coded clock cycles for this non-maskable interrupt request signal
+    cycles = 7; // Hard coded clock cycles for this non-maskable interrupt request signal
+    busCycles = 0;
+}
+
+// Batch execution
+
+template <typename BusType, typename Policy>
+uint64_t NES6502<BusType, Policy>::RunCycles(uint64_t budget) {
+    return RunUntil(clockCount + budget);
+}
+
+template <typename BusType, typename Policy>
+uint64_t NES6502<BusType, Policy>::RunUntil(uint64_t targetCycle) {
+    // Instructions are executed as a whole, their cycles being accounted for at once
+    // instead of being counted down one Clock() call at a time
+
+    // Remaining cycles of an instruction (or signal) started beforehand
+    clockCount += cycles;
+    cycles = 0;
+
+    // Kept in a member, so that events scheduled during the run can end it earlier
+    runTarget = targetCycle;
+
+    // Idle loops are only skipped after an iteration of the same run, no event in between
+    idleLoopPass.clockCount = UINT64_MAX;
+
+    while (clockCount < runTarget) {
+        // Decoded blocks skip the opcode and operand fetches, which are bus cycles of their own
+        // with the cycle-accurate policy
+        const DecodedBlock *block = nullptr;
+        if constexpr (BusType::CACHES_CODE && !Policy::CYCLE_ACCURATE)
+            block = FindBlock(pc);
+
+        if (block) {
+            // Pre-decoded instructions, then the blocks following them, as long as they are found
+            RunBlocks(block);
+        } else {
+            // Reading next instruction and incrementing the program counter
+            opcode = ReadRam(pc++);
+
+            // Address mode and instruction calls, setting the instruction's cycles
+            Dispatch(opcode);
+
+            clockCount += cycles;
+            cycles = 0;
+            busCycles = 0;
+        }
+    }
+
+    return clockCount - runTarget; // Overshoot, to be deducted from the next budget
+}
+
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::RunInstruction() {
+    // Same as one iteration of RunUntil, without touching the run target
+    clockCount += cycles;
+    cycles = 0;
+
+    const DecodedBlock *block = nullptr;
+    if constexpr (BusType::CACHES_CODE && !Policy::CYCLE_ACCURATE)
+        block = FindBlock(pc);
+
+    if (block) {
+        DispatchDecoded(block->instructions[0]);
+    } else {
+        opcode = ReadRam(pc++);
+        Dispatch(opcode);
+        busCycles = 0;
+    }
+
+    clockCount += cycles;
+    cycles = 0;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::SaveRegisters(Registers &registers) const {
+    registers.clockCount = clockCount + cycles;
+    registers.pc = pc;
+    registers.lazyNZ = lazyNZ;
+    registers.a = a;
+    registers.x = x;
+    registers.y = y;
+    registers.stkp = stkp;
+    registers.lazyC = lazyC;
+    registers.lazyV1 = lazyV1;
+    registers.lazyV2 = lazyV2;
+    registers.lazyVResult = lazyVResult;
+    registers.status = status;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::LoadRegisters(const Registers &registers) {
+    clockCount = registers.clockCount;
+    cycles = 0;
+    pc = registers.pc;
+    lazyNZ = registers.lazyNZ;
+    a = registers.a;
+    x = registers.x;
+    y = registers.y;
+    stkp = registers.stkp;
+    lazyC = registers.lazyC;
+    lazyV1 = registers.lazyV1;
+    lazyV2 = registers.lazyV2;
+    lazyVResult = registers.lazyVResult;
+    status = registers.status;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::SaveState(State &state) const {
+    SaveRegisters(state.registers);
+    state.operand = operand;
+    state.addr_abs = addr_abs;
+    state.addr_rel = addr_rel;
+    state.fetchedData = fetchedData;
+    state.opcode = opcode;
+    state.irqLine = irqLine;
+    state.idleCycleCount = idleCycleCount;
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::LoadState(const State &state) {
+    LoadRegisters(state.registers);
+    operand = state.operand;
+    addr_abs = state.addr_abs;
+    addr_rel = state.addr_rel;
+    fetchedData = state.fetchedData;
+    opcode = state.opcode;
+    irqLine = state.irqLine;
+    idleCycleCount = state.idleCycleCount;
+    busCycles = 0;
+
+    // The idle loop seen last is gone with the state it ran in
+    idleLoopPass.clockCount = UINT64_MAX;
+}
+
+template <typename BusType, typename Policy>
+bool NES6502<BusType, Policy>::MatchesState(NES6502 &other) {
+    if (clockCount + cycles != other.clockCount + other.cycles || pc != other.pc ||
+        a != other.a || x != other.x || y != other.y || stkp != other.stkp ||
+        GetStatus() != other.GetStatus())
+        return false;
+
+    for (unsigned int page = 0; page < 256; page++) {
+        const uint8_t *memory = bus->GetCodePage(page);
+        const uint8_t *otherMemory = other.bus->GetCodePage(page);
+
+        if ((memory == nullptr) != (otherMemory == nullptr) ||
+            (memory && std::memcmp(memory, otherMemory, 256) != 0))
+            return false;
+    }
+
+    return true;
+}
+
+// Idle loops
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::SkipIdleLoop(const DecodedBlock &block, uint64_t iterationStart) {
+    Registers registers;
+    SaveRegisters(registers);
+
+    // Same registers as at the start of the iteration, lazily evaluated flags included
+    const Registers &pass = idleLoopPass;
+    bool repeated = pass.clockCount == iterationStart && pass.pc == registers.pc &&
+                    pass.lazyNZ == registers.lazyNZ && pass.a == registers.a &&
+                    pass.x == registers.x && pass.y == registers.y &&
+                    pass.stkp == registers.stkp && pass.lazyC == registers.lazyC &&
+                    pass.lazyV1 == registers.lazyV1 && pass.lazyV2 == registers.lazyV2 &&
+                    pass.lazyVResult == registers.lazyVResult && pass.status == registers.status;
+    idleLoopPass = registers;
+    if (!repeated)
+        return;
+
+    // Reads from host memory, which only the CPU changes, or of I/O registers repeating the
+    // last ones up to a given cycle
+    uint64_t skipEnd = runTarget;
+    bool polling = false;
+    for (uint8_t i = 0; i + 1 < block.length; i++) {
+        const DecodedInstruction &instruction = block.instructions[i];
+        uint16_t addr = instruction.operand;
+
+        switch (instructionSetLookup[instruction.opcode].addrMode) {
+        case am::IMP:
+        case am::IMM:
+            continue;
+        case am::ZP0:
+            addr &= 0x00FF;
+            break;
+        case am::ZPX:
+            addr = (addr + x) & 0x00FF;
+            break;
+        case am::ZPY:
+            addr = (addr + y) & 0x00FF;
+            break;
+        case am::ABX:
+            addr += x;
+            break;
+        case am::ABY:
+            addr += y;
+            break;
+        default:
+            break;
+        }
+
+        if (!bus->GetCodePage(addr >> 8)) {
+            skipEnd = std::min(skipEnd, bus->GetRepeatableReadEnd(addr));
+            polling = true;
+        }
+    }
+
+    // Only polling for the flag it keeps, the other bits being of no use to the loop (e.g.
+    // LDA $2002 / BPL, waiting for the vertical blank)
+    if (polling) {
+        Operation read = instructionSetLookup[block.instructions[0].opcode].operation;
+        Operation branch = instructionSetLookup[block.instructions[1].opcode].operation;
+
+        if (block.length != 2 ||
+            (read != is::LDA && read != is::LDX && read != is::LDY && read != is::BIT) ||
+            (branch != is::BPL && branch != is::BMI))
+            return;
+    }
+
+    if (clockCount >= skipEnd)
+        return;
+
+    // Whole iterations only, the last one before the end being run: when polling, its reads
+    // leave the registers as they would have been, whatever the ones skipped returned
+    uint64_t period = clockCount - iterationStart;
+    uint64_t skipped = (skipEnd - clockCount) / period * period;
+    clockCount += skipped;
+    idleCycleCount += skipped;
+    idleLoopPass.clockCount = clockCount;
+}
+
+// Decoded block cache
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::InvalidateCodePage(uint8_t page) {
+    codeGeneration++;
+
+    if (blockCache)
+        blockCache->pageGenerations[page]++;
+}
+
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::InvalidateCode() {
+    codeGeneration++;
+
+    if (blockCache)
+        for (uint32_t &generation : blockCache->pageGenerations)
+            generation++;
+}
+
+template <typename BusType, typename Policy>
+const typename NES6502<BusType, Policy>::DecodedBlock *
+NES6502<BusType, Policy>::FindBlock(uint16_t addr) {
+    if (!blockCache)
+        blockCache = std::make_unique<BlockCache>(); // Zero-initialized, i.e. empty slots
+
+    DecodedBlock &block = blockCache->blocks[(addr ^ (addr >> 9)) & (BLOCK_CACHE_SIZE - 1)];
+
+    // Hit if the slot holds this block and none of its pages changed since it was decoded
+    if (block.length != 0 && block.startPc == addr &&
+        block.firstPageGeneration == blockCache->pageGenerations[block.firstPage] &&
+        block.lastPageGeneration == blockCache->pageGenerations[block.lastPage])
+        return &block;
+
+    if (DecodeBlock(addr, block))
+        return &block;
+
+    return nullptr;
+}
+
+template <typename BusType, typename Policy>
+bool NES6502<BusType, Policy>::DecodeBlock(uint16_t addr, DecodedBlock &block) {
+    // Instructions are read from the host memory backing the pages, without any bus access.
+    // A block covers at most two consecutive pages, both watched by the bus for changes.
+
+    block.startPc = addr;
+    block.length = 0;
+    block.firstPage = block.lastPage = addr >> 8;
+
+    auto readCode = [&](uint16_t codeAddr, uint8_t &data) {
+        uint8_t page = codeAddr >> 8;
+        if (page != block.firstPage && page != (uint8_t)(block.firstPage + 1))
+            return false;
+
+        const uint8_t *memory = bus->GetCodePage(page);
+        if (!memory)
+            return false;
+
+        data = memory[codeAddr & 0x00FF];
+        return true;
+    };
+
+    while (block.length < MAX_BLOCK_INSTRUCTIONS) {
+        uint8_t op, lo = 0, hi = 0;
+        if (!readCode(addr, op))
+            break;
+
+        const Instruction &instruction = instructionSetLookup[op];
+        uint8_t length = operandLengthLookup[(uint8_t)instruction.addrMode];
+
+        if ((length >= 1 && !readCode(addr + 1, lo)) || (length == 2 && !readCode(addr + 2, hi)))
+            break;
+
+        block.instructions[block.length++] = {(uint16_t)((hi << 8) | lo), op};
+        block.lastPage = (addr + length) >> 8;
+        addr += 1 + length;
+
+        if (EndsBasicBlock(instruction.operation))
+            break;
+    }
+
+    if (block.length == 0)
+        return false;
+
+    // Idle loop candidate: read-only instructions, then a branch or jump back to the start
+    const DecodedInstruction &last = block.instructions[block.length - 1];
+    const Instruction &lastInstruction = instructionSetLookup[last.opcode];
+    uint16_t target = addr; // Never the start, blocks not being empty
+    if (lastInstruction.addrMode == am::REL)
+        target = addr + (int8_t)last.operand;
+    else if (lastInstruction.operation == is::JMP && lastInstruction.addrMode == am::ABS)
+        target = last.operand;
+
+    block.idleLoop = target == block.startPc;
+    for (uint8_t i = 0; i + 1 < block.length; i++) {
+        const Instruction &instruction = instructionSetLookup[block.instructions[i].opcode];
+        bool indirect = instruction.addrMode >= am::IND; // Pointers read from memory as well
+
+        block.idleLoop &= IsReadOnly(instruction.operation) && !indirect;
+    }
+
+    bus->WatchCodePage(block.firstPage);
+    bus->WatchCodePage(block.lastPage);
+
+    block.firstPageGeneration = blockCache->pageGenerations[block.firstPage];
+    block.lastPageGeneration = blockCache->pageGenerations[block.lastPage];
+
+    return true;
 }
 
 // Internal emulation helpers
 
-uint8_t NES6502::FetchData() {
+template <typename BusType, typename Policy>
+template <NES6502Base::AddrMode mode>
+uint8_t NES6502<BusType, Policy>::FetchData() {
     // Data fetching from all address mode instructions except implied address mode
     // (operand is implicit in the instruction, nothing to fetch)
+    // Resolved at compile time, since every handler is specialized for its address mode
 
-    if (instructionSetLookup[opcode].addrMode != &NES6502::IMP)
+    if constexpr (mode == AddrMode::IMM) // The data is the operand itself
+        fetchedData = operand;
+    else if constexpr (mode != AddrMode::IMP)
         fetchedData = ReadRam(addr_abs);
 
     return fetchedData; // In case, for any other function's use as argument or variable as
                         // value
 }
+
+template <typename BusType, typename Policy>
+template <uint8_t op>
+void NES6502<BusType, Policy>::Execute() {
+    constexpr uint8_t length = operandLengthLookup[(uint8_t)instructionSetLookup[op].addrMode];
+
+    // Operand bytes following the opcode
+    if constexpr (length == 1) {
+        operand = ReadRam(pc++);
+    } else if constexpr (Policy::CYCLE_ACCURATE && instructionSetLookup[op].operation == is::JSR) {
+        operand = ReadRam(pc++); // High byte read last (see JSR)
+    } else if constexpr (length == 2) {
+        operand = ReadRam(pc++);
+        operand |= ReadRam(pc++) << 8;
+    }
+
+    Run<op>();
+}
+
+template <typename BusType, typename Policy>
+template <uint8_t op>
+void NES6502<BusType, Policy>::ExecuteDecoded(uint16_t decodedOperand) {
+    constexpr uint8_t length = operandLengthLookup[(uint8_t)instructionSetLookup[op].addrMode];
+
+    // Opcode and operand bytes were already fetched when the block was decoded
+    operand = decodedOperand;
+    pc += 1 + length;
+
+    Run<op>();
+}
+
+template <typename BusType, typename Policy>
+template <uint8_t op>
+void NES6502<BusType, Policy>::Run() {
+    // Everything about the opcode is known at compile time, so both handler calls below are
+    // direct (and inlinable) calls rather than pointer-to-member indirections
+
+    constexpr Instruction instruction = instructionSetLookup[op];
+    constexpr auto addrMode = addrModeHandlers<BusType, Policy>[(uint8_t)instruction.addrMode];
+    constexpr auto operation =
+        operationHandlers<BusType, Policy, instruction.addrMode>[(uint8_t)instruction.operation];
+
+    // Setting required cycles for the current instruction
+    cycles = instruction.cycles;
+
+    // Address mode and instruction calls
+    uint8_t additional_cycle = (this->*addrMode)();
+
+    // Indexed accesses read the address before its high byte is fixed, on page crossings and
+    // always for the instructions not affected by them (stores, read-modify-writes)
+    constexpr bool indexed = instruction.addrMode == AddrMode::ABX ||
+                             instruction.addrMode == AddrMode::ABY ||
+                             instruction.addrMode == AddrMode::IZY;
+    if constexpr (Policy::CYCLE_ACCURATE && indexed) {
+        uint8_t index = instruction.addrMode == AddrMode::ABX ? x : y;
+        if (additional_cycle || !instruction.pageCross)
+            DummyRead(((addr_abs - index) & 0xFF00) | (addr_abs & 0x00FF));
+    }
+
+    (this->*operation)();
+
+    // Additional cycle if addrMode crossed a page, for instructions affected by it only
+    if constexpr (instruction.pageCross)
+        cycles += additional_cycle;
+}
+
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::TakeBranch() {
+    cycles++; // Necessary additional clock cycle
+
+    DummyRead(pc); // Next opcode read while the offset is added
+
+    addr_abs = pc + addr_rel; // Absolute address update
+
+    // If the page boundary has been crossed...
+    if ((addr_abs & 0xFF00) != (pc & 0xFF00)) {
+        cycles++; // Another additional clock cycle
+        // (see R650X datasheet, "Instruction set summary" table)
+
+        DummyRead((pc & 0xFF00) | (addr_abs & 0x00FF)); // Read before the high byte is fixed
+    }
+
+    pc = addr_abs; // Program counter update
+}
+
+// Every opcode, as a literal (0x00 - 0xFF) that also pastes into labels
+#define OPCODE_ROW(m, hi)                                                                        \
+    m(hi##0) m(hi##1) m(hi##2) m(hi##3) m(hi##4) m(hi##5) m(hi##6) m(hi##7) m(hi##8) m(hi##9)    \
+        m(hi##A) m(hi##B) m(hi##C) m(hi##D) m(hi##E) m(hi##F)
+#define OPCODE_LIST(m)                                                                           \
+    OPCODE_ROW(m, 0x0) OPCODE_ROW(m, 0x1) OPCODE_ROW(m, 0x2) OPCODE_ROW(m, 0x3)                  \
+    OPCODE_ROW(m, 0x4) OPCODE_ROW(m, 0x5) OPCODE_ROW(m, 0x6) OPCODE_ROW(m, 0x7)                  \
+    OPCODE_ROW(m, 0x8) OPCODE_ROW(m, 0x9) OPCODE_ROW(m, 0xA) OPCODE_ROW(m, 0xB)                  \
+    OPCODE_ROW(m, 0xC) OPCODE_ROW(m, 0xD) OPCODE_ROW(m, 0xE) OPCODE_ROW(m, 0xF)
+
+// One switch case per opcode, each one running its own fused handler
+template <typename BusType, typename Policy> void NES6502<BusType, Policy>::Dispatch(uint8_t op) {
+#define EXECUTE(op)                                                                              \
+    case op:                                                                                     \
+        Execute<op>();                                                                           \
+        break;
+    switch (op) { OPCODE_LIST(EXECUTE) }
+#undef EXECUTE
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::DispatchDecoded(const DecodedInstruction &instruction) {
+    opcode = instruction.opcode;
+
+#define EXECUTE_DECODED(op)                                                                      \
+    case op:                                                                                     \
+        ExecuteDecoded<op>(instruction.operand);                                                 \
+        break;
+    switch (instruction.opcode) { OPCODE_LIST(EXECUTE_DECODED) }
+#undef EXECUTE_DECODED
+}
+
+template <typename BusType, typename Policy>
+void NES6502<BusType, Policy>::RunBlocks(const DecodedBlock *block) {
+#if NES6502_THREADED
+    // One label per opcode, each one running its own fused handler then jumping to the next
+#define HANDLER_ADDRESS(op) &&execute_##op,
+    static const void *const handlers[256] = {OPCODE_LIST(HANDLER_ADDRESS)};
+#undef HANDLER_ADDRESS
+#endif
+
+    do {
+        // Pre-decoded instructions, as long as the block does not modify its own code
+        const DecodedInstruction *instruction = block->instructions;
+        const DecodedInstruction *end = instruction + block->length;
+        uint32_t generation = codeGeneration;
+        uint64_t blockStart = clockCount;
+
+#if NES6502_THREADED
+        goto *handlers[instruction->opcode];
+
+#define EXECUTE_THREADED(op)                                                                     \
+    execute_##op : opcode = op;                                                                  \
+    ExecuteDecoded<op>(instruction->operand);                                                    \
+    clockCount += cycles;                                                                        \
+    cycles = 0;                                                                                  \
+    if (++instruction == end || clockCount >= runTarget ||                                       \
+        (WritesMemory(instructionSetLookup[op]) && codeGeneration != generation))                \
+        goto blockEnd;                                                                           \
+    goto *handlers[instruction->opcode];
+        OPCODE_LIST(EXECUTE_THREADED)
+#undef EXECUTE_THREADED
+
+    blockEnd:
+#else
+        for (; instruction != end && clockCount < runTarget; instruction++) {
+            DispatchDecoded(*instruction);
+
+            clockCount += cycles;
+            cycles = 0;
+
+            if (codeGeneration != generation)
+                break;
+        }
+#endif
+
+        if (block->idleLoop && pc == block->startPc && idleLoopSkipping)
+            SkipIdleLoop(*block, blockStart);
+    } while (clockCount < runTarget && (block = FindBlock(pc)));
+}
+
+#undef OPCODE_LIST
+#undef OPCODE_ROW
+
+// Supported bus types, each of them with the policy of its CPU
+template class NES6502<Bus>;
+template class NES6502<CycleAccurateBus, CycleAccurate>;
+template class NES6502<FlatBus>;
+template class NES6502<CycleAccurateFlatBus, CycleAccurate>;
+template class NES6502<TracingBus>;
+template class NES6502<CycleAccurateTracingBus, CycleAccurate>;
@@ -0,0 +1,116 @@
+#include "../include/NES6502Aot.h"
+
+/*
+
+Ahead-of-time translation
+
+The static recompiler (tools/recompile.cpp) walks the program of a cartridge from its vectors
+and emits a C++ function per routine, each instruction becoming a labeled block of code, and
+each jump or branch within the routine a goto. The instructions it cannot resolve statically
+are left to the interpreter:
+
+ - accesses to pages without host memory (I/O registers), checked at run time since their
+   addresses may be indexed, so that they happen at their exact cycle
+ - BRK, RTI, PHP, PLP and JMP (indirect), along with the unofficial opcodes
+
+The engine below dispatches on the program counter: the routine translating its address runs
+until it leaves itself (JSR, RTS, jumps to other routines) or reaches the target cycle, and
+the addresses without a translation (RAM, code not found statically) go through the interpreter
+one instruction at a time. The program space is watched like code decoded by the CPU, so that
+writes to it are left to the interpreter too, after which the translation is only used again
+if the program space still matches it. Runs are driven by the bus's event loop like the CPU's
+own (see BasicBus::RunUntil), so routines check the target cycle before every instruction, for
+events to be dispatched at their exact cycle, and CLI is left to the interpreter, which ends the
+run when it unmasks a pending interrupt.
+
+*/
+
+NES6502Aot::NES6502Aot(Bus *_bus, const AotProgram &_program)
+    : bus(_bus), cpu(_bus->GetCpu()), program(_program), routines(), referenceBus(nullptr),
+      diverged(false), divergencePc(0), routineRunCount(0), interpretedInstructionCount(0) {
+    for (uint32_t i = 0; i < program.entryCount; i++) {
+        const AotEntry &entry = program.entries[i];
+        if (entry.pc >= PROGRAM_SPACE_START)
+            routines[entry.pc - PROGRAM_SPACE_START] = entry.routine;
+    }
+
+    CheckProgramSpace();
+}
+
+bool NES6502Aot::MatchesProgramSpace() const {
+    uint8_t programSpace[PROGRAM_SPACE_SIZE];
+    for (size_t i = 0; i < PROGRAM_SPACE_SIZE; i++)
+        programSpace[i] = bus->ReadRam(PROGRAM_SPACE_START + i, true);
+
+    return HashProgramSpace(programSpace, PROGRAM_SPACE_SIZE) == program.programHash;
+}
+
+void NES6502Aot::CheckProgramSpace() {
+    // Writes to watched pages leave the translated code, then release the watch once done by
+    // the interpreter, which invalidates the CPU's code (hence codeGeneration)
+    for (unsigned int page = PROGRAM_SPACE_START >> 8; page < Bus::PAGE_COUNT; page++)
+        if (bus->GetCodePage(page))
+            bus->WatchCodePage(page);
+
+    translationUsable = MatchesProgramSpace();
+    codeGeneration = cpu.GetCodeGeneration();
+}
+
+// Batch execution
+
+uint64_t NES6502Aot::RunCycles(uint64_t budget) {
+    return RunUntil(cpu.GetCycleCount() + budget);
+}
+
+uint64_t NES6502Aot::RunUntil(uint64_t targetCycle) {
+    NES6502Base::Registers registers;
+    cpu.SaveRegisters(registers);
+    cpu.BeginRun(targetCycle);
+
+    while (registers.clockCount < cpu.GetRunTarget() && !diverged) {
+        uint16_t routinePc = registers.pc;
+        AotRoutine routine = translationUsable && routinePc >= PROGRAM_SPACE_START
+                                 ? routines[routinePc - PROGRAM_SPACE_START]
+                                 : nullptr;
+
+        bool interpret = true;
+        if (routine) {
+            interpret = routine(*bus, registers, cpu.GetRunTarget());
+            routineRunCount++;
+        }
+
+        if (interpret && registers.clockCount < cpu.GetRunTarget()) {
+            // One instruction through the interpreter, then back to the translation
+            cpu.LoadRegisters(registers);
+            cpu.RunInstruction();
+            cpu.SaveRegisters(registers);
+            interpretedInstructionCount++;
+
+            // Code modified or remapped, possibly in the program space
+            if (cpu.GetCodeGeneration() != codeGeneration)
+                CheckProgramSpace();
+        }
+
+        if (referenceBus) {
+            cpu.LoadRegisters(registers);
+            CheckReference(routinePc);
+        }
+    }
+
+    cpu.LoadRegisters(registers);
+    return registers.clockCount - cpu.GetRunTarget();
+}
+
+// Differential mode
+
+void NES6502Aot::EnableDifferential(Bus *_referenceBus) { referenceBus = _referenceBus; }
+
+void NES6502Aot::CheckReference(uint16_t routinePc) {
+    NES6502<Bus> &reference = referenceBus->GetCpu();
+    referenceBus->RunUntil(cpu.GetCycleCount());
+
+    if (!cpu.MatchesState(reference)) {
+        diverged = true;
+        divergencePc = routinePc;
+    }
+}
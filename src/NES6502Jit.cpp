@@ -0,0 +1,922 @@
+#include "../include/NES6502Jit.h"
+#include "../include/Bus.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#if NES6502JIT_NATIVE
+#include <sys/mman.h>
+#endif
+
+// Executable arena
+
+JitArena::JitArena(size_t _size) : memory(nullptr), size(0), used(0) {
+#if NES6502JIT_NATIVE
+    void *mapping = mmap(nullptr, _size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    // Systems enforcing W^X refuse such mappings, everything is interpreted then
+    if (mapping != MAP_FAILED) {
+        memory = (uint8_t *)mapping;
+        size = _size;
+    }
+#endif
+}
+
+JitArena::~JitArena() {
+#if NES6502JIT_NATIVE
+    if (memory)
+        munmap(memory, size);
+#endif
+}
+
+// x86-64 code emission
+
+namespace {
+
+enum Reg : int { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11 };
+
+// Condition codes, as encoded in Jcc and SETcc
+enum Cond : uint8_t { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5 };
+
+// Extensions of the 0x80/0x81 group 1 opcodes
+enum AluOp : uint8_t { ALU_ADD, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+// [base + index * scale + disp] memory operand
+struct Mem {
+    int base;
+    int index;
+    uint8_t scale;
+    int32_t disp;
+};
+
+Mem At(int base, int32_t disp) { return {base, -1, 1, disp}; }
+Mem At(int base, int index, uint8_t scale) { return {base, index, scale, 0}; }
+
+// Minimal emitter, covering the few instruction forms the block compiler needs.
+// Operands are 32-bit unless stated otherwise, 8-bit register operands always get a REX prefix
+// so that sil, dil, bpl and r8b-r11b are addressable.
+class X64Emitter {
+public:
+    X64Emitter(uint8_t *_code, size_t _capacity) : code(_code), capacity(_capacity), size(0) {}
+
+    size_t GetSize() const { return size; }
+    bool Overflowed() const { return size > capacity; }
+
+    void Byte(uint8_t value) {
+        if (size < capacity)
+            code[size] = value;
+        size++;
+    }
+
+    void Word(uint16_t value) {
+        Byte(value);
+        Byte(value >> 8);
+    }
+
+    void Dword(uint32_t value) {
+        Word(value);
+        Word(value >> 16);
+    }
+
+    // Instruction forms
+
+    void MovRR(int dst, int src) { OpRR({0x89}, src, dst); }
+    void MovRI(int dst, uint32_t imm) {
+        Rex(false, 0, -1, dst, false);
+        Byte(0xB8 + (dst & 7));
+        Dword(imm);
+    }
+    void MovzxRM8(int dst, Mem m) { OpRM({0x0F, 0xB6}, dst, m); }
+    void MovzxRM16(int dst, Mem m) { OpRM({0x0F, 0xB7}, dst, m); }
+    void Mov64RM(int dst, Mem m) { OpRM({0x8B}, dst, m, true); }
+    void Store8(Mem m, int src) { OpRM({0x88}, src, m, false, true); }
+    void Store16(Mem m, int src) {
+        Byte(0x66);
+        OpRM({0x89}, src, m);
+    }
+    void Store8I(Mem m, uint8_t imm) {
+        OpRM({0xC6}, 0, m);
+        Byte(imm);
+    }
+    void Store16I(Mem m, uint16_t imm) {
+        Byte(0x66);
+        OpRM({0xC7}, 0, m);
+        Word(imm);
+    }
+
+    void AluRR(AluOp op, int dst, int src) { OpRR({(uint8_t)(op << 3 | 0x01)}, src, dst); }
+    void AluRI(AluOp op, int dst, uint32_t imm) {
+        OpRR({0x81}, op, dst);
+        Dword(imm);
+    }
+    void Alu8MI(AluOp op, Mem m, uint8_t imm) {
+        OpRM({0x80}, op, m);
+        Byte(imm);
+    }
+    void Alu8RM(AluOp op, int dst, Mem m) {
+        OpRM({(uint8_t)(op << 3 | 0x02)}, dst, m, false, true);
+    }
+    void Alu64MI(AluOp op, Mem m, uint32_t imm) {
+        OpRM({0x81}, op, m, true);
+        Dword(imm);
+    }
+    void Cmp64RM(int reg, Mem m) { OpRM({0x3B}, reg, m, true); }
+    void Cmp64RR(int a, int b) { OpRR({0x39}, b, a, true); }
+    void Test64RR(int a, int b) { OpRR({0x85}, b, a, true); }
+    void TestRI(int reg, uint32_t imm) {
+        OpRR({0xF7}, 0, reg);
+        Dword(imm);
+    }
+    void ShlRI(int reg, uint8_t imm) {
+        OpRR({0xC1}, 4, reg);
+        Byte(imm);
+    }
+    void ShrRI(int reg, uint8_t imm) {
+        OpRR({0xC1}, 5, reg);
+        Byte(imm);
+    }
+    void Setcc(Cond cond, int reg) { OpRR({0x0F, (uint8_t)(0x90 | cond)}, 0, reg, false, true); }
+
+    void Push(int reg) {
+        Rex(false, 0, -1, reg, false);
+        Byte(0x50 + (reg & 7));
+    }
+    void Pop(int reg) {
+        Rex(false, 0, -1, reg, false);
+        Byte(0x58 + (reg & 7));
+    }
+    void Ret() { Byte(0xC3); }
+
+    // Forward conditional jump, returns the position of its displacement to patch
+    size_t Jcc(Cond cond) {
+        Byte(0x0F);
+        Byte(0x80 | cond);
+        Dword(0);
+        return size - 4;
+    }
+
+    // Points the displacement at the given position to the current position
+    void Bind(size_t patch) {
+        uint32_t displacement = (uint32_t)(size - (patch + 4));
+        if (patch + 4 <= capacity)
+            std::memcpy(code + patch, &displacement, 4);
+    }
+
+private:
+    uint8_t *code;
+    size_t capacity;
+    size_t size; // May exceed the capacity, in which case the code is discarded
+
+    void Rex(bool w, int reg, int index, int base, bool force) {
+        uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1);
+        if (index >= 0)
+            rex |= ((index >> 3) & 1) << 1;
+        if (rex != 0x40 || force)
+            Byte(rex);
+    }
+
+    // reg, rm register operands (mod = 11)
+    void OpRR(std::initializer_list<uint8_t> opcode, int reg, int rm, bool w = false,
+              bool byteRegs = false) {
+        Rex(w, reg, -1, rm, byteRegs);
+        for (uint8_t byte : opcode)
+            Byte(byte);
+        Byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    // reg, memory operands, always with a 32-bit displacement (mod = 10)
+    void OpRM(std::initializer_list<uint8_t> opcode, int reg, Mem m, bool w = false,
+              bool byteRegs = false) {
+        Rex(w, reg, m.index, m.base, byteRegs);
+        for (uint8_t byte : opcode)
+            Byte(byte);
+
+        if (m.index < 0 && (m.base & 7) != RSP) {
+            Byte(0x80 | (reg & 7) << 3 | (m.base & 7));
+        } else {
+            uint8_t scale = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+            Byte(0x80 | (reg & 7) << 3 | RSP);
+            Byte(scale << 6 | ((m.index < 0 ? RSP : m.index) & 7) << 3 | (m.base & 7));
+        }
+        Dword(m.disp);
+    }
+};
+
+} // namespace
+
+template <typename BusType> NES6502Jit<BusType>::NES6502Jit(BusType *_bus)
+    : bus(_bus), cpu(_bus->GetCpu()), context(), arena(ARENA_SIZE), compiledBlocks() {
+    static_assert(BusType::CACHES_CODE, "the JIT compiles the CPU's decoded blocks");
+
+    arenaEpoch = 1; // Empty slots belong to epoch 0
+
+    referenceBus = nullptr;
+    diverged = false;
+    divergencePc = 0;
+
+    compiledBlockCount = 0;
+    nativeBlockCount = 0;
+    interpretedInstructionCount = 0;
+}
+
+// Batch execution
+
+template <typename BusType> uint64_t NES6502Jit<BusType>::RunCycles(uint64_t budget) {
+    return RunUntil(cpu.clockCount + budget);
+}
+
+template <typename BusType> uint64_t NES6502Jit<BusType>::RunUntil(uint64_t targetCycle) {
+    // The registers live in the context as long as native blocks follow each other, and are
+    // only copied back to the CPU when the interpreter takes over (remaining cycles of an
+    // instruction started beforehand included)
+    context.readPages = bus->GetReadPages();
+    context.writePages = bus->GetWritePages();
+    if constexpr (BusType::TRACKS_DIRTY_PAGES)
+        context.dirtyPages = bus->GetDirtyPages();
+    cpu.SaveRegisters(context.registers);
+    cpu.BeginRun(targetCycle);
+
+    while (context.registers.clockCount < cpu.GetRunTarget() && !diverged) {
+        const DecodedBlock *block = cpu.FindBlock(context.registers.pc);
+        BlockCode code = block ? FindCode(*block) : nullptr;
+
+        // Native blocks run as a whole, so those that may run past the end of the run are
+        // interpreted instead, up to it (the next event, see BasicBus::RunUntil)
+        if (code && context.registers.clockCount + block->length * MAX_INSTRUCTION_CYCLES >
+                        cpu.GetRunTarget())
+            code = nullptr;
+
+        uint32_t stop = 0;
+        if (code) {
+            stop = code(&context);
+            nativeBlockCount++;
+
+            if (stop == 0 && !referenceBus)
+                continue;
+        }
+
+        cpu.LoadRegisters(context.registers);
+
+        if (!block) {
+            // Code outside of host memory, one instruction at a time
+            cpu.RunInstruction();
+            interpretedInstructionCount++;
+        } else if (!code) {
+            Interpret(*block, 0, block->length);
+        } else if (stop != 0) {
+            // Instruction that left the native code
+            Interpret(*block, stop - 1, 1);
+        }
+
+        if (referenceBus)
+            CheckReference(block ? block->startPc : cpu.pc);
+
+        cpu.SaveRegisters(context.registers);
+    }
+
+    cpu.LoadRegisters(context.registers);
+
+    return cpu.clockCount - cpu.GetRunTarget();
+}
+
+template <typename BusType>
+typename NES6502Jit<BusType>::BlockCode NES6502Jit<BusType>::FindCode(const DecodedBlock &block) {
+    // The decoded block is up to date, so is its compiled counterpart if decoded from the same
+    // code (same start and page generations)
+    CompiledBlock &compiled = compiledBlocks[&block - cpu.blockCache->blocks];
+
+    if (compiled.startPc != block.startPc ||
+        compiled.firstPageGeneration != block.firstPageGeneration ||
+        compiled.lastPageGeneration != block.lastPageGeneration ||
+        compiled.arenaEpoch != arenaEpoch) {
+        compiled = {block.startPc, 0, block.firstPageGeneration, block.lastPageGeneration,
+                    arenaEpoch, nullptr};
+    }
+
+    if (!compiled.code && compiled.hits <= HOT_THRESHOLD && ++compiled.hits > HOT_THRESHOLD) {
+        if (arena.GetFreeSize() < MAX_BLOCK_CODE_SIZE) {
+            // Full arena, every block gets compiled again from scratch
+            arena.Clear();
+            arenaEpoch++;
+            compiled.arenaEpoch = arenaEpoch;
+        }
+
+        compiled.code = Compile(block);
+    }
+
+    return compiled.code;
+}
+
+template <typename BusType>
+void NES6502Jit<BusType>::Interpret(const DecodedBlock &block, unsigned int first,
+                                    unsigned int count) {
+    // Same as the CPU's own decoded block loop
+    uint32_t generation = cpu.codeGeneration;
+
+    for (unsigned int i = first; i < first + count && cpu.clockCount < cpu.runTarget; i++) {
+        cpu.DispatchDecoded(block.instructions[i]);
+
+        cpu.clockCount += cpu.cycles;
+        cpu.cycles = 0;
+        interpretedInstructionCount++;
+
+        if (cpu.codeGeneration != generation)
+            break;
+    }
+}
+
+// Block compilation
+
+// Native register allocation: the context pointer (first argument) stays in rdi, the 6502
+// registers and the most used lazy flags are pinned to host registers for the whole block
+static constexpr int CONTEXT = RDI;
+static constexpr int READ_PAGES = RSI;
+static constexpr int WRITE_PAGES = RBX; // Callee-saved, pushed
+static constexpr int REG_A = R8;
+static constexpr int REG_X = R9;
+static constexpr int REG_Y = R10;
+static constexpr int LAZY_NZ = R11;
+static constexpr int LAZY_C = RCX;
+static constexpr int SCRATCH = RBP; // Callee-saved, pushed
+// rax (page pointers) and rdx (page offsets, fetched data) are the other scratch registers
+
+template <typename BusType>
+typename NES6502Jit<BusType>::BlockCode NES6502Jit<BusType>::Compile(const DecodedBlock &block) {
+#if NES6502JIT_NATIVE
+    if (!arena.IsAvailable())
+        return nullptr;
+
+    using is = NES6502Base::Operation;
+    using am = NES6502Base::AddrMode;
+
+    X64Emitter emit(arena.GetTop(), MAX_BLOCK_CODE_SIZE);
+
+    auto field = [](size_t offset) { return At(CONTEXT, (int32_t)offset); };
+#define CONTEXT_FIELD(name)                                                                      \
+    field(offsetof(Context, registers) + offsetof(NES6502Base::Registers, name))
+
+    // Exits towards the interpreter, one per instruction accessing memory
+    struct Stub {
+        size_t patch;
+        unsigned int index; // Instruction left for the interpreter
+        uint16_t pc;
+        uint32_t cycles; // Static cycles of the instructions before it
+    };
+    Stub stubs[4 * Cpu::MAX_BLOCK_INSTRUCTIONS];
+    unsigned int stubCount = 0;
+
+    // Registers written back to the context, pc and clock updated, then return
+    auto emitExit = [&](uint32_t stop, int pcRegister, uint16_t pc, uint32_t cycles) {
+        emit.Store8(CONTEXT_FIELD(a), REG_A);
+        emit.Store8(CONTEXT_FIELD(x), REG_X);
+        emit.Store8(CONTEXT_FIELD(y), REG_Y);
+        emit.Store16(CONTEXT_FIELD(lazyNZ), LAZY_NZ);
+        emit.Store8(CONTEXT_FIELD(lazyC), LAZY_C);
+        if (pcRegister >= 0)
+            emit.Store16(CONTEXT_FIELD(pc), pcRegister);
+        else
+            emit.Store16I(CONTEXT_FIELD(pc), pc);
+        if (cycles)
+            emit.Alu64MI(ALU_ADD, CONTEXT_FIELD(clockCount), cycles);
+        emit.Pop(SCRATCH);
+        emit.Pop(WRITE_PAGES);
+        emit.MovRI(RAX, stop);
+        emit.Ret();
+    };
+
+    // Prologue
+    emit.Push(WRITE_PAGES);
+    emit.Push(SCRATCH);
+    emit.Mov64RM(READ_PAGES, field(offsetof(Context, readPages)));
+    emit.Mov64RM(WRITE_PAGES, field(offsetof(Context, writePages)));
+    emit.MovzxRM8(REG_A, CONTEXT_FIELD(a));
+    emit.MovzxRM8(REG_X, CONTEXT_FIELD(x));
+    emit.MovzxRM8(REG_Y, CONTEXT_FIELD(y));
+    emit.MovzxRM16(LAZY_NZ, CONTEXT_FIELD(lazyNZ));
+    emit.MovzxRM8(LAZY_C, CONTEXT_FIELD(lazyC));
+
+    uint16_t pc = block.startPc;
+    uint32_t cycles = 0;
+    bool ended = false; // Whether the last instruction already emitted the block exit
+
+    unsigned int i = 0;
+    for (; i < block.length && !ended; i++) {
+        uint8_t opcode = block.instructions[i].opcode;
+        uint16_t operand = block.instructions[i].operand;
+        const NES6502Base::Instruction &instruction = NES6502Base::instructionSetLookup[opcode];
+        uint16_t nextPc = pc + 1 + NES6502Base::operandLengthLookup[(uint8_t)instruction.addrMode];
+
+        // Leaves the native code if rax (page pointer) is null, before anything was modified
+        auto bailIfNull = [&]() {
+            emit.Test64RR(RAX, RAX);
+            stubs[stubCount++] = {emit.Jcc(CC_E), i, pc, cycles};
+        };
+        auto bailIf = [&](Cond cond) { stubs[stubCount++] = {emit.Jcc(cond), i, pc, cycles}; };
+
+        // Zero page stack address, from the stack pointer plus the given offset, into rdx
+        auto stackOffset = [&](int8_t offset) {
+            emit.MovzxRM8(RDX, CONTEXT_FIELD(stkp));
+            if (offset) {
+                emit.AluRI(ALU_ADD, RDX, (uint32_t)(int32_t)offset);
+                emit.AluRI(ALU_AND, RDX, 0xFF);
+            }
+        };
+
+        // Marking of the page written as dirty, the page being either static or in rax (rdx
+        // overwritten), before the bus is possibly left to write it itself
+        auto markDirty = [&](int page, bool dynamic) {
+            if constexpr (BusType::TRACKS_DIRTY_PAGES) {
+                emit.Mov64RM(RDX, field(offsetof(Context, dirtyPages)));
+                emit.Store8I(dynamic ? At(RDX, RAX, 1) : At(RDX, page), 1);
+            }
+        };
+
+        // Memory operand resolution into rax (page pointer) and rdx (offset in the page)
+        enum Access { READ, WRITE, READ_WRITE };
+        auto resolve = [&](Access access) {
+            int table = access == WRITE ? WRITE_PAGES : READ_PAGES;
+
+            // Address, either static (page and offset) or dynamic (in the scratch register)
+            bool dynamic = true;
+            uint8_t page = 0, offset = 0;
+
+            switch (instruction.addrMode) {
+            case am::ZP0:
+                dynamic = false;
+                offset = operand & 0x00FF;
+                break;
+            case am::ABS:
+                dynamic = false;
+                page = operand >> 8;
+                offset = operand & 0x00FF;
+                break;
+            case am::ZPX:
+            case am::ZPY:
+                emit.MovRR(SCRATCH, instruction.addrMode == am::ZPX ? REG_X : REG_Y);
+                emit.AluRI(ALU_ADD, SCRATCH, operand & 0x00FF);
+                emit.AluRI(ALU_AND, SCRATCH, 0x00FF);
+                break;
+            case am::ABX:
+            case am::ABY:
+                emit.MovRR(SCRATCH, instruction.addrMode == am::ABX ? REG_X : REG_Y);
+                emit.AluRI(ALU_ADD, SCRATCH, operand);
+                emit.AluRI(ALU_AND, SCRATCH, 0xFFFF);
+                break;
+            case am::IZX:
+            case am::IZY: {
+                // Pointer in zero page
+                emit.Mov64RM(RAX, At(READ_PAGES, 0));
+                bailIfNull();
+                if (instruction.addrMode == am::IZX) {
+                    emit.MovRR(RDX, REG_X);
+                    emit.AluRI(ALU_ADD, RDX, operand & 0x00FF);
+                    emit.AluRI(ALU_AND, RDX, 0x00FF);
+                } else {
+                    emit.MovRI(RDX, operand & 0x00FF);
+                }
+                emit.MovzxRM8(SCRATCH, At(RAX, RDX, 1));
+                emit.AluRI(ALU_ADD, RDX, 1);
+                emit.AluRI(ALU_AND, RDX, 0x00FF);
+                emit.MovzxRM8(RDX, At(RAX, RDX, 1));
+                emit.ShlRI(RDX, 8);
+                emit.AluRR(ALU_OR, SCRATCH, RDX);
+                if (instruction.addrMode == am::IZY) {
+                    emit.AluRR(ALU_ADD, SCRATCH, REG_Y);
+                    emit.AluRI(ALU_AND, SCRATCH, 0xFFFF);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+
+            if (!dynamic) {
+                if (access != READ)
+                    markDirty(page, false);
+                emit.Mov64RM(RAX, At(table, page * 8));
+                bailIfNull();
+                if (access == READ_WRITE) {
+                    emit.Cmp64RM(RAX, At(WRITE_PAGES, page * 8));
+                    bailIf(CC_NE);
+                }
+                emit.MovRI(RDX, offset);
+                return;
+            }
+
+            emit.MovRR(RAX, SCRATCH);
+            emit.ShrRI(RAX, 8);
+            if (access != READ)
+                markDirty(0, true);
+            if (access == READ_WRITE)
+                emit.Mov64RM(RDX, At(WRITE_PAGES, RAX, 8));
+            emit.Mov64RM(RAX, At(table, RAX, 8));
+            bailIfNull();
+            if (access == READ_WRITE) {
+                emit.Cmp64RR(RAX, RDX); // Read and write memory must be the same
+                bailIf(CC_NE);
+            }
+            emit.MovRR(RDX, SCRATCH);
+            emit.AluRI(ALU_AND, RDX, 0x00FF);
+
+            // Additional cycle when indexing crossed a page, i.e. the low byte wrapped below
+            // the index
+            if (instruction.pageCross &&
+                (instruction.addrMode == am::ABX || instruction.addrMode == am::ABY ||
+                 instruction.addrMode == am::IZY)) {
+                emit.AluRR(ALU_CMP, RDX, instruction.addrMode == am::ABX ? REG_X : REG_Y);
+                emit.Alu64MI(ALU_ADC, CONTEXT_FIELD(clockCount), 0);
+            }
+        };
+
+        // Fetched data into rdx (zero extended)
+        auto fetch = [&]() {
+            if (instruction.addrMode == am::IMM) {
+                emit.MovRI(RDX, operand & 0x00FF);
+            } else if (instruction.addrMode == am::IMP) { // See NES6502::IMP
+                emit.MovRR(RDX, REG_A);
+            } else {
+                resolve(READ);
+                emit.MovzxRM8(RDX, At(RAX, RDX, 1));
+            }
+        };
+
+        // Shifts and rotations of the given register, holding an 8-bit value
+        auto shift = [&](is operation, int reg) {
+            switch (operation) {
+            case is::ASL:
+                emit.ShlRI(reg, 1);
+                emit.MovRR(LAZY_C, reg);
+                emit.ShrRI(LAZY_C, 8);
+                emit.AluRI(ALU_AND, reg, 0xFF);
+                break;
+            case is::ROL:
+                emit.ShlRI(reg, 1);
+                emit.AluRR(ALU_OR, reg, LAZY_C);
+                emit.MovRR(LAZY_C, reg);
+                emit.ShrRI(LAZY_C, 8);
+                emit.AluRI(ALU_AND, reg, 0xFF);
+                break;
+            case is::LSR:
+                emit.MovRR(LAZY_C, reg);
+                emit.AluRI(ALU_AND, LAZY_C, 1);
+                emit.ShrRI(reg, 1);
+                break;
+            default: // ROR
+                emit.ShlRI(LAZY_C, 8);
+                emit.AluRR(ALU_OR, reg, LAZY_C);
+                emit.MovRR(LAZY_C, reg);
+                emit.AluRI(ALU_AND, LAZY_C, 1);
+                emit.ShrRI(reg, 1);
+                break;
+            }
+            emit.MovRR(LAZY_NZ, reg);
+        };
+
+        // Conditional branch, ending the block
+        auto branch = [&](Cond taken) {
+            uint16_t target = nextPc + (int8_t)(operand & 0x00FF);
+            uint32_t takenCycles = cycles + instruction.cycles + 1;
+            if ((target & 0xFF00) != (nextPc & 0xFF00))
+                takenCycles++;
+
+            size_t patch = emit.Jcc(taken);
+            emitExit(0, -1, nextPc, cycles + instruction.cycles);
+            emit.Bind(patch);
+            emitExit(0, -1, target, takenCycles);
+            ended = true;
+        };
+
+        // Whether the instruction has a memory operand, for stores and read-modify-writes
+        bool memoryOperand = instruction.addrMode != am::IMP && instruction.addrMode != am::IMM &&
+                             instruction.addrMode != am::REL && instruction.addrMode != am::IND;
+
+        switch (instruction.operation) {
+        case is::LDA:
+        case is::LDX:
+        case is::LDY: {
+            int reg = instruction.operation == is::LDA   ? REG_A
+                      : instruction.operation == is::LDX ? REG_X
+                                                         : REG_Y;
+            fetch();
+            emit.MovRR(reg, RDX);
+            emit.MovRR(LAZY_NZ, RDX);
+            break;
+        }
+
+        case is::STA:
+        case is::STX:
+        case is::STY: {
+            int reg = instruction.operation == is::STA   ? REG_A
+                      : instruction.operation == is::STX ? REG_X
+                                                         : REG_Y;
+            if (!memoryOperand)
+                goto unsupported;
+            resolve(WRITE);
+            emit.Store8(At(RAX, RDX, 1), reg);
+            break;
+        }
+
+        case is::AND:
+        case is::ORA:
+        case is::EOR:
+            fetch();
+            emit.AluRR(instruction.operation == is::AND   ? ALU_AND
+                       : instruction.operation == is::ORA ? ALU_OR
+                                                          : ALU_XOR,
+                       REG_A, RDX);
+            emit.MovRR(LAZY_NZ, REG_A);
+            break;
+
+        case is::ADC:
+        case is::SBC:
+            fetch();
+            if (instruction.operation == is::SBC)
+                emit.AluRI(ALU_XOR, RDX, 0xFF); // Inversion for two's complement
+            emit.Store8(CONTEXT_FIELD(lazyV1), REG_A);
+            emit.Store8(CONTEXT_FIELD(lazyV2), RDX);
+            emit.AluRR(ALU_ADD, REG_A, RDX);
+            emit.AluRR(ALU_ADD, REG_A, LAZY_C);
+            emit.MovRR(LAZY_C, REG_A);
+            emit.ShrRI(LAZY_C, 8);
+            emit.AluRI(ALU_AND, REG_A, 0xFF);
+            emit.Store8(CONTEXT_FIELD(lazyVResult), REG_A);
+            emit.MovRR(LAZY_NZ, REG_A);
+            break;
+
+        case is::CMP:
+        case is::CPX:
+        case is::CPY: {
+            int reg = instruction.operation == is::CMP   ? REG_A
+                      : instruction.operation == is::CPX ? REG_X
+                                                         : REG_Y;
+            fetch();
+            emit.AluRR(ALU_CMP, reg, RDX);
+            emit.Setcc(CC_AE, LAZY_C);
+            emit.MovRR(LAZY_NZ, reg);
+            emit.AluRR(ALU_SUB, LAZY_NZ, RDX);
+            emit.AluRI(ALU_AND, LAZY_NZ, 0xFF);
+            break;
+        }
+
+        case is::BIT:
+            fetch();
+            emit.MovRR(RAX, RDX);
+            emit.ShlRI(RAX, 1);
+            emit.Store8(CONTEXT_FIELD(lazyV1), RAX);
+            emit.Store8(CONTEXT_FIELD(lazyV2), RAX);
+            emit.Store8I(CONTEXT_FIELD(lazyVResult), 0);
+            emit.MovRR(LAZY_NZ, REG_A);
+            emit.AluRR(ALU_AND, LAZY_NZ, RDX);
+            emit.AluRI(ALU_AND, RDX, 0x80);
+            emit.ShlRI(RDX, 1);
+            emit.AluRR(ALU_OR, LAZY_NZ, RDX);
+            break;
+
+        case is::ASL:
+        case is::LSR:
+        case is::ROL:
+        case is::ROR:
+            if (instruction.addrMode == am::IMP) { // Accumulator
+                shift(instruction.operation, REG_A);
+            } else {
+                if (!memoryOperand)
+                    goto unsupported;
+                resolve(READ_WRITE);
+                emit.MovzxRM8(SCRATCH, At(RAX, RDX, 1));
+                shift(instruction.operation, SCRATCH);
+                emit.Store8(At(RAX, RDX, 1), SCRATCH);
+            }
+            break;
+
+        case is::INC:
+        case is::DEC:
+            if (!memoryOperand)
+                goto unsupported;
+            resolve(READ_WRITE);
+            emit.MovzxRM8(SCRATCH, At(RAX, RDX, 1));
+            emit.AluRI(instruction.operation == is::INC ? ALU_ADD : ALU_SUB, SCRATCH, 1);
+            emit.AluRI(ALU_AND, SCRATCH, 0xFF);
+            emit.Store8(At(RAX, RDX, 1), SCRATCH);
+            emit.MovRR(LAZY_NZ, SCRATCH);
+            break;
+
+        case is::INX:
+        case is::INY:
+        case is::DEX:
+        case is::DEY: {
+            int reg = instruction.operation == is::INX || instruction.operation == is::DEX
+                          ? REG_X
+                          : REG_Y;
+            bool increment = instruction.operation == is::INX || instruction.operation == is::INY;
+            emit.AluRI(increment ? ALU_ADD : ALU_SUB, reg, 1);
+            emit.AluRI(ALU_AND, reg, 0xFF);
+            emit.MovRR(LAZY_NZ, reg);
+            break;
+        }
+
+        case is::TAX:
+        case is::TAY:
+        case is::TXA:
+        case is::TYA: {
+            int src = instruction.operation == is::TXA   ? REG_X
+                      : instruction.operation == is::TYA ? REG_Y
+                                                         : REG_A;
+            int dst = instruction.operation == is::TAX   ? REG_X
+                      : instruction.operation == is::TAY ? REG_Y
+                                                         : REG_A;
+            emit.MovRR(dst, src);
+            emit.MovRR(LAZY_NZ, dst);
+            break;
+        }
+
+        case is::TSX:
+            emit.MovzxRM8(REG_X, CONTEXT_FIELD(stkp));
+            emit.MovRR(LAZY_NZ, REG_X);
+            break;
+
+        case is::TXS:
+            emit.Store8(CONTEXT_FIELD(stkp), REG_X);
+            break;
+
+        case is::CLC:
+        case is::SEC:
+            emit.MovRI(LAZY_C, instruction.operation == is::SEC);
+            break;
+
+        case is::CLV:
+            emit.Store8I(CONTEXT_FIELD(lazyV1), 0);
+            emit.Store8I(CONTEXT_FIELD(lazyV2), 0);
+            emit.Store8I(CONTEXT_FIELD(lazyVResult), 0);
+            break;
+
+        case is::SEI:
+            emit.Alu8MI(ALU_OR, CONTEXT_FIELD(status), 1 << 2);
+            break;
+        case is::CLD:
+            emit.Alu8MI(ALU_AND, CONTEXT_FIELD(status), (uint8_t) ~(1 << 3));
+            break;
+        case is::SED:
+            emit.Alu8MI(ALU_OR, CONTEXT_FIELD(status), 1 << 3);
+            break;
+
+        case is::NOP:
+            break;
+
+        case is::PHA:
+            markDirty(0x01, false);
+            emit.Mov64RM(RAX, At(WRITE_PAGES, 0x01 * 8));
+            bailIfNull();
+            stackOffset(0);
+            emit.Store8(At(RAX, RDX, 1), REG_A);
+            emit.AluRI(ALU_SUB, RDX, 1);
+            emit.Store8(CONTEXT_FIELD(stkp), RDX);
+            break;
+
+        case is::PLA:
+            emit.Mov64RM(RAX, At(READ_PAGES, 0x01 * 8));
+            bailIfNull();
+            stackOffset(1);
+            emit.Store8(CONTEXT_FIELD(stkp), RDX);
+            emit.MovzxRM8(REG_A, At(RAX, RDX, 1));
+            emit.MovRR(LAZY_NZ, REG_A);
+            break;
+
+        case is::BCC:
+            emit.Test64RR(LAZY_C, LAZY_C);
+            branch(CC_E);
+            break;
+        case is::BCS:
+            emit.Test64RR(LAZY_C, LAZY_C);
+            branch(CC_NE);
+            break;
+        case is::BEQ:
+            emit.TestRI(LAZY_NZ, 0x00FF);
+            branch(CC_E);
+            break;
+        case is::BNE:
+            emit.TestRI(LAZY_NZ, 0x00FF);
+            branch(CC_NE);
+            break;
+        case is::BMI:
+            emit.TestRI(LAZY_NZ, 0x0180);
+            branch(CC_NE);
+            break;
+        case is::BPL:
+            emit.TestRI(LAZY_NZ, 0x0180);
+            branch(CC_E);
+            break;
+        case is::BVC:
+        case is::BVS:
+            // ((v1 ^ r) & (v2 ^ r) & 0x80), see NES6502::GetFlag
+            emit.MovzxRM8(RDX, CONTEXT_FIELD(lazyVResult));
+            emit.MovzxRM8(RAX, CONTEXT_FIELD(lazyV1));
+            emit.AluRR(ALU_XOR, RAX, RDX);
+            emit.Alu8RM(ALU_XOR, RDX, CONTEXT_FIELD(lazyV2));
+            emit.AluRR(ALU_AND, RAX, RDX);
+            emit.TestRI(RAX, 0x80);
+            branch(instruction.operation == is::BVS ? CC_NE : CC_E);
+            break;
+
+        case is::JMP:
+            if (instruction.addrMode != am::ABS)
+                goto unsupported;
+            emitExit(0, -1, operand, cycles + instruction.cycles);
+            ended = true;
+            break;
+
+        case is::JSR:
+            // The return address pushed is the last byte of the instruction
+            markDirty(0x01, false);
+            emit.Mov64RM(RAX, At(WRITE_PAGES, 0x01 * 8));
+            bailIfNull();
+            stackOffset(0);
+            emit.Store8I(At(RAX, RDX, 1), (nextPc - 1) >> 8);
+            emit.AluRI(ALU_SUB, RDX, 1);
+            emit.AluRI(ALU_AND, RDX, 0xFF);
+            emit.Store8I(At(RAX, RDX, 1), (nextPc - 1) & 0x00FF);
+            emit.AluRI(ALU_SUB, RDX, 1);
+            emit.Store8(CONTEXT_FIELD(stkp), RDX);
+            emitExit(0, -1, operand, cycles + instruction.cycles);
+            ended = true;
+            break;
+
+        case is::RTS:
+            emit.Mov64RM(RAX, At(READ_PAGES, 0x01 * 8));
+            bailIfNull();
+            stackOffset(1);
+            emit.MovzxRM8(SCRATCH, At(RAX, RDX, 1));
+            emit.AluRI(ALU_ADD, RDX, 1);
+            emit.AluRI(ALU_AND, RDX, 0xFF);
+            emit.MovzxRM8(RAX, At(RAX, RDX, 1));
+            emit.Store8(CONTEXT_FIELD(stkp), RDX);
+            emit.ShlRI(RAX, 8);
+            emit.AluRR(ALU_OR, RAX, SCRATCH);
+            emit.AluRI(ALU_ADD, RAX, 1); // JSR pushed the address of its last byte
+            emitExit(0, RAX, 0, cycles + instruction.cycles);
+            ended = true;
+            break;
+
+        default:
+        unsupported:
+            // BRK, RTI, PHP, PLP, CLI (which may unmask a pending interrupt, ending the run),
+            // indirect JMP and unofficial opcodes are left to the interpreter, the block
+            // stopping right before them
+            if (i == 0)
+                return nullptr;
+
+            emitExit(1 + i, -1, pc, cycles);
+            ended = true;
+            continue;
+        }
+
+        pc = nextPc;
+        cycles += instruction.cycles;
+    }
+
+    // Straight-line block ending without any jump (instruction limit, page boundary)
+    if (!ended)
+        emitExit(0, -1, pc, cycles);
+
+    // Exits towards the interpreter, sharing one exit per instruction
+    for (unsigned int s = 0; s < stubCount; s++) {
+        emit.Bind(stubs[s].patch);
+        if (s + 1 < stubCount && stubs[s + 1].index == stubs[s].index)
+            continue; // Falls through to the next stub's exit
+
+        emitExit(1 + stubs[s].index, -1, stubs[s].pc, stubs[s].cycles);
+    }
+#undef CONTEXT_FIELD
+
+    if (emit.Overflowed())
+        return nullptr;
+
+    BlockCode code = (BlockCode)arena.GetTop();
+    arena.Commit(emit.GetSize());
+    compiledBlockCount++;
+
+    return code;
+#else
+    return nullptr;
+#endif
+}
+
+// Differential mode
+
+template <typename BusType> void NES6502Jit<BusType>::EnableDifferential(BusType *_referenceBus) {
+    referenceBus = _referenceBus;
+    diverged = false;
+}
+
+template <typename BusType> void NES6502Jit<BusType>::CheckReference(uint16_t blockPc) {
+    Cpu &reference = referenceBus->GetCpu();
+    referenceBus->RunUntil(cpu.clockCount);
+
+    if (!cpu.MatchesState(reference)) {
+        diverged = true;
+        divergencePc = blockPc;
+    }
+}
+
+// Supported bus types
+template class NES6502Jit<Bus>;
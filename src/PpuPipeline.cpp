@@ -0,0 +1,193 @@
+#include "../include/PpuPipeline.h"
+
+#if PPUPIPELINE_SSE2
+#include <emmintrin.h>
+#endif
+#if PPUPIPELINE_SSE2 && defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// Scalar kernels
+
+void PpuPipeline::DecodeTileRowsScalar(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                                       const uint8_t *palettes, unsigned int count,
+                                       uint8_t *pixels) {
+    for (unsigned int i = 0; i < count; i++) {
+        for (unsigned int j = 0; j < 8; j++) {
+            uint8_t color = ((lowPlanes[i] >> (7 - j)) & 0x01) |
+                            (((highPlanes[i] >> (7 - j)) & 0x01) << 1);
+            pixels[i * 8 + j] = color ? (palettes[i] << 2) | color : 0;
+        }
+    }
+}
+
+void PpuPipeline::FindSpritesScalar(const uint8_t *y, unsigned int height,
+                                    unsigned int lineCount, uint64_t *masks) {
+    for (unsigned int line = 0; line < lineCount; line++) {
+        uint64_t mask = 0;
+        for (unsigned int i = 0; i < 64; i++)
+            mask |= (uint64_t)(line - y[i] < height) << i;
+        masks[line] = mask;
+    }
+}
+
+bool PpuPipeline::ComposeScalar(const uint8_t *background, const uint8_t *sprites,
+                                unsigned int count, const uint8_t *palette, uint8_t colorMask,
+                                uint8_t *colors) {
+    bool spriteZeroHit = false;
+
+    for (unsigned int i = 0; i < count; i++) {
+        uint8_t backgroundPixel = background[i], spritePixel = sprites[i];
+
+        // Both opaque: sprite 0 hit, then priority
+        if (backgroundPixel & 0x03 && spritePixel & 0x03) {
+            spriteZeroHit |= (spritePixel & SPRITE_ZERO) != 0;
+            if (spritePixel & SPRITE_BEHIND)
+                spritePixel = 0;
+        }
+
+        // Sprite palettes in the upper half, transparent pixels being the backdrop (entry 0)
+        uint8_t index = spritePixel & 0x03 ? 0x10 | (spritePixel & 0x0F) : backgroundPixel & 0x0F;
+        colors[i] = palette[index] & colorMask;
+    }
+
+    return spriteZeroHit;
+}
+
+// SSE2 kernels
+
+#if PPUPIPELINE_SSE2
+
+namespace {
+
+// Repeats each of the 8 low bytes 8 times, two bytes per vector
+inline void Spread(__m128i bytes, __m128i (&spread)[4]) {
+    __m128i pairs = _mm_unpacklo_epi8(bytes, bytes);
+    __m128i quadsLow = _mm_unpacklo_epi16(pairs, pairs);
+    __m128i quadsHigh = _mm_unpackhi_epi16(pairs, pairs);
+
+    spread[0] = _mm_unpacklo_epi32(quadsLow, quadsLow);
+    spread[1] = _mm_unpackhi_epi32(quadsLow, quadsLow);
+    spread[2] = _mm_unpacklo_epi32(quadsHigh, quadsHigh);
+    spread[3] = _mm_unpackhi_epi32(quadsHigh, quadsHigh);
+}
+
+} // namespace
+
+void PpuPipeline::DecodeTileRowsSse2(const uint8_t *lowPlanes, const uint8_t *highPlanes,
+                                     const uint8_t *palettes, unsigned int count,
+                                     uint8_t *pixels) {
+    // Bit of each pixel in its row, leftmost first
+    const __m128i bits = _mm_setr_epi8(-128, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, -128,
+                                       0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i one = _mm_set1_epi8(0x01), two = _mm_set1_epi8(0x02);
+
+    for (unsigned int i = 0; i < count; i += TILE_BATCH) {
+        // Planes and palettes (moved to bits 2-3) of 8 rows, interleaved into their pixels
+        __m128i lows[4], highs[4], tilePalettes[4];
+        Spread(_mm_loadl_epi64((const __m128i *)(lowPlanes + i)), lows);
+        Spread(_mm_loadl_epi64((const __m128i *)(highPlanes + i)), highs);
+        Spread(_mm_slli_epi16(_mm_loadl_epi64((const __m128i *)(palettes + i)), 2),
+               tilePalettes);
+
+        for (unsigned int j = 0; j < 4; j++) {
+            __m128i lowSet = _mm_cmpeq_epi8(_mm_and_si128(lows[j], bits), bits);
+            __m128i highSet = _mm_cmpeq_epi8(_mm_and_si128(highs[j], bits), bits);
+
+            __m128i color = _mm_or_si128(_mm_and_si128(lowSet, one), _mm_and_si128(highSet, two));
+            __m128i opaque = _mm_or_si128(lowSet, highSet);
+            __m128i pixel = _mm_or_si128(color, _mm_and_si128(tilePalettes[j], opaque));
+
+            _mm_storeu_si128((__m128i *)(pixels + (i + j * 2) * 8), pixel);
+        }
+    }
+}
+
+void PpuPipeline::FindSpritesSse2(const uint8_t *y, unsigned int height,
+                                  unsigned int lineCount, uint64_t *masks) {
+    __m128i ys[4];
+    for (unsigned int j = 0; j < 4; j++)
+        ys[j] = _mm_loadu_si128((const __m128i *)(y + j * 16));
+    const __m128i lastRow = _mm_set1_epi8(height - 1);
+
+    // Unsigned byte compares only: the line must not be above the sprite (max), and the row of
+    // the sprite it is on must be within its height (min), 16 sprites at a time
+    for (unsigned int line = 0; line < lineCount; line++) {
+        __m128i lines = _mm_set1_epi8(line);
+        uint64_t mask = 0;
+
+        for (unsigned int j = 0; j < 4; j++) {
+            __m128i below = _mm_cmpeq_epi8(_mm_max_epu8(ys[j], lines), lines);
+            __m128i rows = _mm_subs_epu8(lines, ys[j]);
+            __m128i within = _mm_cmpeq_epi8(_mm_min_epu8(rows, lastRow), rows);
+            mask |= (uint64_t)_mm_movemask_epi8(_mm_and_si128(below, within)) << (j * 16);
+        }
+        masks[line] = mask;
+    }
+}
+
+bool PpuPipeline::ComposeSse2(const uint8_t *background, const uint8_t *sprites,
+                              unsigned int count, const uint8_t *palette, uint8_t colorMask,
+                              uint8_t *colors) {
+    const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi8(-1);
+    const __m128i colorBits = _mm_set1_epi8(0x03), indexBits = _mm_set1_epi8(0x0F);
+    const __m128i spritePalettes = _mm_set1_epi8(0x10);
+    const __m128i behind = _mm_set1_epi8(SPRITE_BEHIND), spriteZero = _mm_set1_epi8(SPRITE_ZERO);
+#ifdef __SSSE3__
+    const __m128i lowerPalette = _mm_loadu_si128((const __m128i *)palette);
+    const __m128i upperPalette = _mm_loadu_si128((const __m128i *)(palette + 16));
+    const __m128i mask = _mm_set1_epi8(colorMask);
+#endif
+
+    int spriteZeroHits = 0;
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i backgroundPixels = _mm_loadu_si128((const __m128i *)(background + i));
+        __m128i spritePixels = _mm_loadu_si128((const __m128i *)(sprites + i));
+
+        __m128i backgroundTransparent =
+            _mm_cmpeq_epi8(_mm_and_si128(backgroundPixels, colorBits), zero);
+        __m128i spriteTransparent = _mm_cmpeq_epi8(_mm_and_si128(spritePixels, colorBits), zero);
+
+        // Both opaque: sprite 0 hit, then priority
+        __m128i overlap = _mm_andnot_si128(_mm_or_si128(backgroundTransparent, spriteTransparent),
+                                           ones);
+        __m128i fromSpriteZero =
+            _mm_cmpeq_epi8(_mm_and_si128(spritePixels, spriteZero), spriteZero);
+        spriteZeroHits |= _mm_movemask_epi8(_mm_and_si128(overlap, fromSpriteZero));
+
+        __m128i spriteBehind = _mm_cmpeq_epi8(_mm_and_si128(spritePixels, behind), behind);
+        __m128i backgroundShown =
+            _mm_or_si128(spriteTransparent, _mm_and_si128(overlap, spriteBehind));
+
+        __m128i backgroundIndex = _mm_and_si128(backgroundPixels, indexBits);
+        __m128i spriteIndex = _mm_or_si128(_mm_and_si128(spritePixels, indexBits), spritePalettes);
+        __m128i index = _mm_or_si128(_mm_and_si128(backgroundShown, backgroundIndex),
+                                     _mm_andnot_si128(backgroundShown, spriteIndex));
+
+#ifdef __SSSE3__
+        // Both halves of the palette looked up by their low 4 bits, then selected by bit 4
+        __m128i lowerColors = _mm_shuffle_epi8(lowerPalette, index);
+        __m128i upperColors = _mm_shuffle_epi8(upperPalette, index);
+        __m128i upper = _mm_cmpeq_epi8(_mm_and_si128(index, spritePalettes), spritePalettes);
+        __m128i pixelColors = _mm_or_si128(_mm_andnot_si128(upper, lowerColors),
+                                           _mm_and_si128(upper, upperColors));
+
+        _mm_storeu_si128((__m128i *)(colors + i), _mm_and_si128(pixelColors, mask));
+#else
+        // No byte shuffle in SSE2, one load per pixel
+        alignas(16) uint8_t indices[16];
+        _mm_store_si128((__m128i *)indices, index);
+        for (unsigned int j = 0; j < 16; j++)
+            colors[i + j] = palette[indices[j]] & colorMask;
+#endif
+    }
+
+    // Pixels left over
+    bool spriteZeroHit = ComposeScalar(background + i, sprites + i, count - i, palette,
+                                       colorMask, colors + i);
+
+    return spriteZeroHits != 0 || spriteZeroHit;
+}
+
+#endif
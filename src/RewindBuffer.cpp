@@ -0,0 +1,206 @@
+#include "../include/RewindBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if REWINDBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+RewindBuffer::RewindBuffer(unsigned int _frameCapacity, size_t byteCapacity)
+    : state(new MachineState), deltaCapacity(_frameCapacity > 1 ? _frameCapacity - 1 : 0),
+      ringSize(std::max(byteCapacity, MaxDeltaSize(sizeof(MachineState)))) {
+    deltas.reset(new Delta[deltaCapacity ? deltaCapacity : 1]);
+    ring.reset(new uint8_t[ringSize]);
+    Clear();
+}
+
+void RewindBuffer::Clear() {
+    stateHeld = false;
+    firstDelta = deltaCount = 0;
+    deltaBytes = 0;
+    ringHead = 0;
+}
+
+// History
+
+void RewindBuffer::Push(const MachineState &newState) {
+    uint8_t *last = (uint8_t *)state.get();
+    const uint8_t *current = (const uint8_t *)&newState;
+
+    if (!stateHeld || deltaCapacity == 0) {
+        std::memcpy(last, current, sizeof(MachineState));
+        stateHeld = true;
+        return;
+    }
+
+    // Room for the largest delta, after the last one or from the start of the ring. The deltas
+    // ahead of the head are the oldest ones, in order, those past it (if wrapping) first.
+    const size_t maxSize = MaxDeltaSize(sizeof(MachineState));
+    if (ringHead + maxSize > ringSize) {
+        while (deltaCount && deltas[firstDelta].offset >= ringHead)
+            DropOldestDelta();
+        ringHead = 0;
+    }
+    auto overlaps = [&](const Delta &delta) {
+        return delta.offset < ringHead + maxSize && ringHead < delta.offset + delta.size;
+    };
+    while (deltaCount && (deltaCount == deltaCapacity || overlaps(deltas[firstDelta])))
+        DropOldestDelta();
+
+    size_t size = EncodeDelta(last, current, sizeof(MachineState), ring.get() + ringHead);
+    deltas[(firstDelta + deltaCount) % deltaCapacity] = {ringHead, size};
+    deltaCount++;
+    deltaBytes += size;
+    ringHead += size;
+}
+
+bool RewindBuffer::StepBack() {
+    if (!stateHeld || deltaCount == 0)
+        return false;
+
+    const Delta &delta = deltas[(firstDelta + deltaCount - 1) % deltaCapacity];
+    ApplyDelta((uint8_t *)state.get(), sizeof(MachineState), ring.get() + delta.offset);
+
+    ringHead = delta.offset;
+    deltaCount--;
+    deltaBytes -= delta.size;
+    return true;
+}
+
+void RewindBuffer::DropOldestDelta() {
+    deltaBytes -= deltas[firstDelta].size;
+    firstDelta = (firstDelta + 1) % deltaCapacity;
+    deltaCount--;
+}
+
+// Delta encoding
+
+static void WriteRun(uint8_t *run, uint16_t zeroBlocks, uint16_t literalBlocks) {
+    std::memcpy(run, &zeroBlocks, 2);
+    std::memcpy(run + 2, &literalBlocks, 2);
+}
+
+void RewindBuffer::ApplyDelta(uint8_t *state, size_t size, const uint8_t *delta) {
+    size_t blockCount = size / BLOCK_SIZE;
+
+    for (size_t block = 0; block < blockCount;) {
+        uint16_t zeroBlocks, literalBlocks;
+        std::memcpy(&zeroBlocks, delta, 2);
+        std::memcpy(&literalBlocks, delta + 2, 2);
+        delta += 4;
+        block += zeroBlocks;
+
+        // 8 bytes at a time
+        uint8_t *literals = state + block * BLOCK_SIZE;
+        for (size_t i = 0; i < literalBlocks * BLOCK_SIZE; i += 8) {
+            uint64_t word, bits;
+            std::memcpy(&word, literals + i, 8);
+            std::memcpy(&bits, delta + i, 8);
+            word ^= bits;
+            std::memcpy(literals + i, &word, 8);
+        }
+        delta += literalBlocks * BLOCK_SIZE;
+        block += literalBlocks;
+    }
+
+    for (size_t i = blockCount * BLOCK_SIZE; i < size; i++)
+        state[i] ^= *delta++;
+}
+
+size_t RewindBuffer::EncodeDeltaScalar(uint8_t *previous, const uint8_t *current, size_t size,
+                                       uint8_t *delta) {
+    size_t blockCount = size / BLOCK_SIZE;
+    uint8_t *out = delta;
+
+    for (size_t block = 0; block < blockCount;) {
+        uint16_t zeroBlocks = 0, literalBlocks = 0;
+        while (block < blockCount && zeroBlocks < UINT16_MAX &&
+               std::memcmp(previous + block * BLOCK_SIZE, current + block * BLOCK_SIZE,
+                           BLOCK_SIZE) == 0) {
+            block++;
+            zeroBlocks++;
+        }
+
+        uint8_t *run = out;
+        out += 4;
+        while (block < blockCount && literalBlocks < UINT16_MAX &&
+               std::memcmp(previous + block * BLOCK_SIZE, current + block * BLOCK_SIZE,
+                           BLOCK_SIZE) != 0) {
+            for (size_t i = block * BLOCK_SIZE; i < (block + 1) * BLOCK_SIZE; i++) {
+                *out++ = previous[i] ^ current[i];
+                previous[i] = current[i];
+            }
+            block++;
+            literalBlocks++;
+        }
+        WriteRun(run, zeroBlocks, literalBlocks);
+    }
+
+    for (size_t i = blockCount * BLOCK_SIZE; i < size; i++) {
+        *out++ = previous[i] ^ current[i];
+        previous[i] = current[i];
+    }
+
+    return out - delta;
+}
+
+#if REWINDBUFFER_SSE2
+
+// Whether the 16-byte XOR is zero
+static bool IsZero(__m128i bits) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())) == 0xFFFF;
+}
+
+size_t RewindBuffer::EncodeDeltaSse2(uint8_t *previous, const uint8_t *current, size_t size,
+                                     uint8_t *delta) {
+    size_t blockCount = size / BLOCK_SIZE;
+    uint8_t *out = delta;
+
+    auto blockDelta = [&](size_t block) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(previous + block * BLOCK_SIZE));
+        __m128i b = _mm_loadu_si128((const __m128i *)(current + block * BLOCK_SIZE));
+        return _mm_xor_si128(a, b);
+    };
+
+    for (size_t block = 0; block < blockCount;) {
+        uint16_t zeroBlocks = 0, literalBlocks = 0;
+
+        // Zero blocks skipped 4 at a time (64 bytes), then one at a time up to the first
+        // literal one
+        while (block + 4 <= blockCount && zeroBlocks <= UINT16_MAX - 4 &&
+               IsZero(_mm_or_si128(_mm_or_si128(blockDelta(block), blockDelta(block + 1)),
+                                   _mm_or_si128(blockDelta(block + 2), blockDelta(block + 3))))) {
+            block += 4;
+            zeroBlocks += 4;
+        }
+        while (block < blockCount && zeroBlocks < UINT16_MAX && IsZero(blockDelta(block))) {
+            block++;
+            zeroBlocks++;
+        }
+
+        uint8_t *run = out;
+        out += 4;
+        while (block < blockCount && literalBlocks < UINT16_MAX) {
+            __m128i bits = blockDelta(block);
+            if (IsZero(bits))
+                break;
+
+            _mm_storeu_si128((__m128i *)out, bits);
+            std::memcpy(previous + block * BLOCK_SIZE, current + block * BLOCK_SIZE, BLOCK_SIZE);
+            out += BLOCK_SIZE;
+            block++;
+            literalBlocks++;
+        }
+        WriteRun(run, zeroBlocks, literalBlocks);
+    }
+
+    for (size_t i = blockCount * BLOCK_SIZE; i < size; i++) {
+        *out++ = previous[i] ^ current[i];
+        previous[i] = current[i];
+    }
+
+    return out - delta;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "../include/RunAhead.h"
+
+#include "../include/PpuTiming.h"
+
+template <typename BusType>
+RunAhead<BusType>::RunAhead(BusType &_bus, unsigned int _frames)
+    : bus(_bus), frames(_frames), state(new MachineState()) {
+    snapshots = bus.Snapshot(*state);
+    ResetTiming();
+}
+
+template <typename BusType> void RunAhead<BusType>::ResetTiming() {
+    lastTiming = worstTiming = {};
+    totalTime = {};
+    frameCount = overBudgetCount = 0;
+}
+
+template <typename BusType> void RunAhead<BusType>::RunToVblank() {
+    bus.RunUntil(PpuTiming::FindVblankStart(bus.GetCpu().GetCycleCount()) + 1);
+}
+
+// Host frames
+
+template <typename BusType> const uint8_t *RunAhead<BusType>::RunFrame() {
+    NES2C02 &ppu = bus.GetPpu();
+    unsigned int ahead = snapshots ? frames : 0;
+    FrameTiming timing = {};
+
+    // Next frame, only rendered if presented
+    auto start = std::chrono::steady_clock::now();
+    ppu.SetRenderSkip(ahead > 0);
+    RunToVblank();
+    auto end = std::chrono::steady_clock::now();
+    timing.frame = end - start;
+
+    if (ahead > 0) {
+        // Its state, then the frames ahead of it, the last one rendered, then back to it (the
+        // frame buffer being left as is)
+        start = end;
+        bus.SnapshotIncremental(*state);
+        end = std::chrono::steady_clock::now();
+        timing.snapshot = end - start;
+
+        start = end;
+        for (unsigned int frame = 1; frame <= ahead; frame++) {
+            ppu.SetRenderSkip(frame < ahead);
+            RunToVblank();
+        }
+        end = std::chrono::steady_clock::now();
+        timing.ahead = end - start;
+
+        start = end;
+        bus.Restore(*state);
+        end = std::chrono::steady_clock::now();
+        timing.restore = end - start;
+    }
+
+    lastTiming = timing;
+    if (timing.GetTotal() > worstTiming.GetTotal())
+        worstTiming = timing;
+    totalTime += timing.GetTotal();
+    frameCount++;
+    overBudgetCount += timing.GetTotal() > FRAME_BUDGET;
+
+    return ppu.GetFrameBuffer();
+}
+
+// Supported buses
+template class RunAhead<Bus>;
+template class RunAhead<CycleAccurateBus>;
@@ -0,0 +1,90 @@
+#include "../include/Scheduler.h"
+
+Scheduler::Scheduler() : heap(), count(0) {
+    for (uint8_t &position : positions)
+        position = NOT_SCHEDULED;
+}
+
+// Scheduling
+
+void Scheduler::Schedule(EventType type, uint64_t timestamp) {
+    uint8_t position = positions[(uint8_t)type];
+    if (position == NOT_SCHEDULED)
+        position = count++;
+
+    Place(position, {timestamp, type});
+
+    // Moved either way when rescheduled
+    SiftUp(position);
+    SiftDown(positions[(uint8_t)type]);
+}
+
+void Scheduler::Cancel(EventType type) {
+    uint8_t position = positions[(uint8_t)type];
+    if (position != NOT_SCHEDULED)
+        Remove(position);
+}
+
+EventType Scheduler::PopNext() {
+    EventType type = heap[0].type;
+    Remove(0);
+
+    return type;
+}
+
+// Heap maintenance
+
+void Scheduler::Place(uint8_t position, const Event &event) {
+    heap[position] = event;
+    positions[(uint8_t)event.type] = position;
+}
+
+void Scheduler::SiftUp(uint8_t position) {
+    Event event = heap[position];
+
+    while (position > 0) {
+        uint8_t parent = (position - 1) / 2;
+        if (!Precedes(event, heap[parent]))
+            break;
+
+        Place(position, heap[parent]);
+        position = parent;
+    }
+
+    Place(position, event);
+}
+
+void Scheduler::SiftDown(uint8_t position) {
+    Event event = heap[position];
+
+    for (;;) {
+        uint8_t child = 2 * position + 1;
+        if (child >= count)
+            break;
+
+        if (child + 1 < count && Precedes(heap[child + 1], heap[child]))
+            child++;
+
+        if (!Precedes(heap[child], event))
+            break;
+
+        Place(position, heap[child]);
+        position = child;
+    }
+
+    Place(position, event);
+}
+
+void Scheduler::Remove(uint8_t position) {
+    positions[(uint8_t)heap[position].type] = NOT_SCHEDULED;
+    count--;
+
+    // The last event takes the freed position, then moves to its place
+    if (position != count) {
+        EventType moved = heap[count].type;
+        Place(position, heap[count]);
+
+        SiftUp(position);
+        SiftDown(positions[(uint8_t)moved]);
+    }
+}
@@ -0,0 +1,10 @@
+#include "../include/TracingBus.h"
+
+template <typename Policy> BasicTracingBus<Policy>::BasicTracingBus() : cpu(this) {
+    const unsigned int RAM_SIZE = 64 * 1024;
+    ram.reset(new uint8_t[RAM_SIZE]());
+}
+
+// Supported execution policies
+template class BasicTracingBus<InstructionLevel>;
+template class BasicTracingBus<CycleAccurate>;
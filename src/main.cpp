@@ -24,16 +24,80 @@
  * and any comments
  */
 
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "../include/Bus.h"
+#include "../include/Cartridge.h"
+#include "../include/RunAhead.h"
+
+int main(int argc, char **argv) {
+    // --no-idle-skip for the games that misbehave when their idle loops are skipped,
+    // --run-ahead <frames> to present frames that many frames ahead (see RunAhead)
+    bool idleLoopSkipping = true;
+    int runAheadFrames = -1;
+    bool usage = argc < 2;
+    for (int i = 2; i < argc && !usage; i++) {
+        if (std::strcmp(argv[i], "--no-idle-skip") == 0)
+            idleLoopSkipping = false;
+        else if (std::strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc &&
+                 std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            runAheadFrames = std::atoi(argv[++i]);
+        else
+            usage = true;
+    }
+    if (usage) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <rom.nes> [--no-idle-skip] [--run-ahead <frames>]\n";
+        return 1;
+    }
+
+    Cartridge cartridge;
+    if (!cartridge.Load(argv[1])) {
+        std::cerr << argv[1] << ": " << cartridge.GetError() << "\n";
+        return 1;
+    }
 
-int main() {
     Bus b;
+    if (!b.InsertCartridge(&cartridge)) {
+        std::cerr << argv[1] << ": mapper " << cartridge.GetMapperNumber() << " not supported\n";
+        return 1;
+    }
+
+    std::cout << argv[1] << ": mapper " << cartridge.GetMapperNumber() << ", "
+              << cartridge.GetPrgRomSize() / 1024 << " KiB PRG-ROM, "
+              << cartridge.GetChrRomSize() / 1024 << " KiB CHR-ROM, hash " << std::hex
+              << cartridge.GetHash() << std::dec << "\n";
+
+    // Skipping also off for the games known to need it (see IsIdleLoopSkippingException)
+    if (!idleLoopSkipping)
+        b.GetCpu().SetIdleLoopSkipping(false);
+    b.GetCpu().Reset();
+
+    if (runAheadFrames < 0) {
+        // One second of emulated time, frames being rendered but not displayed yet
+        b.RunCycles(1'789'773);
+        std::cout << b.GetPpu().GetFrameCount() << " frames rendered, "
+                  << b.GetCpu().GetIdleCycleCount() << " cycles skipped in idle loops\n";
+        return 0;
+    }
+
+    // One second of host frames, each to fit in the time of one at the NES's refresh rate
+    RunAhead<Bus> runAhead(b, static_cast<unsigned int>(runAheadFrames));
+    for (int frame = 0; frame < 60; frame++)
+        runAhead.RunFrame();
 
-    // Ridiculous test
-    b.WriteRam(0xF000, 70);
-    std::cout << b.ReadRam(0xF000);
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    auto budget = Microseconds(RunAhead<Bus>::FRAME_BUDGET).count();
+    auto average = Microseconds(runAhead.GetAverageTime()).count();
+    auto worst = Microseconds(runAhead.GetWorstTiming().GetTotal()).count();
+    std::cout << runAhead.GetFrameCount() << " host frames run " << runAheadFrames
+              << " frames ahead, " << average << " us on average and " << worst
+              << " us at worst for a budget of " << budget << " us, "
+              << runAhead.GetOverBudgetCount() << " over budget\n";
 
     return 0;
 }
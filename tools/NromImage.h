@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef NROMIMAGE_H
+#define NROMIMAGE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Program space ($8000 - $FFFF) of an NROM (mapper 0) iNES image, 16 KiB PRG-ROMs being mirrored
+// at $C000. Returns false if the image cannot be read or isn't NROM.
+inline bool LoadNromProgramSpace(const char *path, uint8_t (&programSpace)[0x8000]) {
+    const size_t HEADER_SIZE = 16, TRAINER_SIZE = 512, PRG_BANK_SIZE = 16 * 1024;
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+
+    if (image.size() < HEADER_SIZE || std::memcmp(image.data(), "NES\x1A", 4) != 0)
+        return false;
+
+    unsigned int prgBanks = image[4];
+    unsigned int mapper = (image[6] >> 4) | (image[7] & 0xF0);
+    size_t prgOffset = HEADER_SIZE + (image[6] & 0x04 ? TRAINER_SIZE : 0);
+
+    if (mapper != 0 || prgBanks < 1 || prgBanks > 2 ||
+        image.size() < prgOffset + prgBanks * PRG_BANK_SIZE)
+        return false;
+
+    for (size_t i = 0; i < sizeof(programSpace); i++)
+        programSpace[i] = image[prgOffset + i % (prgBanks * PRG_BANK_SIZE)];
+
+    return true;
+}
+
+#endif // !NROMIMAGE_H
@@ -0,0 +1,93 @@
+/*
+ *
+ * nesem ahead-of-time translation runner
+ *
+ * Runs an NROM cartridge through the interpreter or through its translation by the static
+ * recompiler (linked in by make aot ROM=...), and reports the throughput. The check mode runs
+ * the translation against the interpreter, comparing both machines after every routine run.
+ *
+ * Usage: x86-64_linux-nesem-aot <rom.nes> [interpreter|aot|check] [cycles]
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "../include/Bus.h"
+#include "../include/NES6502Aot.h"
+#include "NromImage.h"
+
+static constexpr double NES_CPU_FREQUENCY = 1.789773e6; // NTSC 2A03 clock, in Hz
+
+// Translation linked in, generated by the static recompiler
+extern const AotProgram aotProgram;
+
+// Maps the program space to the cartridge space of the bus, and resets the CPU
+static void LoadCartridge(Bus &bus, const uint8_t (&programSpace)[0x8000]) {
+    for (uint32_t i = 0; i < sizeof(programSpace); i++)
+        bus.WriteRam(0x8000 + i, programSpace[i]);
+
+    bus.GetCpu().Reset();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <rom.nes> [interpreter|aot|check] [cycles]\n";
+        return 1;
+    }
+
+    static uint8_t programSpace[0x8000];
+    if (!LoadNromProgramSpace(argv[1], programSpace)) {
+        std::cerr << argv[1] << ": not an NROM (mapper 0) iNES image\n";
+        return 1;
+    }
+
+    const char *mode = argc > 2 ? argv[2] : "aot";
+    uint64_t cycles = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 500'000'000;
+    bool check = std::strcmp(mode, "check") == 0;
+
+    std::unique_ptr<Bus> bus = std::make_unique<Bus>();
+    std::unique_ptr<Bus> referenceBus = check ? std::make_unique<Bus>() : nullptr;
+    LoadCartridge(*bus, programSpace);
+
+    std::unique_ptr<NES6502Aot> aot = std::make_unique<NES6502Aot>(bus.get(), aotProgram);
+    if (std::strcmp(mode, "interpreter") != 0 && !aot->MatchesProgramSpace()) {
+        std::cerr << argv[1] << ": not the cartridge the translation was made from\n";
+        return 1;
+    }
+
+    if (check) {
+        LoadCartridge(*referenceBus, programSpace);
+        aot->EnableDifferential(referenceBus.get());
+    }
+
+    // Both modes run through the bus's event loop (PPU rendering included)
+    auto start = std::chrono::steady_clock::now();
+    if (std::strcmp(mode, "interpreter") == 0)
+        bus->RunCycles(cycles);
+    else
+        bus->RunCycles(*aot, cycles);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mcyclesPerSecond = cycles / seconds / 1e6;
+
+    std::cout << mode << ": " << mcyclesPerSecond << " Mcycles/s ("
+              << mcyclesPerSecond * 1e6 / NES_CPU_FREQUENCY << "x real time)\n";
+
+    int status = 0;
+    if (aot->HasDiverged()) {
+        std::cout << mode << ": diverged after the routine run from $" << std::hex
+                  << aot->GetDivergencePc() << std::dec << "\n";
+        status = 1;
+    } else if (std::strcmp(mode, "interpreter") != 0) {
+        std::cout << mode << ": " << aot->GetRoutineRunCount() << " routine runs, "
+                  << aot->GetInterpretedInstructionCount() << " interpreted instructions\n";
+    }
+
+    return status;
+}
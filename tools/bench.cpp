@@ -0,0 +1,1168 @@
+/*
+ *
+ * nesem benchmarks
+ *
+ * Measures the emulator's hot paths on synthetic workloads, in emulated clock cycles per
+ * second. To be built in release mode (make bench), since timings of debug builds are
+ * meaningless.
+ *
+ * Usage: x86-64_linux-nesem-bench [benchmark name]...
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../include/Bus.h"
+#include "../include/FlatBus.h"
+#include "../include/NES6502Jit.h"
+#include "../include/PpuPipeline.h"
+#include "../include/PpuTiming.h"
+#include "../include/RewindBuffer.h"
+#include "../include/RunAhead.h"
+
+static constexpr double NES_CPU_FREQUENCY = 1.789773e6; // NTSC 2A03 clock, in Hz
+
+// Loads a program at $0200 and points the reset vector to it
+template <typename BusType>
+static void LoadProgram(BusType &bus, const uint8_t *program, uint16_t size) {
+    for (uint16_t i = 0; i < size; i++)
+        bus.WriteRam(0x0200 + i, program[i]);
+
+    bus.WriteRam(0xFFFC, 0x00);
+    bus.WriteRam(0xFFFD, 0x02);
+}
+
+// Runs the CPU through the given execution engine (the CPU itself or the JIT) for the given
+// amount of clock cycles and reports the throughput
+template <typename CpuType, typename EngineType>
+static void RunCpu(const char *name, CpuType &cpu, EngineType &engine, uint64_t cycles) {
+    cpu.Reset();
+
+    auto start = std::chrono::steady_clock::now();
+    engine.RunCycles(cycles);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mcyclesPerSecond = cycles / seconds / 1e6;
+
+    std::cout << name << ": " << mcyclesPerSecond << " Mcycles/s ("
+              << mcyclesPerSecond * 1e6 / NES_CPU_FREQUENCY << "x real time)\n";
+}
+
+template <typename CpuType>
+static void RunCpu(const char *name, CpuType &cpu, uint64_t cycles) {
+    RunCpu(name, cpu, cpu, cycles);
+}
+
+// Loop of arithmetic and logical instructions, each of them updating the status register
+static const uint8_t aluProgram[] = {
+    0xA2, 0x00,       // LDX #$00
+    0xB5, 0x10,       // LDA $10,X
+    0x69, 0x37,       // ADC #$37
+    0x45, 0x20,       // EOR $20
+    0xE9, 0x11,       // SBC #$11
+    0x29, 0xF7,       // AND #$F7
+    0x09, 0x01,       // ORA #$01
+    0xC9, 0x80,       // CMP #$80
+    0x2A,             // ROL A
+    0x95, 0x10,       // STA $10,X
+    0xE8,             // INX
+    0xD0, 0xEC,       // BNE $0202
+    0x4C, 0x00, 0x02, // JMP $0200
+};
+
+static void BenchAlu() {
+    FlatBus *bus = new FlatBus;
+    LoadProgram(*bus, aluProgram, sizeof(aluProgram));
+
+    RunCpu("alu", bus->GetCpu(), 500'000'000);
+
+    delete bus;
+}
+
+// Same loop with the cycle-accurate execution policy, every bus access made at its own cycle
+static void BenchAluCycle() {
+    CycleAccurateFlatBus *bus = new CycleAccurateFlatBus;
+    LoadProgram(*bus, aluProgram, sizeof(aluProgram));
+
+    RunCpu("alu-cycle", bus->GetCpu(), 500'000'000);
+
+    delete bus;
+}
+
+// Vertical blank NMI handler starting a sprite DMA, as games usually do
+static const uint8_t nmiHandler[] = {
+    0x48,             // PHA
+    0xA9, 0x07,       // LDA #$07
+    0x8D, 0x14, 0x40, // STA $4014
+    0x68,             // PLA
+    0x40,             // RTI
+};
+
+// Runs the NES bus frame by frame, scheduling the vertical blank NMI the PPU would raise
+struct FrameEngine {
+    static constexpr uint64_t FRAME_CYCLES = 29781; // NTSC frame, in CPU clock cycles
+    static constexpr uint64_t VBLANK_CYCLE = 27394; // Start of scanline 241
+
+    Bus &bus;
+
+    uint64_t RunCycles(uint64_t budget) {
+        NES6502<Bus> &cpu = bus.GetCpu();
+        uint64_t targetCycle = cpu.GetCycleCount() + budget;
+
+        while (cpu.GetCycleCount() < targetCycle) {
+            uint64_t frameStart = cpu.GetCycleCount();
+            bus.ScheduleEvent(EventType::NMI, frameStart + VBLANK_CYCLE);
+            bus.RunUntil(std::min(frameStart + FRAME_CYCLES, targetCycle));
+        }
+
+        return cpu.GetCycleCount() - targetCycle;
+    }
+};
+
+// Same loop on the NES bus, interrupted every frame by the NMI handler above through the event
+// scheduler (to be compared with jit-off, the same loop without events)
+static void BenchEvents() {
+    Bus *bus = new Bus;
+    LoadProgram(*bus, aluProgram, sizeof(aluProgram));
+    for (uint16_t i = 0; i < sizeof(nmiHandler); i++)
+        bus->WriteRam(0x0300 + i, nmiHandler[i]);
+
+    bus->WriteRam(0xFFFA, 0x00);
+    bus->WriteRam(0xFFFB, 0x03);
+
+    FrameEngine engine = {*bus};
+    RunCpu("events", bus->GetCpu(), engine, 500'000'000);
+
+    delete bus;
+}
+
+// Same loop on the NES bus, through the interpreter then the JIT
+static void BenchJit() {
+    Bus *bus = new Bus;
+    LoadProgram(*bus, aluProgram, sizeof(aluProgram));
+
+    RunCpu("jit-off", bus->GetCpu(), 500'000'000);
+
+    NES6502Jit<Bus> *jit = new NES6502Jit<Bus>(bus);
+    RunCpu("jit-on", bus->GetCpu(), *jit, 2'000'000'000);
+
+    delete jit;
+    delete bus;
+}
+
+// Same loop through the JIT, checked against the interpreter after every block
+static void BenchJitCheck() {
+    Bus *bus = new Bus, *referenceBus = new Bus;
+    LoadProgram(*bus, aluProgram, sizeof(aluProgram));
+    LoadProgram(*referenceBus, aluProgram, sizeof(aluProgram));
+    referenceBus->GetCpu().Reset();
+
+    NES6502Jit<Bus> *jit = new NES6502Jit<Bus>(bus);
+    jit->EnableDifferential(referenceBus);
+    bus->GetCpu().Reset();
+    bus->RunCycles(*jit, 10'000'000);
+
+    if (jit->HasDiverged())
+        std::cout << "jit-check: diverged after the block at $" << std::hex
+                  << jit->GetDivergencePc() << std::dec << "\n";
+    else
+        std::cout << "jit-check: " << jit->GetNativeBlockCount() << " native blocks, "
+                  << jit->GetInterpretedInstructionCount() << " interpreted instructions\n";
+
+    delete jit;
+    delete referenceBus;
+    delete bus;
+}
+
+// Same loop and NMI handler through the JIT, driven by the bus's event loop, checked against the
+// interpreter (taking the same NMIs) after every block
+static void BenchJitEvents() {
+    const unsigned int FRAMES = 600;
+
+    Bus *bus = new Bus, *referenceBus = new Bus;
+    for (Bus *machine : {bus, referenceBus}) {
+        LoadProgram(*machine, aluProgram, sizeof(aluProgram));
+        for (uint16_t i = 0; i < sizeof(nmiHandler); i++)
+            machine->WriteRam(0x0300 + i, nmiHandler[i]);
+
+        machine->WriteRam(0xFFFA, 0x00);
+        machine->WriteRam(0xFFFB, 0x03);
+        machine->GetCpu().Reset();
+    }
+
+    NES6502Jit<Bus> *jit = new NES6502Jit<Bus>(bus);
+    jit->EnableDifferential(referenceBus);
+    for (unsigned int frame = 0; frame < FRAMES && !jit->HasDiverged(); frame++) {
+        uint64_t frameStart = bus->GetCpu().GetCycleCount();
+        for (Bus *machine : {bus, referenceBus})
+            machine->ScheduleEvent(EventType::NMI, frameStart + FrameEngine::VBLANK_CYCLE);
+        bus->RunUntil(*jit, frameStart + FrameEngine::FRAME_CYCLES);
+    }
+
+    // Both machines up to the same cycle
+    referenceBus->RunUntil(bus->GetCpu().GetCycleCount());
+    bool identical = true;
+    for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+        identical &= bus->ReadRam(addr, true) == referenceBus->ReadRam(addr, true);
+
+    if (jit->HasDiverged())
+        std::cout << "jit-events: diverged after the block at $" << std::hex
+                  << jit->GetDivergencePc() << std::dec << "\n";
+    else
+        std::cout << "jit-events: " << FRAMES << " frames "
+                  << (identical ? "identical" : "different") << " to the interpreter's, "
+                  << jit->GetNativeBlockCount() << " native blocks, "
+                  << jit->GetInterpretedInstructionCount() << " interpreted instructions\n";
+
+    delete jit;
+    delete referenceBus;
+    delete bus;
+}
+
+// NROM program rendering every frame, at $8000: enables rendering and the vertical blank NMI
+// once the PPU is warmed up, then keeps moving the sprites around
+static const uint8_t renderingProgram[] = {
+    0x78,             // SEI
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8001
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8006
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0xA9, 0x1E,       // LDA #$1E
+    0x8D, 0x01, 0x20, // STA $2001
+    0xBD, 0x00, 0x07, // LDA $0700,X
+    0x69, 0x17,       // ADC #$17
+    0x9D, 0x00, 0x07, // STA $0700,X
+    0xE8,             // INX
+    0x4C, 0x15, 0x80, // JMP $8015
+};
+
+// Its NMI handler, at $8021: sprite DMA from $0700 and scrolling
+static const uint8_t renderingNmiHandler[] = {
+    0x48,             // PHA
+    0xA9, 0x07,       // LDA #$07
+    0x8D, 0x14, 0x40, // STA $4014
+    0xE6, 0x00,       // INC $00
+    0xA5, 0x00,       // LDA $00
+    0x8D, 0x05, 0x20, // STA $2005
+    0x8D, 0x05, 0x20, // STA $2005
+    0x68,             // PLA
+    0x40,             // RTI
+};
+
+// Variant of the program, at $8040, also logging PPUSTATUS (vertical blank, sprite 0 hits and
+// sprite overflow, as observed by the CPU) to $0600 - $06FF
+static const uint8_t statusProgram[] = {
+    0x78,             // SEI
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8041
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8046
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0xA9, 0x1E,       // LDA #$1E
+    0x8D, 0x01, 0x20, // STA $2001
+    0xAD, 0x02, 0x20, // LDA $2002
+    0x9D, 0x00, 0x06, // STA $0600,X
+    0xBD, 0x00, 0x07, // LDA $0700,X
+    0x69, 0x17,       // ADC #$17
+    0x9D, 0x00, 0x07, // STA $0700,X
+    0xE8,             // INX
+    0x4C, 0x55, 0x80, // JMP $8055
+};
+
+// Variant of the program, at $8060, waiting for the NMI handler in an idle loop between frames
+// (see NES6502::SkipIdleLoop), moving sprite 0 once per frame
+static const uint8_t idleProgram[] = {
+    0x78,             // SEI
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8061
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $8066
+    0xA9, 0x80,       // LDA #$80
+    0x8D, 0x00, 0x20, // STA $2000
+    0xA9, 0x1E,       // LDA #$1E
+    0x8D, 0x01, 0x20, // STA $2001
+    0xA5, 0x00,       // LDA $00
+    0xC5, 0x01,       // CMP $01
+    0xF0, 0xFA,       // BEQ $8075
+    0x85, 0x01,       // STA $01
+    0xEE, 0x00, 0x07, // INC $0700
+    0x4C, 0x75, 0x80, // JMP $8075
+};
+
+// Variant of the program, at $80A0, without NMI: polls PPUSTATUS for the vertical blank (its
+// sprite 0 hit flag changing meanwhile), then logs the status read to $0600 - $06FF and moves
+// sprite 0 through a sprite DMA
+static const uint8_t pollingProgram[] = {
+    0x78,             // SEI
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $80A1
+    0x2C, 0x02, 0x20, // BIT $2002
+    0x10, 0xFB,       // BPL $80A6
+    0xA9, 0x1E,       // LDA #$1E
+    0x8D, 0x01, 0x20, // STA $2001
+    0xAD, 0x02, 0x20, // LDA $2002
+    0x10, 0xFB,       // BPL $80B0
+    0x9D, 0x00, 0x06, // STA $0600,X
+    0xE8,             // INX
+    0xA9, 0x07,       // LDA #$07
+    0x8D, 0x14, 0x40, // STA $4014
+    0xEE, 0x00, 0x07, // INC $0700
+    0xEE, 0x03, 0x07, // INC $0703
+    0x4C, 0xB0, 0x80, // JMP $80B0
+};
+
+// Loads the given iNES image through a temporary file
+static bool LoadCartridgeImage(Cartridge &cartridge, const std::vector<uint8_t> &image) {
+    char path[] = "/tmp/nesem-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+
+    bool written = write(fd, image.data(), image.size()) == (ssize_t)image.size();
+    close(fd);
+
+    bool loaded = written && cartridge.Load(path);
+    unlink(path); // Still mapped by the cartridge
+    return loaded;
+}
+
+// Loads the NROM image of the programs above (16 KiB PRG-ROM, 8 KiB of patterns as CHR-ROM, or
+// 8 KiB of CHR-RAM left blank), starting with the one at the given address
+static bool LoadRenderingCartridge(Cartridge &cartridge, uint16_t entry = 0x8000,
+                                   bool chrRam = false) {
+    const size_t PRG_SIZE = 16 * 1024, CHR_SIZE = chrRam ? 0 : 8 * 1024;
+
+    std::vector<uint8_t> image = {'N', 'E', 'S', 0x1A, 1, !chrRam, 0x01, 0,
+                                  0,   0,   0,   0,    0, 0,       0,    0};
+    image.resize(image.size() + PRG_SIZE, 0xEA);
+    uint8_t *prg = image.data() + 16;
+
+    std::memcpy(prg, renderingProgram, sizeof(renderingProgram));
+    std::memcpy(prg + 0x21, renderingNmiHandler, sizeof(renderingNmiHandler));
+    std::memcpy(prg + 0x40, statusProgram, sizeof(statusProgram));
+    std::memcpy(prg + 0x60, idleProgram, sizeof(idleProgram));
+    std::memcpy(prg + 0xA0, pollingProgram, sizeof(pollingProgram));
+    const uint8_t vectors[] = {0x21, 0x80, (uint8_t)entry, (uint8_t)(entry >> 8),
+                               0x32, 0x80}; // NMI, reset, IRQ (RTI)
+    std::memcpy(prg + PRG_SIZE - sizeof(vectors), vectors, sizeof(vectors));
+
+    for (size_t i = 0; i < CHR_SIZE; i++)
+        image.push_back((i * 37) ^ (i >> 5));
+
+    return LoadCartridgeImage(cartridge, image);
+}
+
+// Program above on the NES bus, the PPU rendering every frame, only caught up when accessed
+// (compared with the dots a lockstep PPU would be stepped through)
+static void BenchPpu() {
+    Cartridge cartridge;
+    if (!LoadRenderingCartridge(cartridge)) {
+        std::cout << "ppu: cannot write the cartridge image\n";
+        return;
+    }
+
+    Bus *bus = new Bus;
+    bus->InsertCartridge(&cartridge);
+
+    RunCpu("ppu", bus->GetCpu(), *bus, 200'000'000);
+
+    const NES2C02 &ppu = bus->GetPpu();
+    std::cout << "ppu: " << ppu.GetCatchUpCount() / ppu.GetFrameCount() << " catch-ups and "
+              << ppu.GetSpanCount() / ppu.GetFrameCount() << " spans per frame, for "
+              << PpuTiming::DOTS_PER_FRAME << " dots\n";
+
+    delete bus;
+}
+
+// Frames of the status logging program skipped in runs of 6 out of 8, checked against a machine
+// rendering all of them for the same CPU-visible state (RAM, cycle counts) after each frame, and
+// for the same frame buffer after rendered ones. Then the program above with all frames
+// rendered or skipped.
+static void BenchRenderSkip() {
+    const unsigned int FRAMES = 2000;
+
+    Cartridge cartridge, statusCartridge;
+    if (!LoadRenderingCartridge(cartridge) || !LoadRenderingCartridge(statusCartridge, 0x8040)) {
+        std::cout << "render-skip: cannot write the cartridge image\n";
+        return;
+    }
+
+    Bus *bus = new Bus, *referenceBus = new Bus;
+    bus->InsertCartridge(&statusCartridge);
+    referenceBus->InsertCartridge(&statusCartridge);
+    bus->GetCpu().Reset();
+    referenceBus->GetCpu().Reset();
+
+    unsigned int frame;
+    bool identical = true;
+    for (frame = 0; identical && frame < FRAMES; frame++) {
+        bus->GetPpu().SetRenderSkip(frame % 8 < 6);
+
+        // Up to the next vertical blank
+        uint64_t vblank = PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount());
+        bus->RunUntil(vblank + 1);
+        referenceBus->RunUntil(vblank + 1);
+
+        identical = bus->GetCpu().GetCycleCount() == referenceBus->GetCpu().GetCycleCount();
+        for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+            identical &= bus->ReadRam(addr, true) == referenceBus->ReadRam(addr, true);
+        if (frame % 8 == 7)
+            identical &= std::memcmp(bus->GetPpu().GetFrameBuffer(),
+                                     referenceBus->GetPpu().GetFrameBuffer(),
+                                     NES2C02::SCREEN_WIDTH * NES2C02::SCREEN_HEIGHT) == 0;
+    }
+
+    if (!identical)
+        std::cout << "render-skip: diverged at frame " << frame - 1 << "\n";
+    else
+        std::cout << "render-skip: " << FRAMES << " frames identical to rendered ones\n";
+
+    delete referenceBus;
+    delete bus;
+
+    for (bool skip : {false, true}) {
+        bus = new Bus;
+        bus->InsertCartridge(&cartridge);
+        bus->GetPpu().SetRenderSkip(skip);
+        RunCpu(skip ? "render-skip (skipped)" : "render-skip (rendered)", bus->GetCpu(), *bus,
+               200'000'000);
+        delete bus;
+    }
+}
+
+// Idle loop programs (waiting for the NMI handler, polling PPUSTATUS) with and without idle
+// loop skipping, checked for the same state (RAM, cycle counts, frame buffer) after each frame,
+// then timed. Skipping is also checked to be off for the cartridges listed as exceptions.
+static void BenchIdleLoop() {
+    const unsigned int FRAMES = 600;
+
+    struct Program {
+        const char *name;
+        uint16_t entry;
+    };
+
+    for (Program program : {Program{"idle-loop", 0x8060}, Program{"idle-loop (polling)", 0x80A0}}) {
+        Cartridge cartridge;
+        if (!LoadRenderingCartridge(cartridge, program.entry)) {
+            std::cout << program.name << ": cannot write the cartridge image\n";
+            return;
+        }
+
+        Bus *bus = new Bus, *referenceBus = new Bus;
+        bus->InsertCartridge(&cartridge);
+        referenceBus->InsertCartridge(&cartridge);
+        referenceBus->GetCpu().SetIdleLoopSkipping(false);
+        bus->GetCpu().Reset();
+        referenceBus->GetCpu().Reset();
+
+        unsigned int frame;
+        bool identical = true;
+        for (frame = 0; identical && frame < FRAMES; frame++) {
+            // Registers included right before the vertical blank, where the loops are left
+            uint64_t vblank = PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount());
+            for (uint64_t target : {vblank, vblank + 1}) {
+                bus->RunUntil(target);
+                referenceBus->RunUntil(target);
+                identical &= bus->GetCpu().MatchesState(referenceBus->GetCpu());
+            }
+
+            identical &= std::memcmp(bus->GetPpu().GetFrameBuffer(),
+                                     referenceBus->GetPpu().GetFrameBuffer(),
+                                     NES2C02::SCREEN_WIDTH * NES2C02::SCREEN_HEIGHT) == 0;
+            for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+                identical &= bus->ReadRam(addr, true) == referenceBus->ReadRam(addr, true);
+        }
+
+        if (!identical)
+            std::cout << program.name << ": diverged at frame " << frame - 1 << "\n";
+        else
+            std::cout << program.name << ": " << FRAMES << " frames identical, "
+                      << bus->GetCpu().GetIdleCycleCount() * 100 / bus->GetCpu().GetCycleCount()
+                      << "% of the cycles skipped\n";
+
+        delete referenceBus;
+        delete bus;
+
+        for (bool skipping : {false, true}) {
+            bus = new Bus;
+            bus->InsertCartridge(&cartridge);
+            bus->GetCpu().SetIdleLoopSkipping(skipping);
+            RunCpu((std::string(program.name) + (skipping ? " (skipped)" : " (run)")).c_str(),
+                   bus->GetCpu(), *bus, 200'000'000);
+            delete bus;
+        }
+    }
+
+    // A cartridge listed (CHR-RAM, so that its image is none of the ones above)
+    Cartridge cartridge, listedCartridge;
+    if (!LoadRenderingCartridge(cartridge, 0x80A0) ||
+        !LoadRenderingCartridge(listedCartridge, 0x80A0, true)) {
+        std::cout << "idle-loop: cannot write the cartridge image\n";
+        return;
+    }
+    AddIdleLoopSkippingException(listedCartridge.GetHash());
+
+    Bus *bus = new Bus, *listedBus = new Bus;
+    bus->InsertCartridge(&cartridge);
+    listedBus->InsertCartridge(&listedCartridge);
+    std::unique_ptr<Bus> listedClone = listedBus->Clone();
+
+    if (bus->GetCpu().IsIdleLoopSkipping() && !listedBus->GetCpu().IsIdleLoopSkipping() &&
+        !listedClone->GetCpu().IsIdleLoopSkipping())
+        std::cout << "idle-loop: off for the cartridge listed and its clones only\n";
+    else
+        std::cout << "idle-loop: not set from the cartridges listed\n";
+
+    delete listedBus;
+    delete bus;
+}
+
+// Status logging program restored from a snapshot onto a second machine, both then run for the
+// same state (RAM, cycle counts, frame buffer) after each frame, then snapshot and restore timed
+static void BenchSnapshot() {
+    const unsigned int FRAMES = 600, ROUNDS = 100'000;
+
+    Cartridge cartridge, otherCartridge;
+    if (!LoadRenderingCartridge(cartridge, 0x8040) || !LoadRenderingCartridge(otherCartridge)) {
+        std::cout << "snapshot: cannot write the cartridge image\n";
+        return;
+    }
+
+    Bus *bus = new Bus, *restoredBus = new Bus, *otherBus = new Bus;
+    bus->InsertCartridge(&cartridge);
+    restoredBus->InsertCartridge(&cartridge);
+    otherBus->InsertCartridge(&otherCartridge);
+    bus->GetCpu().Reset();
+    bus->RunCycles(10 * PpuTiming::DOTS_PER_FRAME / 3);
+
+    MachineState *state = new MachineState;
+    bool saved = bus->Snapshot(*state);
+    bool restored = saved && restoredBus->Restore(*state);
+    bool refused = !otherBus->Restore(*state);
+
+    unsigned int frame;
+    bool identical = restored;
+    for (frame = 0; identical && frame < FRAMES; frame++) {
+        uint64_t vblank = PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount());
+        bus->RunUntil(vblank + 1);
+        restoredBus->RunUntil(vblank + 1);
+
+        identical = bus->GetCpu().GetCycleCount() == restoredBus->GetCpu().GetCycleCount() &&
+                    std::memcmp(bus->GetPpu().GetFrameBuffer(),
+                                restoredBus->GetPpu().GetFrameBuffer(),
+                                NES2C02::SCREEN_WIDTH * NES2C02::SCREEN_HEIGHT) == 0;
+        for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+            identical &= bus->ReadRam(addr, true) == restoredBus->ReadRam(addr, true);
+    }
+
+    if (!restored)
+        std::cout << "snapshot: not restored\n";
+    else if (!identical)
+        std::cout << "snapshot: diverged at frame " << frame - 1 << "\n";
+    else
+        std::cout << "snapshot: " << FRAMES << " frames identical after restoring, "
+                  << (refused ? "refused" : "restored") << " for another cartridge\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUNDS; i++) {
+        bus->Snapshot(*state);
+        bus->Restore(*state);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "snapshot: " << sizeof(MachineState) / 1024 << " KiB, save + load in "
+              << std::chrono::duration<double, std::micro>(end - start).count() / ROUNDS
+              << " us\n";
+
+    delete state;
+    delete otherBus;
+    delete restoredBus;
+    delete bus;
+}
+
+// Whether the RAM and PRG-RAM held by the given state are those of the given machine
+static bool MatchesMemory(Bus &bus, const MachineState &state) {
+    bool identical = true;
+    for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+        identical &= state.ram[addr] == bus.ReadRam(addr, true);
+    for (uint16_t addr = 0x6000; addr < 0x8000; addr++)
+        identical &= state.prgRam[addr - 0x6000] == bus.ReadRam(addr, true);
+
+    return identical;
+}
+
+// Incremental snapshots of the status logging program after each frame, and of the ALU loop run
+// through the JIT, checked against the memory they were taken from. Then timed against full
+// snapshots of a second machine, after each frame as well.
+static void BenchSnapshotIncremental() {
+    const unsigned int FRAMES = 600, JIT_ROUNDS = 1000;
+
+    Cartridge cartridge;
+    if (!LoadRenderingCartridge(cartridge, 0x8040)) {
+        std::cout << "snapshot-incremental: cannot write the cartridge image\n";
+        return;
+    }
+
+    Bus *bus = new Bus, *fullBus = new Bus;
+    bus->InsertCartridge(&cartridge);
+    fullBus->InsertCartridge(&cartridge);
+    bus->GetCpu().Reset();
+    fullBus->GetCpu().Reset();
+
+    MachineState *state = new MachineState, *fullState = new MachineState;
+    bus->Snapshot(*state);
+
+    bool identical = true;
+    std::chrono::steady_clock::duration incrementalTime{}, fullTime{};
+    for (unsigned int frame = 0; frame < FRAMES; frame++) {
+        uint64_t vblank = PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount());
+        bus->RunUntil(vblank + 1);
+        fullBus->RunUntil(vblank + 1);
+
+        auto start = std::chrono::steady_clock::now();
+        bus->SnapshotIncremental(*state);
+        auto middle = std::chrono::steady_clock::now();
+        fullBus->Snapshot(*fullState);
+        auto end = std::chrono::steady_clock::now();
+
+        incrementalTime += middle - start;
+        fullTime += end - middle;
+        identical &= MatchesMemory(*bus, *state);
+    }
+
+    Bus *jitBus = new Bus;
+    LoadProgram(*jitBus, aluProgram, sizeof(aluProgram));
+    jitBus->GetCpu().Reset();
+    NES6502Jit<Bus> *jit = new NES6502Jit<Bus>(jitBus);
+    jitBus->Snapshot(*state);
+    for (unsigned int i = 0; i < JIT_ROUNDS; i++) {
+        jit->RunCycles(10'000);
+        jitBus->SnapshotIncremental(*state);
+        identical &= MatchesMemory(*jitBus, *state);
+    }
+
+    std::cout << "snapshot-incremental: " << (identical ? "identical" : "different")
+              << " to the memory saved, "
+              << std::chrono::duration<double, std::micro>(incrementalTime).count() / FRAMES
+              << " us per frame vs "
+              << std::chrono::duration<double, std::micro>(fullTime).count() / FRAMES
+              << " us for a full save\n";
+
+    delete jit;
+    delete jitBus;
+    delete fullState;
+    delete state;
+    delete fullBus;
+    delete bus;
+}
+
+// Status logging program cloned mid-run, the machine and its clone then run for the same state
+// after each frame, with either CHR-ROM or CHR-RAM. Then the memory left shared (RAM, PRG-RAM,
+// CHR-RAM) written by each, the machine destroyed first. Then cloning timed against restoring
+// a snapshot onto a new machine.
+static void BenchClone() {
+    const unsigned int FRAMES = 600, ROUNDS = 1000;
+
+    Cartridge cartridge, chrRamCartridge;
+    if (!LoadRenderingCartridge(cartridge, 0x8040) ||
+        !LoadRenderingCartridge(chrRamCartridge, 0x8040, true)) {
+        std::cout << "clone: cannot write the cartridge image\n";
+        return;
+    }
+
+    bool identical = true, separate = true;
+    for (Cartridge *inserted : {&cartridge, &chrRamCartridge}) {
+        Bus *bus = new Bus;
+        bus->InsertCartridge(inserted);
+        bus->GetCpu().Reset();
+        bus->RunCycles(10 * PpuTiming::DOTS_PER_FRAME / 3);
+
+        std::unique_ptr<Bus> clone = bus->Clone();
+        for (unsigned int frame = 0; frame < FRAMES; frame++) {
+            uint64_t vblank = PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount());
+            bus->RunUntil(vblank + 1);
+            clone->RunUntil(vblank + 1);
+
+            // The frame cloned mid-way only rendered from then on
+            identical &= bus->GetCpu().GetCycleCount() == clone->GetCpu().GetCycleCount() &&
+                         (frame == 0 || std::memcmp(bus->GetPpu().GetFrameBuffer(),
+                                                    clone->GetPpu().GetFrameBuffer(),
+                                                    NES2C02::SCREEN_WIDTH *
+                                                        NES2C02::SCREEN_HEIGHT) == 0);
+            for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+                identical &= bus->ReadRam(addr, true) == clone->ReadRam(addr, true);
+        }
+
+        // Untouched by the program, at the start of vertical blank: $0500, $6000, and the
+        // first byte of the pattern tables through PPUDATA
+        for (Bus *machine : {bus, clone.get()}) {
+            uint8_t data = machine == bus ? 0x55 : 0xAA;
+            machine->WriteRam(0x0500, data);
+            machine->WriteRam(0x6000, data);
+            machine->WriteRam(0x2006, 0x00);
+            machine->WriteRam(0x2006, 0x00);
+            machine->WriteRam(0x2007, data);
+        }
+        for (Bus *machine : {bus, clone.get()}) {
+            uint8_t data = machine == bus ? 0x55 : 0xAA;
+            separate &= machine->ReadRam(0x0500, true) == data &&
+                        machine->ReadRam(0x6000, true) == data &&
+                        (!machine->GetChrRam() || machine->GetChrRam()[0] == data);
+        }
+
+        delete bus;
+        clone->RunCycles(PpuTiming::DOTS_PER_FRAME / 3);
+    }
+
+    std::cout << "clone: " << FRAMES << " frames " << (identical ? "identical" : "different")
+              << " to the machine cloned, memory written " << (separate ? "separate" : "shared")
+              << " afterwards\n";
+
+    // One machine at a time, run for a frame then dropped, as when exploring futures
+    Bus *bus = new Bus;
+    bus->InsertCartridge(&cartridge);
+    bus->GetCpu().Reset();
+    bus->RunCycles(10 * PpuTiming::DOTS_PER_FRAME / 3);
+    MachineState *state = new MachineState;
+    bus->Snapshot(*state);
+
+    std::chrono::steady_clock::duration cloneTime{}, restoreTime{}, frameTime{};
+    for (unsigned int round = 0; round < ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<Bus> clone = bus->Clone();
+        auto middle = std::chrono::steady_clock::now();
+        clone->RunCycles(PpuTiming::DOTS_PER_FRAME / 3);
+        auto end = std::chrono::steady_clock::now();
+        cloneTime += middle - start;
+        frameTime += end - middle;
+        clone.reset();
+
+        start = std::chrono::steady_clock::now();
+        std::unique_ptr<Bus> restored = std::make_unique<Bus>();
+        restored->InsertCartridge(&cartridge);
+        restored->Restore(*state);
+        restoreTime += std::chrono::steady_clock::now() - start;
+    }
+
+    std::cout << "clone: " << std::chrono::duration<double, std::micro>(cloneTime).count() / ROUNDS
+              << " us per clone vs "
+              << std::chrono::duration<double, std::micro>(restoreTime).count() / ROUNDS
+              << " us for a new machine restored from a snapshot, then "
+              << std::chrono::duration<double, std::micro>(frameTime).count() / ROUNDS
+              << " us for a frame\n";
+
+    delete state;
+    delete bus;
+}
+
+// Status logging program run 1 to 3 frames ahead, checked after each host frame against a
+// machine run without (same RAM and cycle counts, the state being restored), and for the frame
+// presented against one run as many frames ahead from the start. Then host frames of the
+// program above timed against the NES's frame time, for 0 to 3 frames ahead.
+static void BenchRunAhead() {
+    const unsigned int FRAMES = 600;
+
+    Cartridge cartridge, statusCartridge;
+    if (!LoadRenderingCartridge(cartridge) || !LoadRenderingCartridge(statusCartridge, 0x8040)) {
+        std::cout << "run-ahead: cannot write the cartridge image\n";
+        return;
+    }
+
+    auto runFrame = [](Bus &bus) {
+        bus.RunUntil(PpuTiming::FindVblankStart(bus.GetCpu().GetCycleCount()) + 1);
+    };
+
+    bool identical = true;
+    for (unsigned int ahead = 1; ahead <= 3; ahead++) {
+        Bus *bus = new Bus, *laggingBus = new Bus, *aheadBus = new Bus;
+        for (Bus *machine : {bus, laggingBus, aheadBus}) {
+            machine->InsertCartridge(&statusCartridge);
+            machine->GetCpu().Reset();
+        }
+        for (unsigned int frame = 0; frame < ahead; frame++)
+            runFrame(*aheadBus);
+
+        RunAhead<Bus> runAhead(*bus, ahead);
+        for (unsigned int frame = 0; identical && frame < FRAMES; frame++) {
+            const uint8_t *frameBuffer = runAhead.RunFrame();
+            runFrame(*laggingBus);
+            runFrame(*aheadBus);
+
+            identical = bus->GetCpu().GetCycleCount() == laggingBus->GetCpu().GetCycleCount() &&
+                        std::memcmp(frameBuffer, aheadBus->GetPpu().GetFrameBuffer(),
+                                    NES2C02::SCREEN_WIDTH * NES2C02::SCREEN_HEIGHT) == 0;
+            for (uint16_t addr = 0x0000; addr < 0x0800; addr++)
+                identical &= bus->ReadRam(addr, true) == laggingBus->ReadRam(addr, true);
+        }
+
+        delete aheadBus;
+        delete laggingBus;
+        delete bus;
+    }
+
+    std::cout << "run-ahead: " << FRAMES << " host frames "
+              << (identical ? "identical" : "different")
+              << " to the machines run without and ahead\n";
+
+    for (unsigned int ahead = 0; ahead <= 3; ahead++) {
+        Bus *bus = new Bus;
+        bus->InsertCartridge(&cartridge);
+        bus->GetCpu().Reset();
+
+        RunAhead<Bus> runAhead(*bus, ahead);
+        for (unsigned int frame = 0; frame < FRAMES; frame++)
+            runAhead.RunFrame();
+
+        using Microseconds = std::chrono::duration<double, std::micro>;
+        const RunAhead<Bus>::FrameTiming &worst = runAhead.GetWorstTiming();
+        double average = Microseconds(runAhead.GetAverageTime()).count();
+        std::cout << "run-ahead (" << ahead << " frames): " << average << " us per host frame ("
+                  << 100 * average / Microseconds(RunAhead<Bus>::FRAME_BUDGET).count()
+                  << "% of the budget), " << Microseconds(worst.GetTotal()).count()
+                  << " us at worst (snapshot " << Microseconds(worst.snapshot).count()
+                  << " us, restore " << Microseconds(worst.restore).count() << " us), "
+                  << runAhead.GetOverBudgetCount() << " over budget\n";
+
+        delete bus;
+    }
+}
+
+// Delta encoding kernels checked against each other on random buffers with sparse changes. Then
+// 60 s of history of the status logging program, stepped back through and checked against full
+// snapshots taken every 100 frames, the machine being restored to the oldest one and run again.
+static void BenchRewind() {
+    const unsigned int ROUNDS = 20'000, FRAMES = 3600, REFERENCE_PERIOD = 100;
+    const size_t BYTE_CAPACITY = 4 * 1024 * 1024;
+
+    uint32_t seed = 1;
+    auto random = [&seed]() { return (seed = seed * 1103515245 + 12345) >> 16; };
+
+    std::vector<uint8_t> original(8192), previous(8192), scalarPrevious(8192), current(8192);
+    std::vector<uint8_t> scalarDelta(RewindBuffer::MaxDeltaSize(8192));
+    std::vector<uint8_t> delta(scalarDelta.size());
+    uint64_t mismatches = 0;
+    for (unsigned int round = 0; round < ROUNDS; round++) {
+        size_t size = 1 + random() % 8191;
+        for (size_t i = 0; i < size; i++)
+            previous[i] = current[i] = random();
+        for (unsigned int changes = random() % 64; changes; changes--)
+            current[random() % size] ^= 1 << (random() % 8);
+        if (round % 16 == 0) // Long zero and literal runs
+            std::memset(current.data() + random() % (size - size / 4), random(), size / 4);
+        original = scalarPrevious = previous;
+
+        size_t deltaSize =
+            RewindBuffer::EncodeDelta(previous.data(), current.data(), size, delta.data());
+        size_t scalarSize = RewindBuffer::EncodeDeltaScalar(scalarPrevious.data(), current.data(),
+                                                            size, scalarDelta.data());
+        bool updated = std::memcmp(previous.data(), current.data(), size) == 0;
+        RewindBuffer::ApplyDelta(previous.data(), size, delta.data());
+        mismatches += deltaSize != scalarSize || !updated ||
+                      std::memcmp(delta.data(), scalarDelta.data(), deltaSize) != 0 ||
+                      std::memcmp(previous.data(), original.data(), size) != 0;
+    }
+    std::cout << "rewind: " << mismatches << " mismatches in " << ROUNDS
+              << " rounds of delta encoding\n";
+
+    Cartridge cartridge;
+    if (!LoadRenderingCartridge(cartridge, 0x8040)) {
+        std::cout << "rewind: cannot write the cartridge image\n";
+        return;
+    }
+
+    Bus *bus = new Bus;
+    bus->InsertCartridge(&cartridge);
+    bus->GetCpu().Reset();
+
+    // Along with histories short of memory or frames, wrapping around
+    RewindBuffer *rewind = new RewindBuffer(FRAMES, BYTE_CAPACITY);
+    RewindBuffer *smallRewind = new RewindBuffer(FRAMES, BYTE_CAPACITY / 16);
+    RewindBuffer *shortRewind = new RewindBuffer(FRAMES / 8, BYTE_CAPACITY);
+    MachineState *state = new MachineState;
+    std::vector<uint8_t> references;
+
+    std::chrono::steady_clock::duration pushTime{};
+    for (unsigned int frame = 0; frame < FRAMES; frame++) {
+        bus->RunUntil(PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount()) + 1);
+        bus->Snapshot(*state);
+
+        auto start = std::chrono::steady_clock::now();
+        rewind->Push(*state);
+        pushTime += std::chrono::steady_clock::now() - start;
+        smallRewind->Push(*state);
+        shortRewind->Push(*state);
+
+        if (frame % REFERENCE_PERIOD == REFERENCE_PERIOD - 1)
+            references.insert(references.end(), (const uint8_t *)state,
+                              (const uint8_t *)(state + 1));
+    }
+
+    std::cout << "rewind: " << rewind->GetFrameCount() << " frames in "
+              << rewind->GetDeltaBytes() / 1024 << " KiB of deltas ("
+              << rewind->GetDeltaBytes() / (rewind->GetFrameCount() - 1) << " bytes per frame), "
+              << std::chrono::duration<double, std::micro>(pushTime).count() / FRAMES
+              << " us per push\n";
+
+    // Back to each reference held, the first one being the state pushed last. Returns the
+    // index of the oldest one.
+    bool identical = true;
+    unsigned int steps = 0;
+    std::chrono::steady_clock::duration stepTime{};
+    auto stepBack = [&](RewindBuffer &history) {
+        unsigned int reference = FRAMES / REFERENCE_PERIOD - 1;
+        for (;;) {
+            identical &= std::memcmp(&history.GetState(),
+                                     &references[reference * sizeof(MachineState)],
+                                     sizeof(MachineState)) == 0;
+            if (reference == 0 || history.GetFrameCount() <= REFERENCE_PERIOD)
+                return reference;
+
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < REFERENCE_PERIOD; i++)
+                history.StepBack();
+            stepTime += std::chrono::steady_clock::now() - start;
+            steps += REFERENCE_PERIOD;
+            reference--;
+        }
+    };
+
+    std::cout << "rewind: " << smallRewind->GetFrameCount() << " frames held in "
+              << BYTE_CAPACITY / 16 / 1024 << " KiB, " << shortRewind->GetFrameCount()
+              << " of " << FRAMES / 8 << "\n";
+    stepBack(*smallRewind);
+    stepBack(*shortRewind);
+    unsigned int reference = stepBack(*rewind);
+
+    // Then forward again from the oldest one
+    bool restored = bus->Restore(rewind->GetState());
+    for (unsigned int i = 0; i < REFERENCE_PERIOD; i++)
+        bus->RunUntil(PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount()) + 1);
+    const MachineState &next =
+        *(const MachineState *)&references[(reference + 1) * sizeof(MachineState)];
+    identical &= restored && MatchesMemory(*bus, next) &&
+                 bus->GetCpu().GetCycleCount() == next.cpu.registers.clockCount;
+
+    std::cout << "rewind: " << (identical ? "identical" : "different")
+              << " to the references stepped back to, "
+              << std::chrono::duration<double, std::micro>(stepTime).count() / steps
+              << " us per frame back\n";
+
+    delete shortRewind;
+    delete smallRewind;
+    delete state;
+    delete rewind;
+    delete bus;
+}
+
+// MMC3 program counting its scanline IRQs, at $E000 of the last bank: waits for them with
+// interrupts enabled, the handler acknowledging each of them
+static const uint8_t mmc3Program[] = {
+    0x58,             // CLI
+    0x4C, 0x01, 0xE0, // JMP $E001
+};
+
+static const uint8_t mmc3IrqHandler[] = {
+    0xE6, 0x00,       // INC $00
+    0x8D, 0x00, 0xE0, // STA $E000
+    0x8D, 0x01, 0xE0, // STA $E001
+    0x40,             // RTI
+};
+
+// Scanline IRQs every 16 A12 rises counted for 8 frames, for each PPU setup, checked against
+// the rises the setup gives: none with rendering disabled or both pattern tables the same, at
+// dot 260 or 324 otherwise. Then rendering disabled half-way (forced blank).
+static void BenchMmc3Irq() {
+    const unsigned int FRAMES = 8, PERIOD = 16;
+    const size_t PRG_SIZE = 32 * 1024, CHR_SIZE = 8 * 1024;
+
+    std::vector<uint8_t> image = {'N', 'E', 'S', 0x1A, 2, 1, 0x40, 0,
+                                  0,   0,   0,   0,    0, 0, 0,    0};
+    image.resize(image.size() + PRG_SIZE, 0xEA);
+    uint8_t *lastBank = image.data() + 16 + PRG_SIZE - 8 * 1024;
+    std::memcpy(lastBank, mmc3Program, sizeof(mmc3Program));
+    std::memcpy(lastBank + 0x10, mmc3IrqHandler, sizeof(mmc3IrqHandler));
+    const uint8_t vectors[] = {0x18, 0xE0, 0x00, 0xE0, 0x10, 0xE0}; // NMI (RTI), reset, IRQ
+    std::memcpy(lastBank + 0x1FFA, vectors, sizeof(vectors));
+    lastBank[0x18] = 0x40; // RTI
+    image.resize(image.size() + CHR_SIZE, 0);
+
+    Cartridge cartridge;
+    if (!LoadCartridgeImage(cartridge, image)) {
+        std::cout << "mmc3-irq: cannot write the cartridge image\n";
+        return;
+    }
+
+    struct Setup {
+        const char *name;
+        uint8_t ctrl, mask;
+        bool forcedBlank; // Rendering disabled after half of the frames
+    };
+    const Setup setups[] = {
+        {"rendering disabled", 0x08, 0x00, false},
+        {"background $0000, sprites $1000", 0x08, 0x18, false},
+        {"background $1000, sprites $0000", 0x10, 0x18, false},
+        {"background and sprites $0000", 0x00, 0x18, false},
+        {"background and sprites $1000", 0x18, 0x18, false},
+        {"8x16 sprites", 0x20, 0x18, false},
+        {"forced blank half-way", 0x08, 0x18, true},
+    };
+
+    bool expected = true;
+    for (const Setup &setup : setups) {
+        Bus *bus = new Bus;
+        bus->InsertCartridge(&cartridge);
+        bus->GetCpu().Reset();
+
+        // From the end of a frame on: latch, reload, IRQ enabled, then the PPU setup
+        bus->RunUntil(PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount()) + 1);
+        uint64_t start = bus->GetCpu().GetCycleCount();
+        bus->WriteRam(0xC000, PERIOD - 1);
+        bus->WriteRam(0xC001, 0x00);
+        bus->WriteRam(0xE001, 0x00);
+        bus->WriteRam(0x2000, setup.ctrl);
+        bus->WriteRam(0x2001, setup.mask);
+
+        uint64_t rises = 0, from = start;
+        uint64_t riseDot = PpuTiming::FindA12RiseDot(setup.ctrl, setup.mask);
+        for (unsigned int frame = 0; frame < FRAMES; frame++) {
+            if (setup.forcedBlank && frame == FRAMES / 2) {
+                bus->WriteRam(0x2001, 0x00);
+                rises += PpuTiming::CountA12Rises(from, bus->GetCpu().GetCycleCount(), riseDot);
+                riseDot = PpuTiming::NO_A12_RISE;
+            }
+            bus->RunUntil(PpuTiming::FindVblankStart(bus->GetCpu().GetCycleCount()) + 1);
+        }
+        if (!setup.forcedBlank)
+            rises = PpuTiming::CountA12Rises(from, bus->GetCpu().GetCycleCount(), riseDot);
+
+        // None for the rises the counter's first reload takes
+        uint8_t irqs = bus->ReadRam(0x0000, true);
+        if (irqs != rises / PERIOD) {
+            std::cout << "mmc3-irq: " << int(irqs) << " IRQs with " << setup.name
+                      << " instead of " << rises / PERIOD << "\n";
+            expected = false;
+        }
+
+        delete bus;
+    }
+
+    if (expected)
+        std::cout << "mmc3-irq: IRQs as expected for " << sizeof(setups) / sizeof(*setups)
+                  << " PPU setups (rendering, pattern tables, sprite size, forced blank)\n";
+}
+
+// SIMD kernels of the PPU checked bit for bit against the scalar ones, on random tiles, sprites
+// and spans of random lengths and alignments
+static void BenchPpuCheck() {
+#if PPUPIPELINE_SSE2
+    const unsigned int ROUNDS = 200'000, TILES = 40;
+    uint32_t seed = 1;
+    auto random = [&seed]() { return (seed = seed * 1103515245 + 12345) >> 16; };
+
+    uint8_t lowPlanes[TILES], highPlanes[TILES], palettes[TILES], palette[32];
+    uint8_t scalarPixels[TILES * 8], simdPixels[TILES * 8], sprites[TILES * 8];
+    uint8_t scalarColors[256], simdColors[256];
+    uint8_t spriteY[64];
+    uint64_t scalarMasks[256], simdMasks[256];
+    uint64_t mismatches = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int round = 0; round < ROUNDS; round++) {
+        for (unsigned int i = 0; i < TILES; i++) {
+            lowPlanes[i] = random();
+            highPlanes[i] = random();
+            palettes[i] = random() & 0x03;
+        }
+        for (uint8_t &entry : palette)
+            entry = random() & 0x3F;
+
+        // Rows, in whole batches
+        unsigned int count = random() % (TILES / PpuPipeline::TILE_BATCH + 1) *
+                             PpuPipeline::TILE_BATCH;
+        PpuPipeline::DecodeTileRowsScalar(lowPlanes, highPlanes, palettes, count, scalarPixels);
+        PpuPipeline::DecodeTileRowsSse2(lowPlanes, highPlanes, palettes, count, simdPixels);
+        mismatches += std::memcmp(scalarPixels, simdPixels, count * 8) != 0;
+
+        // Sprites of both heights, often on the same lines
+        for (uint8_t &y : spriteY)
+            y = random() & 0x01 ? random() : 0xF0 + random() % 16;
+        unsigned int height = random() & 0x01 ? 16 : 8, lineCount = random() % 257;
+        PpuPipeline::FindSpritesScalar(spriteY, height, lineCount, scalarMasks);
+        PpuPipeline::FindSpritesSse2(spriteY, height, lineCount, simdMasks);
+        mismatches += std::memcmp(scalarMasks, simdMasks, lineCount * sizeof(uint64_t)) != 0;
+
+        // Spans of decoded pixels, over sprite pixels with random priorities
+        PpuPipeline::DecodeTileRowsScalar(lowPlanes, highPlanes, palettes, TILES, scalarPixels);
+        for (unsigned int i = 0; i < TILES * 8; i++) {
+            unsigned int flags = random();
+            sprites[i] = flags & 0x01 ? scalarPixels[(i * 7 + 3) % (TILES * 8)] : 0;
+            sprites[i] |= (flags & 0x02 ? PpuPipeline::SPRITE_BEHIND : 0) |
+                          (flags & 0x0C ? 0 : PpuPipeline::SPRITE_ZERO);
+        }
+
+        unsigned int offset = random() % 64, length = random() % 257;
+        uint8_t colorMask = random() & 0x01 ? 0x30 : 0x3F;
+        bool scalarHit = PpuPipeline::ComposeScalar(scalarPixels + offset, sprites + offset,
+                                                    length, palette, colorMask, scalarColors);
+        bool simdHit = PpuPipeline::ComposeSse2(scalarPixels + offset, sprites + offset, length,
+                                                palette, colorMask, simdColors);
+        mismatches += scalarHit != simdHit || std::memcmp(scalarColors, simdColors, length) != 0;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "ppu-check: " << mismatches << " mismatches in " << ROUNDS
+              << " rounds of decoding, sprite search and composition ("
+              << std::chrono::duration<double>(end - start).count() << " s)\n";
+#else
+    std::cout << "ppu-check: scalar kernels only\n";
+#endif
+}
+
+struct Benchmark {
+    const char *name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"alu", BenchAlu},
+    {"alu-cycle", BenchAluCycle},
+    {"jit", BenchJit},
+    {"jit-check", BenchJitCheck},
+    {"jit-events", BenchJitEvents},
+    {"events", BenchEvents},
+    {"ppu", BenchPpu},
+    {"mmc3-irq", BenchMmc3Irq},
+    {"ppu-check", BenchPpuCheck},
+    {"render-skip", BenchRenderSkip},
+    {"idle-loop", BenchIdleLoop},
+    {"snapshot", BenchSnapshot},
+    {"snapshot-incremental", BenchSnapshotIncremental},
+    {"rewind", BenchRewind},
+    {"clone", BenchClone},
+    {"run-ahead", BenchRunAhead},
+};
+
+int main(int argc, char **argv) {
+    for (const Benchmark &benchmark : benchmarks) {
+        bool selected = argc < 2; // All of them by default
+        for (int i = 1; i < argc; i++)
+            selected |= std::strcmp(argv[i], benchmark.name) == 0;
+
+        if (selected)
+            benchmark.run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,551 @@
+/*
+ *
+ * nesem static recompiler
+ *
+ * Translates the program of an NROM cartridge into C++ ahead of time, to be linked against the
+ * emulator and run through NES6502Aot (make aot ROM=...). Routines are discovered from the
+ * reset, NMI and IRQ vectors and from every subroutine call, decoded through the CPU's own
+ * instruction set lookup table, and emitted as one function each. Whatever cannot be resolved
+ * statically is left to the interpreter (see NES6502Aot.cpp).
+ *
+ * Usage: x86-64_linux-nesem-recompile <rom.nes> <translation.cpp>
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../include/NES6502.h"
+#include "../include/NES6502Aot.h"
+#include "NromImage.h"
+
+using is = NES6502Base::Operation;
+using am = NES6502Base::AddrMode;
+
+static constexpr uint16_t PROGRAM_SPACE_START = 0x8000;
+static constexpr size_t PROGRAM_SPACE_SIZE = 0x8000;
+
+static uint8_t programSpace[PROGRAM_SPACE_SIZE];
+
+static uint8_t Read(uint16_t addr) { return programSpace[addr - PROGRAM_SPACE_START]; }
+
+static uint16_t ReadWord(uint16_t addr) { return Read(addr) | (Read(addr + 1) << 8); }
+
+static std::string Hex(unsigned int value, int digits) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%0*X", digits, value);
+    return text;
+}
+
+// Decoding
+
+struct Decoded {
+    uint16_t pc;
+    uint8_t opcode;
+    uint16_t operand;
+    NES6502Base::Instruction instruction;
+    uint16_t nextPc;
+};
+
+static Decoded Decode(uint16_t pc) {
+    Decoded decoded;
+    decoded.pc = pc;
+    decoded.opcode = Read(pc);
+    decoded.instruction = NES6502Base::instructionSetLookup[decoded.opcode];
+
+    uint8_t length = NES6502Base::operandLengthLookup[uint8_t(decoded.instruction.addrMode)];
+    decoded.operand = length == 2 ? ReadWord(pc + 1) : length == 1 ? Read(pc + 1) : 0;
+    decoded.nextPc = pc + 1 + length;
+
+    return decoded;
+}
+
+// Whether the instruction and its operand lie within the program space
+static bool IsDecodable(uint16_t pc) {
+    if (pc < PROGRAM_SPACE_START)
+        return false;
+
+    uint8_t length =
+        NES6502Base::operandLengthLookup[uint8_t(
+            NES6502Base::instructionSetLookup[Read(pc)].addrMode)];
+    return pc + length <= 0xFFFF;
+}
+
+static bool IsUnofficial(uint8_t opcode) {
+    return NES6502Base::mnemonicLookup[opcode][0] == '?';
+}
+
+static bool IsBranch(is operation) {
+    switch (operation) {
+    case is::BCC:
+    case is::BCS:
+    case is::BEQ:
+    case is::BMI:
+    case is::BNE:
+    case is::BPL:
+    case is::BVC:
+    case is::BVS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static const char *BranchCondition(is operation) {
+    switch (operation) {
+    case is::BCC:
+        return "!aot::C(r)";
+    case is::BCS:
+        return "aot::C(r)";
+    case is::BEQ:
+        return "aot::Z(r)";
+    case is::BMI:
+        return "aot::N(r)";
+    case is::BNE:
+        return "!aot::Z(r)";
+    case is::BPL:
+        return "!aot::N(r)";
+    case is::BVC:
+        return "!aot::V(r)";
+    default:
+        return "aot::V(r)";
+    }
+}
+
+static uint16_t BranchTarget(const Decoded &decoded) {
+    return decoded.nextPc + int8_t(decoded.operand);
+}
+
+// Routine discovery
+
+// Owning routine of each address of the program space, -1 if not decoded (yet)
+static int owners[PROGRAM_SPACE_SIZE];
+
+struct Routine {
+    uint16_t entry;
+    std::vector<uint16_t> instructions; // Addresses, sorted once discovered
+};
+
+static std::vector<Routine> routines;
+
+// Walks the routine starting at the given address, following its branches and jumps, and
+// queues the subroutines it calls
+static void Discover(uint16_t entry, std::vector<uint16_t> &routineQueue) {
+    if (!IsDecodable(entry) || owners[entry - PROGRAM_SPACE_START] >= 0)
+        return;
+
+    int routineIndex = int(routines.size());
+    routines.push_back({entry, {}});
+    Routine &routine = routines.back();
+
+    std::vector<uint16_t> worklist = {entry};
+    while (!worklist.empty()) {
+        uint16_t pc = worklist.back();
+        worklist.pop_back();
+
+        if (!IsDecodable(pc) || owners[pc - PROGRAM_SPACE_START] >= 0)
+            continue;
+
+        owners[pc - PROGRAM_SPACE_START] = routineIndex;
+        routine.instructions.push_back(pc);
+
+        Decoded decoded = Decode(pc);
+        is operation = decoded.instruction.operation;
+
+        if (IsBranch(operation)) {
+            worklist.push_back(BranchTarget(decoded));
+            worklist.push_back(decoded.nextPc);
+        } else if (operation == is::JSR) {
+            routineQueue.push_back(decoded.operand);
+            worklist.push_back(decoded.nextPc);
+        } else if (operation == is::JMP) {
+            // Indirect jumps can go anywhere, left to the dispatcher
+            if (decoded.instruction.addrMode == am::ABS)
+                worklist.push_back(decoded.operand);
+        } else if (operation != is::RTS && operation != is::RTI && operation != is::BRK) {
+            worklist.push_back(decoded.nextPc);
+        }
+    }
+
+    std::sort(routine.instructions.begin(), routine.instructions.end());
+}
+
+// Code generation
+
+static std::string Disassemble(const Decoded &decoded) {
+    std::string text = NES6502Base::mnemonicLookup[decoded.opcode];
+    std::string byte = "$" + Hex(decoded.operand, 2), word = "$" + Hex(decoded.operand, 4);
+
+    switch (decoded.instruction.addrMode) {
+    case am::IMP:
+        return text;
+    case am::IMM:
+        return text + " #" + byte;
+    case am::ZP0:
+        return text + " " + byte;
+    case am::ZPX:
+        return text + " " + byte + ",X";
+    case am::ZPY:
+        return text + " " + byte + ",Y";
+    case am::REL:
+        return text + " $" + Hex(BranchTarget(decoded), 4);
+    case am::ABS:
+        return text + " " + word;
+    case am::ABX:
+        return text + " " + word + ",X";
+    case am::ABY:
+        return text + " " + word + ",Y";
+    case am::IND:
+        return text + " (" + word + ")";
+    case am::IZX:
+        return text + " (" + byte + ",X)";
+    case am::IZY:
+        return text + " (" + byte + "),Y";
+    }
+
+    return text;
+}
+
+class RoutineEmitter {
+public:
+    RoutineEmitter(std::ostream &_out, int _routineIndex)
+        : out(_out), routineIndex(_routineIndex) {}
+
+    // Emits the given instruction, returns false if it doesn't fall through to the next one
+    bool Emit(const Decoded &decoded);
+
+    // Continues at the given address: a goto within the routine, which checks the target cycle
+    // before every instruction, a return otherwise
+    void Jump(uint16_t target, const char *indent = "    ");
+
+private:
+    std::ostream &out;
+    int routineIndex;
+
+    void Fallback(uint16_t pc) { out << "    FALLBACK(0x" << Hex(pc, 4) << ");\n"; }
+
+    // Emits the effective address computation (addr), returns the expression of the extra cycle
+    // taken on page crossings, if the address mode has one
+    std::string EmitAddress(const Decoded &decoded);
+
+    // Checks the address against I/O pages, then accounts for the instruction's cycles
+    void EmitAccess(const Decoded &decoded, bool read, bool write);
+};
+
+void RoutineEmitter::Jump(uint16_t target, const char *indent) {
+    bool inRoutine =
+        target >= PROGRAM_SPACE_START && owners[target - PROGRAM_SPACE_START] == routineIndex;
+
+    if (inRoutine) {
+        out << indent << "goto op_" << Hex(target, 4) << ";\n";
+        return;
+    }
+
+    out << indent << "r.pc = 0x" << Hex(target, 4) << ";\n" << indent << "return false;\n";
+}
+
+std::string RoutineEmitter::EmitAddress(const Decoded &decoded) {
+    std::string byte = "0x" + Hex(decoded.operand, 2), word = "0x" + Hex(decoded.operand, 4);
+
+    switch (decoded.instruction.addrMode) {
+    case am::ZP0:
+        out << "    uint16_t addr = " << byte << ";\n";
+        return "";
+    case am::ZPX:
+        out << "    uint16_t addr = uint8_t(" << byte << " + r.x);\n";
+        return "";
+    case am::ZPY:
+        out << "    uint16_t addr = uint8_t(" << byte << " + r.y);\n";
+        return "";
+    case am::ABS:
+        out << "    uint16_t addr = " << word << ";\n";
+        return "";
+    case am::ABX:
+        out << "    uint16_t addr = uint16_t(" << word << " + r.x);\n";
+        return "aot::CrossesPage(" + word + ", addr)";
+    case am::ABY:
+        out << "    uint16_t addr = uint16_t(" << word << " + r.y);\n";
+        return "aot::CrossesPage(" + word + ", addr)";
+    case am::IZX:
+        out << "    uint16_t addr = aot::ZeroPagePointer(bus, uint8_t(" << byte << " + r.x));\n";
+        return "";
+    case am::IZY:
+        out << "    uint16_t base = aot::ZeroPagePointer(bus, " << byte << ");\n"
+            << "    uint16_t addr = uint16_t(base + r.y);\n";
+        return "aot::CrossesPage(base, addr)";
+    default:
+        return "";
+    }
+}
+
+void RoutineEmitter::EmitAccess(const Decoded &decoded, bool read, bool write) {
+    std::string pageCross = EmitAddress(decoded);
+
+    if (read && write)
+        out << "    if (!aot::IsReadable(bus, addr) || !aot::IsWritable(bus, addr))\n";
+    else
+        out << "    if (!aot::Is" << (read ? "Readable" : "Writable") << "(bus, addr))\n";
+    out << "    ";
+    Fallback(decoded.pc);
+
+    out << "    r.clockCount += " << int(decoded.instruction.cycles);
+    if (decoded.instruction.pageCross && !pageCross.empty())
+        out << " + " << pageCross;
+    out << ";\n";
+}
+
+bool RoutineEmitter::Emit(const Decoded &decoded) {
+    const NES6502Base::Instruction &instruction = decoded.instruction;
+    is operation = instruction.operation;
+    am addrMode = instruction.addrMode;
+    std::string cycles = "    r.clockCount += " + std::to_string(instruction.cycles) + ";\n";
+    std::string imm = "0x" + Hex(decoded.operand, 2);
+
+    out << "op_" << Hex(decoded.pc, 4) << ": // " << Disassemble(decoded) << "\n"
+        << "    STOP_AT_TARGET(0x" << Hex(decoded.pc, 4) << ");\n";
+
+    // Left to the interpreter: interrupts and status pushes (whose flags the translation keeps
+    // lazily), CLI (ending the run when it unmasks a pending interrupt), indirect jumps and
+    // unofficial opcodes
+    if (IsUnofficial(decoded.opcode) || operation == is::BRK || operation == is::RTI ||
+        operation == is::PHP || operation == is::PLP || operation == is::CLI ||
+        (operation == is::JMP && addrMode == am::IND)) {
+        Fallback(decoded.pc);
+        return false;
+    }
+
+    // Operand read: immediate value or memory
+    auto read = [&](const char *code) {
+        if (addrMode == am::IMM) {
+            out << cycles;
+            std::string line = code;
+            line.replace(line.find("DATA"), 4, imm);
+            out << "    " << line << "\n";
+        } else {
+            out << "    {\n";
+            EmitAccess(decoded, true, false);
+            std::string line = code;
+            line.replace(line.find("DATA"), 4, "bus.ReadRam(addr)");
+            out << "    " << line << "\n    }\n";
+        }
+    };
+
+    // Read-modify-write on the accumulator or memory
+    auto modify = [&](const char *operationName) {
+        if (addrMode == am::IMP) {
+            out << cycles << "    r.a = aot::" << operationName << "(r, r.a);\n";
+        } else {
+            out << "    {\n";
+            EmitAccess(decoded, true, true);
+            out << "    bus.WriteRam(addr, aot::" << operationName << "(r, bus.ReadRam(addr)));\n"
+                << "    }\n";
+        }
+    };
+
+    auto store = [&](const char *reg) {
+        out << "    {\n";
+        EmitAccess(decoded, false, true);
+        out << "    bus.WriteRam(addr, r." << reg << ");\n    }\n";
+    };
+
+    auto increment = [&](const char *delta) {
+        out << "    {\n";
+        EmitAccess(decoded, true, true);
+        out << "    uint8_t data = bus.ReadRam(addr) " << delta << " 1;\n"
+            << "    bus.WriteRam(addr, data);\n"
+            << "    r.lazyNZ = data;\n    }\n";
+    };
+
+    auto implied = [&](const char *code) { out << cycles << "    " << code << "\n"; };
+
+    switch (operation) {
+    // Loads and stores
+    case is::LDA: read("r.a = DATA; r.lazyNZ = r.a;"); break;
+    case is::LDX: read("r.x = DATA; r.lazyNZ = r.x;"); break;
+    case is::LDY: read("r.y = DATA; r.lazyNZ = r.y;"); break;
+    case is::STA: store("a"); break;
+    case is::STX: store("x"); break;
+    case is::STY: store("y"); break;
+
+    // Arithmetic and logic
+    case is::ADC: read("aot::ADC(r, DATA);"); break;
+    case is::SBC: read("aot::SBC(r, DATA);"); break;
+    case is::AND: read("r.a &= DATA; r.lazyNZ = r.a;"); break;
+    case is::ORA: read("r.a |= DATA; r.lazyNZ = r.a;"); break;
+    case is::EOR: read("r.a ^= DATA; r.lazyNZ = r.a;"); break;
+    case is::CMP: read("aot::Compare(r, r.a, DATA);"); break;
+    case is::CPX: read("aot::Compare(r, r.x, DATA);"); break;
+    case is::CPY: read("aot::Compare(r, r.y, DATA);"); break;
+    case is::BIT: read("aot::BIT(r, DATA);"); break;
+
+    // Shifts, increments and decrements
+    case is::ASL: modify("ASL"); break;
+    case is::LSR: modify("LSR"); break;
+    case is::ROL: modify("ROL"); break;
+    case is::ROR: modify("ROR"); break;
+    case is::INC: increment("+"); break;
+    case is::DEC: increment("-"); break;
+    case is::INX: implied("r.x++; r.lazyNZ = r.x;"); break;
+    case is::INY: implied("r.y++; r.lazyNZ = r.y;"); break;
+    case is::DEX: implied("r.x--; r.lazyNZ = r.x;"); break;
+    case is::DEY: implied("r.y--; r.lazyNZ = r.y;"); break;
+
+    // Transfers
+    case is::TAX: implied("r.x = r.a; r.lazyNZ = r.x;"); break;
+    case is::TAY: implied("r.y = r.a; r.lazyNZ = r.y;"); break;
+    case is::TXA: implied("r.a = r.x; r.lazyNZ = r.a;"); break;
+    case is::TYA: implied("r.a = r.y; r.lazyNZ = r.a;"); break;
+    case is::TSX: implied("r.x = r.stkp; r.lazyNZ = r.x;"); break;
+    case is::TXS: implied("r.stkp = r.x;"); break;
+
+    // Flags
+    case is::CLC: implied("r.lazyC = 0;"); break;
+    case is::SEC: implied("r.lazyC = 1;"); break;
+    case is::CLV: implied("r.lazyV1 = r.lazyV2 = r.lazyVResult = 0;"); break;
+    case is::SEI: implied("r.status |= aot::FLAG_I;"); break;
+    case is::CLD: implied("r.status &= ~aot::FLAG_D;"); break;
+    case is::SED: implied("r.status |= aot::FLAG_D;"); break;
+    case is::NOP: out << cycles; break;
+
+    // Stack
+    case is::PHA: implied("aot::Push(bus, r, r.a);"); break;
+    case is::PLA: implied("r.a = aot::Pull(bus, r); r.lazyNZ = r.a;"); break;
+
+    // Control flow
+    case is::JMP:
+        out << cycles;
+        Jump(decoded.operand);
+        return false;
+
+    case is::JSR: {
+        uint16_t returnAddr = decoded.nextPc - 1;
+        out << "    aot::Push(bus, r, 0x" << Hex(returnAddr >> 8, 2) << ");\n"
+            << "    aot::Push(bus, r, 0x" << Hex(returnAddr & 0xFF, 2) << ");\n"
+            << cycles;
+        Jump(decoded.operand);
+        return false;
+    }
+
+    case is::RTS:
+        out << "    {\n"
+            << "    uint16_t lo = aot::Pull(bus, r);\n"
+            << "    uint16_t hi = aot::Pull(bus, r);\n"
+            << "    r.pc = ((hi << 8) | lo) + 1;\n"
+            << "    }\n"
+            << cycles << "    return false;\n";
+        return false;
+
+    default:
+        if (IsBranch(operation)) {
+            // One more cycle when taken, and another one when crossing a page
+            uint16_t target = BranchTarget(decoded);
+            unsigned int takenCycles =
+                instruction.cycles + 1 + (((target ^ decoded.nextPc) & 0xFF00) != 0);
+
+            out << "    if (" << BranchCondition(operation) << ") {\n"
+                << "        r.clockCount += " << takenCycles << ";\n";
+            Jump(target, "        ");
+            out << "    }\n" << cycles;
+            return true;
+        }
+
+        Fallback(decoded.pc);
+        return false;
+    }
+
+    return true;
+}
+
+static void EmitTranslation(std::ostream &out, const char *romPath, uint64_t programHash) {
+    size_t instructionCount = 0;
+    for (const Routine &routine : routines)
+        instructionCount += routine.instructions.size();
+
+    out << "// Translation of " << romPath << ", generated by nesem's static recompiler\n"
+        << "// (tools/recompile.cpp): " << routines.size() << " routines, " << instructionCount
+        << " instructions. Do not edit.\n\n"
+        << "#include \"NES6502Aot.h\"\n\n"
+        << "using Registers = NES6502Base::Registers;\n\n"
+        << "// Leaves the instruction at the given address to the interpreter\n"
+        << "#define FALLBACK(addr)                                                            \\\n"
+        << "    do {                                                                          \\\n"
+        << "        r.pc = addr;                                                              \\\n"
+        << "        return true;                                                              \\\n"
+        << "    } while (0)\n\n"
+        << "// Leaves the routine at the given address once the target cycle is reached\n"
+        << "#define STOP_AT_TARGET(addr)                                                      \\\n"
+        << "    do {                                                                          \\\n"
+        << "        if (r.clockCount >= targetCycle) {                                        \\\n"
+        << "            r.pc = addr;                                                          \\\n"
+        << "            return false;                                                         \\\n"
+        << "        }                                                                         \\\n"
+        << "    } while (0)\n";
+
+    for (size_t i = 0; i < routines.size(); i++) {
+        const Routine &routine = routines[i];
+        RoutineEmitter emitter(out, int(i));
+
+        out << "\nstatic bool Routine_" << Hex(routine.entry, 4)
+            << "(Bus &bus, Registers &r, uint64_t targetCycle) {\n"
+            << "    switch (r.pc) {\n";
+        for (uint16_t pc : routine.instructions)
+            out << "    case 0x" << Hex(pc, 4) << ":\n        goto op_" << Hex(pc, 4) << ";\n";
+        out << "    default:\n        return true;\n    }\n\n";
+
+        for (size_t j = 0; j < routine.instructions.size(); j++) {
+            Decoded decoded = Decode(routine.instructions[j]);
+            bool fallsThrough = emitter.Emit(decoded);
+
+            // Falling through to an instruction not emitted right after
+            bool nextEmitted = j + 1 < routine.instructions.size() &&
+                               routine.instructions[j + 1] == decoded.nextPc;
+            if (fallsThrough && !nextEmitted)
+                emitter.Jump(decoded.nextPc);
+        }
+
+        out << "}\n";
+    }
+
+    out << "\nstatic const AotEntry entries[] = {\n";
+    for (const Routine &routine : routines)
+        for (uint16_t pc : routine.instructions)
+            out << "    {0x" << Hex(pc, 4) << ", Routine_" << Hex(routine.entry, 4) << "},\n";
+    out << "};\n\n"
+        << "extern const AotProgram aotProgram = {0x" << Hex(uint32_t(programHash >> 32), 8)
+        << Hex(uint32_t(programHash), 8) << ", entries, sizeof(entries) / sizeof(*entries)};\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <rom.nes> <translation.cpp>\n";
+        return 1;
+    }
+
+    if (!LoadNromProgramSpace(argv[1], programSpace)) {
+        std::cerr << argv[1] << ": not an NROM (mapper 0) iNES image\n";
+        return 1;
+    }
+
+    // Vectors first, then the subroutines called from every routine found
+    std::fill(std::begin(owners), std::end(owners), -1);
+    std::vector<uint16_t> routineQueue = {ReadWord(0xFFFC), ReadWord(0xFFFA), ReadWord(0xFFFE)};
+
+    for (size_t i = 0; i < routineQueue.size(); i++)
+        Discover(routineQueue[i], routineQueue);
+
+    std::ofstream out(argv[2]);
+    EmitTranslation(out, argv[1], HashProgramSpace(programSpace, PROGRAM_SPACE_SIZE));
+
+    if (!out) {
+        std::cerr << argv[2] << ": could not be written\n";
+        return 1;
+    }
+
+    return 0;
+}